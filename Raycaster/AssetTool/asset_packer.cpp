@@ -0,0 +1,160 @@
+#include "asset_packer.h"
+#include "content_hash.h"
+#include "pack_format.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+namespace
+{
+    // Relative paths of all files below directory, with forward slashes
+    void ListFiles(const std::string& root, const std::string& directory, std::vector<std::string>& files)
+    {
+#ifdef _WIN32
+        WIN32_FIND_DATAA data;
+        HANDLE find = FindFirstFileA((root + directory + "/*").c_str(), &data);
+        if (find == INVALID_HANDLE_VALUE)
+            return;
+        do
+        {
+            std::string name = data.cFileName;
+            if (name == "." || name == "..")
+                continue;
+            if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+                ListFiles(root, directory + "/" + name, files);
+            else
+                files.push_back(directory + "/" + name);
+        } while (FindNextFileA(find, &data));
+        FindClose(find);
+#else
+        DIR* dir = opendir((root + directory).c_str());
+        if (!dir)
+            return;
+        while (dirent* entry = readdir(dir))
+        {
+            std::string name = entry->d_name;
+            if (name == "." || name == "..")
+                continue;
+            struct stat info;
+            if (stat((root + directory + "/" + name).c_str(), &info) != 0)
+                continue;
+            if (S_ISDIR(info.st_mode))
+                ListFiles(root, directory + "/" + name, files);
+            else
+                files.push_back(directory + "/" + name);
+        }
+        closedir(dir);
+#endif
+    }
+
+    bool HasExtension(const std::string& path, const std::vector<std::string>& extensions)
+    {
+        for (const std::string& extension : extensions)
+            if (path.size() >= extension.size() && path.compare(path.size() - extension.size(), extension.size(), extension) == 0)
+                return true;
+        return false;
+    }
+}
+
+int RunAssetPacker(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        std::cerr << "usage: AssetTool pack <output> <root directory> <directory>... [--exclude .ext]...\n";
+        return 1;
+    }
+
+    std::string outputPath = argv[0];
+    std::string root = argv[1];
+    if (!root.empty() && root.back() != '/' && root.back() != '\\')
+        root += '/';
+
+    std::vector<std::string> directories;
+    std::vector<std::string> excluded;
+    for (int i = 2; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--exclude") == 0 && i + 1 < argc)
+            excluded.push_back(argv[++i]);
+        else
+            directories.push_back(argv[i]);
+    }
+
+    std::vector<std::string> files;
+    for (const std::string& directory : directories)
+        ListFiles(root, directory, files);
+    files.erase(std::remove_if(files.begin(), files.end(),
+        [&](const std::string& file) { return HasExtension(file, excluded); }), files.end());
+
+    // Sorted by name so the game can binary search the index
+    std::sort(files.begin(), files.end());
+
+    std::vector<PackEntry> entries(files.size());
+    std::vector<std::vector<char>> contents(files.size());
+    uint64_t offset = sizeof(PackHeader) + entries.size() * sizeof(PackEntry);
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        if (files[i].size() >= sizeof(PackEntry::name))
+        {
+            std::cerr << "Path too long for the pack index: " << files[i] << std::endl;
+            return 1;
+        }
+
+        std::ifstream file(root + files[i], std::ios::binary | std::ios::ate);
+        if (!file)
+        {
+            std::cerr << "Failed to read: " << files[i] << std::endl;
+            return 1;
+        }
+        contents[i].resize((size_t)file.tellg());
+        file.seekg(0);
+        file.read(contents[i].data(), contents[i].size());
+
+        offset = (offset + PACK_ALIGNMENT - 1) / PACK_ALIGNMENT * PACK_ALIGNMENT;
+        PackEntry& entry = entries[i];
+        memset(&entry, 0, sizeof(entry));
+        memcpy(entry.name, files[i].c_str(), files[i].size());
+        entry.offset = offset;
+        entry.size = contents[i].size();
+        entry.hash = HashContent(contents[i].data(), contents[i].size());
+        offset += entry.size;
+    }
+
+    std::ofstream output(outputPath, std::ios::binary);
+    if (!output)
+    {
+        std::cerr << "Failed to write pack: " << outputPath << std::endl;
+        return 1;
+    }
+
+    PackHeader header = {};
+    memcpy(header.magic, PACK_MAGIC, sizeof(header.magic));
+    header.version = PACK_VERSION;
+    header.entryCount = (uint32_t)entries.size();
+    output.write((const char*)&header, sizeof(header));
+    output.write((const char*)entries.data(), entries.size() * sizeof(PackEntry));
+
+    const char zeros[PACK_ALIGNMENT] = {};
+    uint64_t written = sizeof(PackHeader) + entries.size() * sizeof(PackEntry);
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        output.write(zeros, (std::streamsize)(entries[i].offset - written));
+        output.write(contents[i].data(), contents[i].size());
+        written = entries[i].offset + entries[i].size;
+    }
+
+    std::cout << "Wrote " << outputPath << " (" << entries.size() << " files, " << written << " bytes)\n";
+    return 0;
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+// "AssetTool pack <output> <root directory> <directory>... [--exclude .ext]..."
+//
+// Writes every file found under the given directories, relative to the root,
+// into one asset pack (see pack_format.h) that the game maps at startup.
+int RunAssetPacker(int argc, char** argv);
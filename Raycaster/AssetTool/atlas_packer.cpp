@@ -0,0 +1,276 @@
+#include "atlas_packer.h"
+#include "atlas_format.h"
+
+#include <stb_image.h>
+#include <stb_image_write.h>
+#include <stb_rect_pack.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+    struct Sheet
+    {
+        int width = 0;
+        int height = 0;
+        std::vector<unsigned char> pixels;  // RGBA
+    };
+
+    struct Frame
+    {
+        std::string name;
+        const Sheet* sheet;
+        int x, y, width, height;
+    };
+
+    std::string DirectoryOf(const std::string& path)
+    {
+        size_t slash = path.find_last_of("/\\");
+        return slash == std::string::npos ? "" : path.substr(0, slash + 1);
+    }
+
+    const Sheet* LoadSheet(std::map<std::string, std::unique_ptr<Sheet>>& sheets, const std::string& path)
+    {
+        auto it = sheets.find(path);
+        if (it != sheets.end())
+            return it->second.get();
+
+        int width, height, channels;
+        unsigned char* data = stbi_load(path.c_str(), &width, &height, &channels, 4);
+        if (!data)
+        {
+            std::cerr << "Failed to load sheet: " << path << std::endl;
+            return nullptr;
+        }
+
+        std::unique_ptr<Sheet> sheet(new Sheet());
+        sheet->width = width;
+        sheet->height = height;
+        sheet->pixels.assign(data, data + (size_t)width * height * 4);
+        stbi_image_free(data);
+
+        const Sheet* result = sheet.get();
+        sheets[path] = std::move(sheet);
+        return result;
+    }
+
+    bool ReadManifest(const std::string& manifestPath, std::map<std::string, std::unique_ptr<Sheet>>& sheets, std::vector<Frame>& frames)
+    {
+        std::ifstream manifest(manifestPath);
+        if (!manifest)
+        {
+            std::cerr << "Failed to open manifest: " << manifestPath << std::endl;
+            return false;
+        }
+
+        std::string directory = DirectoryOf(manifestPath);
+        std::string line;
+        int lineNumber = 0;
+        while (std::getline(manifest, line))
+        {
+            lineNumber++;
+            if (line.empty() || line[0] == '#')
+                continue;
+
+            std::istringstream fields(line);
+            std::string group, file;
+            int x0, y0, frameWidth, frameHeight, strideX, strideY, columns, count;
+            if (!(fields >> group >> file >> x0 >> y0 >> frameWidth >> frameHeight >> strideX >> strideY >> columns >> count))
+            {
+                std::cerr << manifestPath << ":" << lineNumber << ": expected 10 fields\n";
+                return false;
+            }
+
+            const Sheet* sheet = LoadSheet(sheets, directory + file);
+            if (!sheet)
+                return false;
+
+            for (int i = 0; i < count; i++)
+            {
+                Frame frame;
+                frame.name = group + ":" + std::to_string(i);
+                frame.sheet = sheet;
+                frame.x = x0 + (i % columns) * strideX;
+                frame.y = y0 + (i / columns) * strideY;
+                frame.width = std::min(frameWidth, sheet->width - frame.x);
+                frame.height = std::min(frameHeight, sheet->height - frame.y);
+                if (frame.width <= 0 || frame.height <= 0 || frame.name.size() >= sizeof(AtlasRect::name))
+                {
+                    std::cerr << manifestPath << ":" << lineNumber << ": frame " << i << " of " << group << " is invalid\n";
+                    return false;
+                }
+                frames.push_back(frame);
+            }
+        }
+        return true;
+    }
+
+    // Copy a frame into the page and extrude its border pixels into the gutter,
+    // so filtering and lower mip levels only ever see the frame's own edge colors
+    void BlitWithGutter(const Frame& frame, std::vector<unsigned char>& page, int pageWidth, int pageHeight, int destX, int destY, int padding)
+    {
+        for (int y = -padding; y < frame.height + padding; y++)
+        {
+            int py = destY + y;
+            if (py < 0 || py >= pageHeight)
+                continue;
+            int sy = frame.y + std::max(0, std::min(frame.height - 1, y));
+            for (int x = -padding; x < frame.width + padding; x++)
+            {
+                int px = destX + x;
+                if (px < 0 || px >= pageWidth)
+                    continue;
+                int sx = frame.x + std::max(0, std::min(frame.width - 1, x));
+                const unsigned char* src = &frame.sheet->pixels[((size_t)sy * frame.sheet->width + sx) * 4];
+                memcpy(&page[((size_t)py * pageWidth + px) * 4], src, 4);
+            }
+        }
+    }
+}
+
+int RunAtlasPacker(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "usage: AssetTool atlas <manifest> <output directory> [--size N] [--padding N]\n";
+        return 1;
+    }
+
+    std::string manifestPath = argv[0];
+    std::string outputDirectory = argv[1];
+    if (!outputDirectory.empty() && outputDirectory.back() != '/' && outputDirectory.back() != '\\')
+        outputDirectory += '/';
+
+    int pageSize = 2048;
+    int padding = 4;
+    for (int i = 2; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "--size") == 0)
+            pageSize = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--padding") == 0)
+            padding = atoi(argv[i + 1]);
+    }
+
+    std::map<std::string, std::unique_ptr<Sheet>> sheets;
+    std::vector<Frame> frames;
+    if (!ReadManifest(manifestPath, sheets, frames))
+        return 1;
+
+    std::vector<AtlasPage> pages;
+    std::vector<AtlasRect> rects;
+
+    // Fill pages until every frame is placed
+    std::vector<int> remaining(frames.size());
+    for (size_t i = 0; i < frames.size(); i++)
+        remaining[i] = (int)i;
+
+    while (!remaining.empty())
+    {
+        std::vector<stbrp_rect> packRects(remaining.size());
+        for (size_t i = 0; i < remaining.size(); i++)
+        {
+            const Frame& frame = frames[remaining[i]];
+            packRects[i].id = remaining[i];
+            packRects[i].w = frame.width + padding * 2;
+            packRects[i].h = frame.height + padding * 2;
+        }
+
+        std::vector<stbrp_node> nodes(pageSize);
+        stbrp_context context;
+        stbrp_init_target(&context, pageSize, pageSize, nodes.data(), (int)nodes.size());
+        stbrp_pack_rects(&context, packRects.data(), (int)packRects.size());
+
+        // Shrink the page to the used area
+        int usedWidth = 0, usedHeight = 0;
+        for (const stbrp_rect& r : packRects)
+        {
+            if (!r.was_packed)
+                continue;
+            usedWidth = std::max(usedWidth, r.x + r.w);
+            usedHeight = std::max(usedHeight, r.y + r.h);
+        }
+        if (usedWidth == 0)
+        {
+            std::cerr << "Frame " << frames[remaining[0]].name << " does not fit in a " << pageSize << " page\n";
+            return 1;
+        }
+
+        // Multiples of four keep block compression and mip chains simple
+        usedWidth = (usedWidth + 3) & ~3;
+        usedHeight = (usedHeight + 3) & ~3;
+
+        uint16_t pageIndex = (uint16_t)pages.size();
+        std::vector<unsigned char> page((size_t)usedWidth * usedHeight * 4, 0);
+        std::vector<int> left;
+        for (const stbrp_rect& r : packRects)
+        {
+            if (!r.was_packed)
+            {
+                left.push_back(r.id);
+                continue;
+            }
+
+            const Frame& frame = frames[r.id];
+            BlitWithGutter(frame, page, usedWidth, usedHeight, r.x + padding, r.y + padding, padding);
+
+            AtlasRect rect = {};
+            strncpy(rect.name, frame.name.c_str(), sizeof(rect.name) - 1);
+            rect.page = pageIndex;
+            rect.x = (uint16_t)(r.x + padding);
+            rect.y = (uint16_t)(r.y + padding);
+            rect.width = (uint16_t)frame.width;
+            rect.height = (uint16_t)frame.height;
+            rects.push_back(rect);
+        }
+
+        AtlasPage pageInfo = {};
+        pageInfo.width = usedWidth;
+        pageInfo.height = usedHeight;
+        snprintf(pageInfo.file, sizeof(pageInfo.file), "atlas%d.png", (int)pageIndex);
+        pages.push_back(pageInfo);
+
+        std::string pagePath = outputDirectory + pageInfo.file;
+        if (!stbi_write_png(pagePath.c_str(), usedWidth, usedHeight, 4, page.data(), usedWidth * 4))
+        {
+            std::cerr << "Failed to write atlas page: " << pagePath << std::endl;
+            return 1;
+        }
+        std::cout << "Wrote " << pagePath << " (" << usedWidth << "x" << usedHeight << ", "
+            << (remaining.size() - left.size()) << " frames)\n";
+
+        remaining.swap(left);
+    }
+
+    // Sorted by name so the runtime can binary search
+    std::sort(rects.begin(), rects.end(), [](const AtlasRect& a, const AtlasRect& b) { return strcmp(a.name, b.name) < 0; });
+
+    AtlasHeader header = {};
+    memcpy(header.magic, ATLAS_MAGIC, sizeof(header.magic));
+    header.version = ATLAS_VERSION;
+    header.pageCount = (uint32_t)pages.size();
+    header.rectCount = (uint32_t)rects.size();
+    header.padding = (uint32_t)padding;
+
+    std::string tablePath = outputDirectory + "atlas.bin";
+    std::ofstream table(tablePath, std::ios::binary);
+    if (!table)
+    {
+        std::cerr << "Failed to write rect table: " << tablePath << std::endl;
+        return 1;
+    }
+    table.write((const char*)&header, sizeof(header));
+    table.write((const char*)pages.data(), pages.size() * sizeof(AtlasPage));
+    table.write((const char*)rects.data(), rects.size() * sizeof(AtlasRect));
+
+    std::cout << "Wrote " << tablePath << " (" << pages.size() << " pages, " << rects.size() << " rects)\n";
+    return 0;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+// "AssetTool atlas <manifest> <output directory> [--size N] [--padding N]"
+//
+// Cuts the frames listed in the manifest out of their sheets, packs them into
+// as few pages as possible with stb_rect_pack and writes atlas<N>.png plus the
+// atlas.bin rect table described in atlas_format.h.
+int RunAtlasPacker(int argc, char** argv);
@@ -0,0 +1,258 @@
+#include "font_baker.h"
+#include "font_format.h"
+
+#include <stb_image.h>
+#include <stb_image_write.h>
+#include <stb_rect_pack.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+    struct Glyph
+    {
+        char character;
+        int inkX, inkY, inkWidth, inkHeight;    // sheet pixels
+        int cellY;
+        int width, height;                      // distance field size
+        std::vector<unsigned char> field;
+    };
+
+    // Glyph ink is dark and opaque, the cell grid and labels in the sheet are white
+    bool IsInk(const unsigned char* pixels, int width, int channels, int x, int y)
+    {
+        const unsigned char* p = &pixels[((size_t)y * width + x) * channels];
+        unsigned char grey = p[0];
+        unsigned char alpha = channels == 2 || channels == 4 ? p[channels - 1] : 255;
+        return alpha >= 128 && grey < 128;
+    }
+
+    void BakeField(const unsigned char* pixels, int width, int height, int channels, int scale, int spread, Glyph& glyph)
+    {
+        // Room for the falloff around the ink
+        int border = spread * scale;
+        int x0 = glyph.inkX - border;
+        int y0 = glyph.inkY - border;
+        glyph.width = (glyph.inkWidth + border * 2 + scale - 1) / scale;
+        glyph.height = (glyph.inkHeight + border * 2 + scale - 1) / scale;
+        glyph.field.assign((size_t)glyph.width * glyph.height, 0);
+
+        auto inside = [&](int x, int y) {
+            return x >= 0 && y >= 0 && x < width && y < height && IsInk(pixels, width, channels, x, y);
+        };
+
+        // Distance to the nearest texel of the other state, searched within the spread
+        int radius = border;
+        for (int fy = 0; fy < glyph.height; fy++)
+        {
+            for (int fx = 0; fx < glyph.width; fx++)
+            {
+                int sx = x0 + fx * scale + scale / 2;
+                int sy = y0 + fy * scale + scale / 2;
+                bool in = inside(sx, sy);
+                int best = radius * radius;
+                for (int dy = -radius; dy <= radius; dy++)
+                {
+                    for (int dx = -radius; dx <= radius; dx++)
+                    {
+                        int distance = dx * dx + dy * dy;
+                        if (distance < best && inside(sx + dx, sy + dy) != in)
+                            best = distance;
+                    }
+                }
+                float signedDistance = std::sqrt((float)best) * (in ? 1.0f : -1.0f);
+                float value = 0.5f + 0.5f * signedDistance / radius;
+                glyph.field[(size_t)fy * glyph.width + fx] = (unsigned char)std::max(0.0f, std::min(255.0f, value * 255.0f + 0.5f));
+            }
+        }
+    }
+}
+
+int RunFontBaker(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        std::cerr << "usage: AssetTool font <manifest> <image> <output directory> [--scale N] [--spread N]\n";
+        return 1;
+    }
+
+    std::string manifestPath = argv[0];
+    std::string imagePath = argv[1];
+    std::string outputDirectory = argv[2];
+    if (!outputDirectory.empty() && outputDirectory.back() != '/' && outputDirectory.back() != '\\')
+        outputDirectory += '/';
+
+    int scale = 3;
+    int spread = 4;
+    for (int i = 3; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "--scale") == 0)
+            scale = std::max(1, atoi(argv[i + 1]));
+        else if (strcmp(argv[i], "--spread") == 0)
+            spread = std::max(1, atoi(argv[i + 1]));
+    }
+
+    int width, height, channels;
+    unsigned char* pixels = stbi_load(imagePath.c_str(), &width, &height, &channels, 0);
+    if (!pixels)
+    {
+        std::cerr << "Failed to load font image: " << imagePath << std::endl;
+        return 1;
+    }
+
+    std::ifstream manifest(manifestPath);
+    if (!manifest)
+    {
+        std::cerr << "Failed to open manifest: " << manifestPath << std::endl;
+        stbi_image_free(pixels);
+        return 1;
+    }
+
+    int cellWidth = 0, cellHeight = 0, columns = 0;
+    std::vector<Glyph> glyphs;
+    std::string line;
+    while (std::getline(manifest, line))
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        std::istringstream fields(line);
+        std::string kind;
+        fields >> kind;
+        if (kind == "cell")
+        {
+            fields >> cellWidth >> cellHeight >> columns;
+            continue;
+        }
+
+        int groupY;
+        std::string characters;
+        if (kind != "group" || !(fields >> groupY >> characters) || columns <= 0)
+        {
+            std::cerr << manifestPath << ": bad line: " << line << std::endl;
+            stbi_image_free(pixels);
+            return 1;
+        }
+
+        for (size_t i = 0; i < characters.size(); i++)
+        {
+            int cellX = (int)(i % columns) * cellWidth;
+            int cellY = groupY + (int)(i / columns) * cellHeight;
+
+            // Ink bounds inside the cell
+            int minX = cellWidth, minY = cellHeight, maxX = -1, maxY = -1;
+            for (int y = 0; y < cellHeight && cellY + y < height; y++)
+            {
+                for (int x = 0; x < cellWidth && cellX + x < width; x++)
+                {
+                    if (!IsInk(pixels, width, channels, cellX + x, cellY + y))
+                        continue;
+                    minX = std::min(minX, x);
+                    minY = std::min(minY, y);
+                    maxX = std::max(maxX, x);
+                    maxY = std::max(maxY, y);
+                }
+            }
+            if (maxX < 0)
+            {
+                std::cerr << "No ink for '" << characters[i] << "'\n";
+                continue;
+            }
+
+            Glyph glyph;
+            glyph.character = characters[i];
+            glyph.inkX = cellX + minX;
+            glyph.inkY = cellY + minY;
+            glyph.inkWidth = maxX - minX + 1;
+            glyph.inkHeight = maxY - minY + 1;
+            glyph.cellY = cellY;
+            BakeField(pixels, width, height, channels, scale, spread, glyph);
+            glyphs.push_back(std::move(glyph));
+        }
+    }
+    stbi_image_free(pixels);
+
+    // One page is plenty for a bitmap font's worth of glyphs
+    const int atlasSize = 512;
+    std::vector<stbrp_rect> rects(glyphs.size());
+    for (size_t i = 0; i < glyphs.size(); i++)
+    {
+        rects[i].id = (int)i;
+        rects[i].w = glyphs[i].width + 1;
+        rects[i].h = glyphs[i].height + 1;
+    }
+    std::vector<stbrp_node> nodes(atlasSize);
+    stbrp_context context;
+    stbrp_init_target(&context, atlasSize, atlasSize, nodes.data(), (int)nodes.size());
+    if (!stbrp_pack_rects(&context, rects.data(), (int)rects.size()))
+    {
+        std::cerr << "Glyphs do not fit a " << atlasSize << " atlas, raise --scale\n";
+        return 1;
+    }
+
+    // Shrink to the used rows, multiples of four like the sprite atlas pages
+    int atlasHeight = 0;
+    for (const stbrp_rect& rect : rects)
+        atlasHeight = std::max(atlasHeight, rect.y + rect.h);
+    atlasHeight = (atlasHeight + 3) & ~3;
+
+    std::vector<unsigned char> atlas((size_t)atlasSize * atlasHeight, 0);
+    std::vector<FontGlyph> table;
+    int border = spread * scale;
+    for (const stbrp_rect& rect : rects)
+    {
+        const Glyph& glyph = glyphs[rect.id];
+        for (int y = 0; y < glyph.height; y++)
+            memcpy(&atlas[(size_t)(rect.y + y) * atlasSize + rect.x], &glyph.field[(size_t)y * glyph.width], glyph.width);
+
+        FontGlyph entry = {};
+        entry.codepoint = (unsigned char)glyph.character;
+        entry.x = (uint16_t)rect.x;
+        entry.y = (uint16_t)rect.y;
+        entry.width = (uint16_t)glyph.width;
+        entry.height = (uint16_t)glyph.height;
+        entry.offsetX = (int16_t)(-spread);
+        entry.offsetY = (int16_t)((glyph.inkY - border - glyph.cellY) / scale);
+        entry.advance = (uint16_t)((glyph.inkWidth + scale - 1) / scale + spread);
+        table.push_back(entry);
+    }
+    std::sort(table.begin(), table.end(), [](const FontGlyph& a, const FontGlyph& b) { return a.codepoint < b.codepoint; });
+
+    std::string atlasPath = outputDirectory + "font_sdf.png";
+    if (!stbi_write_png(atlasPath.c_str(), atlasSize, atlasHeight, 1, atlas.data(), atlasSize))
+    {
+        std::cerr << "Failed to write font atlas: " << atlasPath << std::endl;
+        return 1;
+    }
+
+    FontHeader header = {};
+    memcpy(header.magic, FONT_MAGIC, sizeof(header.magic));
+    header.version = FONT_VERSION;
+    header.glyphCount = (uint32_t)table.size();
+    header.atlasWidth = (uint16_t)atlasSize;
+    header.atlasHeight = (uint16_t)atlasHeight;
+    header.lineHeight = (uint16_t)(cellHeight / scale);
+    header.spread = (uint16_t)spread;
+    snprintf(header.atlasFile, sizeof(header.atlasFile), "font_sdf.png");
+
+    std::string tablePath = outputDirectory + "font.bin";
+    std::ofstream output(tablePath, std::ios::binary);
+    if (!output)
+    {
+        std::cerr << "Failed to write glyph table: " << tablePath << std::endl;
+        return 1;
+    }
+    output.write((const char*)&header, sizeof(header));
+    output.write((const char*)table.data(), table.size() * sizeof(FontGlyph));
+
+    std::cout << "Wrote " << atlasPath << " and " << tablePath << " (" << table.size() << " glyphs)\n";
+    return 0;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+// "AssetTool font <manifest> <image> <output directory> [--scale N] [--spread N]"
+//
+// Cuts the glyph cells described by the manifest out of a bitmap font sheet,
+// turns each into a signed distance field at 1/scale resolution and packs
+// them into font_sdf.png with the font.bin glyph table (see font_format.h).
+int RunFontBaker(int argc, char** argv);
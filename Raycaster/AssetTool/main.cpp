@@ -0,0 +1,46 @@
+#include <cstring>
+#include <iostream>
+
+#include "asset_packer.h"
+#include "atlas_packer.h"
+#include "font_baker.h"
+#include "map_converter.h"
+#include "texture_cooker.h"
+
+// Offline asset processing for the raycaster, run as a pre-build step
+static void PrintUsage()
+{
+    std::cerr << "usage: AssetTool <command> [arguments]\n"
+        << "commands:\n"
+        << "  atlas <manifest> <output directory> [--size N] [--padding N]\n"
+        << "  cook <manifest> <output directory> [--force]\n"
+        << "  font <manifest> <image> <output directory> [--scale N] [--spread N]\n"
+        << "  map <level or map> <output> [--pvs] [--threads N]\n"
+        << "  map --generate <width> <height> <seed> <output> [--template <png>] [--pvs] [--threads N]\n"
+        << "  pack <output> <root directory> <directory>... [--exclude .ext]...\n";
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    const char* command = argv[1];
+    if (strcmp(command, "atlas") == 0)
+        return RunAtlasPacker(argc - 2, argv + 2);
+    if (strcmp(command, "cook") == 0)
+        return RunTextureCooker(argc - 2, argv + 2);
+    if (strcmp(command, "font") == 0)
+        return RunFontBaker(argc - 2, argv + 2);
+    if (strcmp(command, "map") == 0)
+        return RunMapConverter(argc - 2, argv + 2);
+    if (strcmp(command, "pack") == 0)
+        return RunAssetPacker(argc - 2, argv + 2);
+
+    std::cerr << "Unknown command: " << command << std::endl;
+    PrintUsage();
+    return 1;
+}
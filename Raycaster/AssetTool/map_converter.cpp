@@ -0,0 +1,87 @@
+#include "map_converter.h"
+#include "map.h"
+#include "map_generator.h"
+#include "map_pvs.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+int RunMapConverter(int argc, char** argv)
+{
+    bool generate = argc > 0 && strcmp(argv[0], "--generate") == 0;
+    if (argc < 2 || (generate && argc < 5))
+    {
+        std::cerr << "usage: AssetTool map <level or map> <output> [--pvs] [--threads N]\n"
+            << "       AssetTool map --generate <width> <height> <seed> <output> [--template <png>] [--pvs] [--threads N]\n";
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    // Options after the paths
+    const char* templatePath = nullptr;
+    bool buildPvs = false;
+    int threads = 0;
+    for (int i = generate ? 5 : 2; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--pvs") == 0)
+            buildPvs = true;
+        else if (strcmp(argv[i], "--template") == 0 && i + 1 < argc)
+            templatePath = argv[++i];
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            threads = atoi(argv[++i]);
+    }
+
+    Map map;
+    std::string outputPath;
+    if (generate)
+    {
+        int width = atoi(argv[1]);
+        int height = atoi(argv[2]);
+        if (width <= 0 || height <= 0)
+        {
+            std::cerr << "Invalid map size: " << argv[1] << "x" << argv[2] << std::endl;
+            return 1;
+        }
+        outputPath = argv[4];
+
+        // Herringbone Wang tiles from a template, the room grid without one
+        MapGenerator generator;
+        if (templatePath && !generator.LoadTemplate(templatePath))
+            return 1;
+        generator.Generate(map, width, height, (uint32_t)strtoul(argv[3], nullptr, 10), threads);
+    }
+    else
+    {
+        // A binary map is read as it is, to add its PVS
+        std::string inputPath = argv[0];
+        bool binary = inputPath.size() >= 5 && inputPath.compare(inputPath.size() - 5, 5, ".rmap") == 0;
+        if (binary ? !map.LoadBinary(inputPath) : !map.LoadText(inputPath))
+            return 1;
+        outputPath = argv[1];
+    }
+
+    double pvsMs = 0;
+    if (buildPvs)
+    {
+        auto pvsStart = std::chrono::steady_clock::now();
+        MapPvs pvs;
+        pvs.Build(map, threads);
+        pvsMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - pvsStart).count();
+    }
+
+    // The output may be the mapped input
+    if (map.HasFile() ? !map.SaveAndReopen(outputPath) : !map.SaveBinary(outputPath))
+        return 1;
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Wrote " << outputPath << " (" << map.Width() << "x" << map.Height() << ", "
+        << map.ChunksX() * map.ChunksY() << " chunks) in " << ms << " ms";
+    if (buildPvs)
+        std::cout << ", PVS in " << pvsMs << " ms";
+    std::cout << "\n";
+    return 0;
+}
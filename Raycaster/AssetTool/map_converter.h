@@ -0,0 +1,9 @@
+#pragma once
+
+// "AssetTool map <level> <output>" converts a text level to the chunked binary
+// map format (see map_format.h), a binary .rmap is read as it is.
+// "AssetTool map --generate <width> <height> <seed> <output>" writes a
+// generated map instead, for testing large levels.
+// "--pvs" computes the potentially visible sets into the output, on every core
+// or "--threads N".
+int RunMapConverter(int argc, char** argv);
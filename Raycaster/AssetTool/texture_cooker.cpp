@@ -0,0 +1,225 @@
+#include "texture_cooker.h"
+#include "content_hash.h"
+#include "cooked_format.h"
+
+#include <stb_image.h>
+#include <stb_image_resize2.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+    bool ReadFile(const std::string& path, std::vector<unsigned char>& bytes)
+    {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file)
+            return false;
+        bytes.resize((size_t)file.tellg());
+        file.seekg(0);
+        return (bool)file.read((char*)bytes.data(), bytes.size());
+    }
+
+    bool IsPowerOfTwo(int value)
+    {
+        return value > 0 && (value & (value - 1)) == 0;
+    }
+
+    bool IsUpToDate(const std::string& outputPath, uint64_t sourceHash)
+    {
+        std::ifstream file(outputPath, std::ios::binary);
+        CookedHeader header;
+        if (!file || !file.read((char*)&header, sizeof(header)))
+            return false;
+        return memcmp(header.magic, COOKED_MAGIC, sizeof(header.magic)) == 0 && header.version == COOKED_VERSION
+            && header.sourceHash == sourceHash;
+    }
+
+    stbir_pixel_layout PixelLayout(int channels)
+    {
+        switch (channels)
+        {
+        case 1: return STBIR_1CHANNEL;
+        case 2: return STBIR_RA;
+        case 3: return STBIR_RGB;
+        default: return STBIR_RGBA;
+        }
+    }
+
+    bool CookTexture(const std::string& sourcePath, const std::string& outputPath, int tileWidth, int tileHeight, bool force)
+    {
+        std::vector<unsigned char> bytes;
+        if (!ReadFile(sourcePath, bytes))
+        {
+            std::cerr << "Failed to read image: " << sourcePath << std::endl;
+            return false;
+        }
+
+        uint64_t hash = HashContent(bytes.data(), bytes.size());
+        hash = HashContent(&COOKED_VERSION, sizeof(COOKED_VERSION), hash);
+        hash = HashContent(&tileWidth, sizeof(tileWidth), hash);
+        hash = HashContent(&tileHeight, sizeof(tileHeight), hash);
+        if (!force && IsUpToDate(outputPath, hash))
+        {
+            std::cout << "Up to date " << outputPath << "\n";
+            return true;
+        }
+
+        int width, height, channels;
+        unsigned char* pixels = stbi_load_from_memory(bytes.data(), (int)bytes.size(), &width, &height, &channels, 0);
+        if (!pixels)
+        {
+            std::cerr << "Failed to decode image: " << sourcePath << std::endl;
+            return false;
+        }
+
+        bool tiled = tileWidth > 0 && tileHeight > 0;
+        if (!tiled)
+        {
+            tileWidth = width;
+            tileHeight = height;
+        }
+        else if (!IsPowerOfTwo(tileWidth) || !IsPowerOfTwo(tileHeight) || width % tileWidth != 0 || height % tileHeight != 0)
+        {
+            std::cerr << sourcePath << ": tiles must be powers of two that divide the image\n";
+            stbi_image_free(pixels);
+            return false;
+        }
+
+        // Tiled chains end when a tile is one texel wide or high, untiled ones at 1x1
+        int levelCount = 1;
+        while (true)
+        {
+            int tw = tileWidth >> levelCount, th = tileHeight >> levelCount;
+            if (tiled ? (tw < 1 || th < 1) : (tw < 1 && th < 1))
+                break;
+            levelCount++;
+        }
+
+        int tilesX = width / tileWidth;
+        int tilesY = height / tileHeight;
+        std::vector<CookedLevel> levels(levelCount);
+        std::vector<std::vector<unsigned char>> levelPixels(levelCount);
+        uint64_t offset = sizeof(CookedHeader) + levelCount * sizeof(CookedLevel);
+        for (int level = 0; level < levelCount; level++)
+        {
+            int levelTileWidth = std::max(1, tileWidth >> level);
+            int levelTileHeight = std::max(1, tileHeight >> level);
+            int levelWidth = levelTileWidth * tilesX;
+            int levelHeight = levelTileHeight * tilesY;
+            size_t stride = (size_t)levelWidth * channels;
+            std::vector<unsigned char> image(stride * levelHeight);
+
+            if (level == 0)
+            {
+                memcpy(image.data(), pixels, image.size());
+            }
+            else
+            {
+                // Every level comes straight from the full resolution tile, in linear light
+                for (int ty = 0; ty < tilesY; ty++)
+                {
+                    for (int tx = 0; tx < tilesX; tx++)
+                    {
+                        const unsigned char* source = pixels + ((size_t)ty * tileHeight * width + (size_t)tx * tileWidth) * channels;
+                        unsigned char* dest = image.data() + (size_t)ty * levelTileHeight * stride + (size_t)tx * levelTileWidth * channels;
+                        stbir_resize(source, tileWidth, tileHeight, width * channels,
+                            dest, levelTileWidth, levelTileHeight, (int)stride,
+                            PixelLayout(channels), STBIR_TYPE_UINT8_SRGB, STBIR_EDGE_CLAMP, STBIR_FILTER_DEFAULT);
+                    }
+                }
+            }
+
+            // Bottom-up rows, as OpenGL expects
+            std::vector<unsigned char>& flipped = levelPixels[level];
+            flipped.resize(image.size());
+            for (int y = 0; y < levelHeight; y++)
+                memcpy(&flipped[(size_t)y * stride], &image[(size_t)(levelHeight - 1 - y) * stride], stride);
+
+            levels[level].width = (uint32_t)levelWidth;
+            levels[level].height = (uint32_t)levelHeight;
+            levels[level].offset = offset;
+            levels[level].size = flipped.size();
+            offset += flipped.size();
+        }
+        stbi_image_free(pixels);
+
+        CookedHeader header = {};
+        memcpy(header.magic, COOKED_MAGIC, sizeof(header.magic));
+        header.version = COOKED_VERSION;
+        header.sourceHash = hash;
+        header.width = (uint32_t)width;
+        header.height = (uint32_t)height;
+        header.channels = (uint32_t)channels;
+        header.tileWidth = (uint32_t)tileWidth;
+        header.tileHeight = (uint32_t)tileHeight;
+        header.levelCount = (uint32_t)levelCount;
+
+        std::ofstream output(outputPath, std::ios::binary);
+        if (!output)
+        {
+            std::cerr << "Failed to write cooked texture: " << outputPath << std::endl;
+            return false;
+        }
+        output.write((const char*)&header, sizeof(header));
+        output.write((const char*)levels.data(), levels.size() * sizeof(CookedLevel));
+        for (const std::vector<unsigned char>& level : levelPixels)
+            output.write((const char*)level.data(), level.size());
+
+        std::cout << "Cooked " << outputPath << " (" << width << "x" << height << ", " << levelCount << " levels)\n";
+        return true;
+    }
+}
+
+int RunTextureCooker(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "usage: AssetTool cook <manifest> <output directory> [--force]\n";
+        return 1;
+    }
+
+    std::string manifestPath = argv[0];
+    std::string outputDirectory = argv[1];
+    if (!outputDirectory.empty() && outputDirectory.back() != '/' && outputDirectory.back() != '\\')
+        outputDirectory += '/';
+    bool force = argc > 2 && strcmp(argv[2], "--force") == 0;
+
+    std::ifstream manifest(manifestPath);
+    if (!manifest)
+    {
+        std::cerr << "Failed to open manifest: " << manifestPath << std::endl;
+        return 1;
+    }
+
+    size_t slash = manifestPath.find_last_of("/\\");
+    std::string directory = slash == std::string::npos ? "" : manifestPath.substr(0, slash + 1);
+
+    bool ok = true;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(manifest, line))
+    {
+        lineNumber++;
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        std::istringstream fields(line);
+        std::string file;
+        int tileWidth, tileHeight;
+        if (!(fields >> file >> tileWidth >> tileHeight))
+        {
+            std::cerr << manifestPath << ":" << lineNumber << ": expected 3 fields\n";
+            return 1;
+        }
+
+        std::string name = file.substr(0, file.find_last_of('.'));
+        ok &= CookTexture(directory + file, outputDirectory + name + ".ctex", tileWidth, tileHeight, force);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+// "AssetTool cook <manifest> <output directory> [--force]"
+//
+// Converts the images listed in the manifest into cooked textures (see
+// cooked_format.h) with a gamma-correct, edge-clamped mip chain built per
+// tile by stb_image_resize2. Outputs whose recorded source hash still
+// matches are left alone, so only changed images are cooked again.
+int RunTextureCooker(int argc, char** argv);
@@ -0,0 +1,184 @@
+#include "alloc_tracker.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+namespace AllocTracker
+{
+    namespace
+    {
+        // Plain data so the thread_local needs no dynamic initialization,
+        // which could itself allocate.
+        struct ThreadCounters
+        {
+            uint64_t allocations;
+            uint64_t frees;
+            uint64_t bytes;
+        };
+
+        thread_local ThreadCounters threadCounters;
+
+        std::atomic<uint64_t> globalAllocations{ 0 };
+        std::atomic<uint64_t> globalFrees{ 0 };
+        std::atomic<uint64_t> globalBytes{ 0 };
+
+        inline void CountAllocation(size_t size)
+        {
+            threadCounters.allocations++;
+            threadCounters.bytes += size;
+            globalAllocations.fetch_add(1, std::memory_order_relaxed);
+            globalBytes.fetch_add(size, std::memory_order_relaxed);
+        }
+
+        inline void CountFree()
+        {
+            threadCounters.frees++;
+            globalFrees.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    Stats ThreadStats()
+    {
+        Stats stats;
+        stats.allocations = threadCounters.allocations;
+        stats.frees = threadCounters.frees;
+        stats.bytes = threadCounters.bytes;
+        return stats;
+    }
+
+    Stats GlobalStats()
+    {
+        Stats stats;
+        stats.allocations = globalAllocations.load(std::memory_order_relaxed);
+        stats.frees = globalFrees.load(std::memory_order_relaxed);
+        stats.bytes = globalBytes.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    void* Malloc(size_t size)
+    {
+        CountAllocation(size);
+        return malloc(size);
+    }
+
+    void* Realloc(void* ptr, size_t size)
+    {
+        CountAllocation(size);
+        if (ptr)
+            CountFree();
+        return realloc(ptr, size);
+    }
+
+    void Free(void* ptr)
+    {
+        if (!ptr)
+            return;
+        CountFree();
+        free(ptr);
+    }
+
+    void* ImGuiAlloc(size_t size, void* userData)
+    {
+        (void)userData;
+        return Malloc(size);
+    }
+
+    void ImGuiFree(void* ptr, void* userData)
+    {
+        (void)userData;
+        Free(ptr);
+    }
+}
+
+#ifndef RAYCASTER_DISABLE_ALLOC_TRACKING
+
+void* operator new(size_t size)
+{
+    void* ptr = AllocTracker::Malloc(size ? size : 1);
+    if (!ptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    return AllocTracker::Malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    return AllocTracker::Malloc(size ? size : 1);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    AllocTracker::Free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    AllocTracker::Free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    AllocTracker::Free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+    AllocTracker::Free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+    AllocTracker::Free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+    AllocTracker::Free(ptr);
+}
+
+#endif
+
+FrameArena::FrameArena(size_t capacity)
+    : _memory(static_cast<unsigned char*>(AllocTracker::Malloc(capacity))), _capacity(capacity)
+{
+}
+
+FrameArena::~FrameArena()
+{
+    AllocTracker::Free(_memory);
+}
+
+void* FrameArena::Allocate(size_t size, size_t alignment)
+{
+    size_t offset = (_used + alignment - 1) & ~(alignment - 1);
+    if (offset + size > _capacity)
+    {
+        if (!_overflowReported)
+        {
+            std::cerr << "FrameArena: out of memory (" << _capacity << " bytes), increase its capacity\n";
+            _overflowReported = true;
+        }
+        return nullptr;
+    }
+
+    _used = offset + size;
+    if (_used > _highWater)
+        _highWater = _used;
+    return _memory + offset;
+}
+
+void FrameArena::Reset()
+{
+    _used = 0;
+}
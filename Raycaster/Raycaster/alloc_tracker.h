@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Heap allocation counting.
+//
+// The global operator new/delete are replaced so every C++ allocation is
+// counted, per thread and globally. C libraries with their own allocator hooks
+// (stb_image, ImGui) are routed through Malloc/Realloc/Free so they are
+// counted as well. Define RAYCASTER_DISABLE_ALLOC_TRACKING to keep the
+// default allocator.
+
+namespace AllocTracker
+{
+    struct Stats
+    {
+        uint64_t allocations = 0;
+        uint64_t frees = 0;
+        uint64_t bytes = 0;     // bytes requested, frees are not subtracted
+    };
+
+    // Counters of the calling thread
+    Stats ThreadStats();
+
+    // Counters of all threads together
+    Stats GlobalStats();
+
+    void* Malloc(size_t size);
+    void* Realloc(void* ptr, size_t size);
+    void Free(void* ptr);
+
+    // Signatures matching ImGui::SetAllocatorFunctions
+    void* ImGuiAlloc(size_t size, void* userData);
+    void ImGuiFree(void* ptr, void* userData);
+}
+
+// Bump allocator for data that only lives for one frame. Reset at the start of
+// every frame; memory is never returned individually and destructors do not run,
+// so only use it for trivially destructible data.
+class FrameArena
+{
+public:
+    explicit FrameArena(size_t capacity);
+    ~FrameArena();
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    // Returns nullptr when the arena is full
+    void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+    template <typename T>
+    T* Allocate(size_t count)
+    {
+        return static_cast<T*>(Allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    void Reset();
+
+    size_t Used() const { return _used; }
+    size_t HighWater() const { return _highWater; }
+    size_t Capacity() const { return _capacity; }
+
+private:
+    unsigned char* _memory;
+    size_t _capacity;
+    size_t _used = 0;
+    size_t _highWater = 0;
+    bool _overflowReported = false;
+};
@@ -0,0 +1,814 @@
+#include "asset_loader.h"
+#include "alloc_tracker.h"
+#include "asset_pack.h"
+#include "cooked_format.h"
+#include "perf_counters.h"
+#include "profiler.h"
+#include "texture_residency.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_MALLOC(size) AllocTracker::Malloc(size)
+#define STBI_REALLOC(ptr, size) AllocTracker::Realloc(ptr, size)
+#define STBI_FREE(ptr) AllocTracker::Free(ptr)
+#include <stb_image.h>
+
+#define STB_DXT_IMPLEMENTATION
+#include <stb_dxt.h>
+
+namespace
+{
+    const char DXT_CACHE_MAGIC[4] = { 'R', 'D', 'X', 'T' };
+    const uint32_t DXT_CACHE_VERSION = 2;
+
+    struct DxtCacheHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint64_t sourceHash;
+        uint32_t format;
+        uint32_t width;
+        uint32_t height;
+        uint32_t levelCount;
+    };
+
+    bool ReadDxtCache(const std::string& path, uint64_t sourceHash, MipChain& image)
+    {
+        std::ifstream file(path, std::ios::binary);
+        DxtCacheHeader header;
+        if (!file || !file.read((char*)&header, sizeof(header)))
+            return false;
+        if (memcmp(header.magic, DXT_CACHE_MAGIC, sizeof(header.magic)) != 0 || header.version != DXT_CACHE_VERSION
+            || header.sourceHash != sourceHash || header.levelCount == 0 || header.levelCount > 32)
+            return false;
+
+        std::vector<uint32_t> levelSizes(header.levelCount);
+        if (!file.read((char*)levelSizes.data(), levelSizes.size() * sizeof(uint32_t)))
+            return false;
+
+        size_t total = 0;
+        image.levelSizes.clear();
+        for (uint32_t size : levelSizes)
+        {
+            image.levelSizes.push_back(size);
+            total += size;
+        }
+        image.data.resize(total);
+        image.format = header.format;
+        image.compressed = true;
+        image.width = (int)header.width;
+        image.height = (int)header.height;
+        return (bool)file.read((char*)image.data.data(), total);
+    }
+
+    void WriteDxtCache(const std::string& path, uint64_t sourceHash, const MipChain& image)
+    {
+        std::ofstream file(path, std::ios::binary);
+        if (!file)
+            return;
+
+        DxtCacheHeader header;
+        memcpy(header.magic, DXT_CACHE_MAGIC, sizeof(header.magic));
+        header.version = DXT_CACHE_VERSION;
+        header.sourceHash = sourceHash;
+        header.format = image.format;
+        header.width = (uint32_t)image.width;
+        header.height = (uint32_t)image.height;
+        header.levelCount = (uint32_t)image.levelSizes.size();
+        file.write((const char*)&header, sizeof(header));
+        for (size_t size : image.levelSizes)
+        {
+            uint32_t size32 = (uint32_t)size;
+            file.write((const char*)&size32, sizeof(size32));
+        }
+        file.write((const char*)image.Bytes(), image.ByteCount());
+    }
+
+    // Append one level, partial blocks at the right and top edges repeat the last texel
+    void CompressLevel(const unsigned char* rgba, int width, int height, bool alpha, std::vector<unsigned char>& out)
+    {
+        int blockSize = alpha ? 16 : 8;
+        int blocksX = (width + 3) / 4;
+        int blocksY = (height + 3) / 4;
+        size_t offset = out.size();
+        out.resize(offset + (size_t)blocksX * blocksY * blockSize);
+
+        unsigned char block[16 * 4];
+        for (int by = 0; by < blocksY; by++)
+        {
+            for (int bx = 0; bx < blocksX; bx++)
+            {
+                for (int y = 0; y < 4; y++)
+                {
+                    int sy = std::min(by * 4 + y, height - 1);
+                    for (int x = 0; x < 4; x++)
+                    {
+                        int sx = std::min(bx * 4 + x, width - 1);
+                        memcpy(&block[(y * 4 + x) * 4], &rgba[((size_t)sy * width + sx) * 4], 4);
+                    }
+                }
+                stb_compress_dxt_block(&out[offset], block, alpha ? 1 : 0, STB_DXT_HIGHQUAL);
+                offset += blockSize;
+            }
+        }
+    }
+
+    // 2x2 box filter, odd edges fold the last row or column in
+    void Downsample(const std::vector<unsigned char>& source, int width, int height, std::vector<unsigned char>& dest)
+    {
+        int destWidth = std::max(1, width / 2);
+        int destHeight = std::max(1, height / 2);
+        dest.resize((size_t)destWidth * destHeight * 4);
+        for (int y = 0; y < destHeight; y++)
+        {
+            int y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+            for (int x = 0; x < destWidth; x++)
+            {
+                int x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+                for (int c = 0; c < 4; c++)
+                {
+                    int sum = source[((size_t)y0 * width + x0) * 4 + c] + source[((size_t)y0 * width + x1) * 4 + c]
+                        + source[((size_t)y1 * width + x0) * 4 + c] + source[((size_t)y1 * width + x1) * 4 + c];
+                    dest[((size_t)y * destWidth + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+                }
+            }
+        }
+    }
+
+    // Grey images keep their grey in all three colour channels, returns whether any texel has alpha
+    bool ExpandToRgba(const unsigned char* pixels, size_t count, int channels, std::vector<unsigned char>& rgba)
+    {
+        rgba.resize(count * 4);
+        bool alpha = false;
+        for (size_t i = 0; i < count; i++)
+        {
+            const unsigned char* src = &pixels[i * channels];
+            unsigned char* dst = &rgba[i * 4];
+            dst[0] = src[0];
+            dst[1] = channels >= 3 ? src[1] : src[0];
+            dst[2] = channels >= 3 ? src[2] : src[0];
+            dst[3] = channels == 2 ? src[1] : channels == 4 ? src[3] : 255;
+            alpha |= dst[3] != 255;
+        }
+        return alpha;
+    }
+
+    void CompressImage(const DecodedImage& image, bool mipmaps, MipChain& compressed)
+    {
+        PROFILE_ZONE("CompressImage");
+
+        std::vector<unsigned char> rgba;
+        bool alpha = ExpandToRgba(image.pixels, (size_t)image.width * image.height, image.channels, rgba);
+
+        compressed.format = alpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        compressed.compressed = true;
+        compressed.width = image.width;
+        compressed.height = image.height;
+        compressed.levelSizes.clear();
+        compressed.data.clear();
+
+        int width = image.width;
+        int height = image.height;
+        std::vector<unsigned char> next;
+        while (true)
+        {
+            size_t before = compressed.data.size();
+            CompressLevel(rgba.data(), width, height, alpha, compressed.data);
+            compressed.levelSizes.push_back(compressed.data.size() - before);
+            if (!mipmaps || (width == 1 && height == 1))
+                break;
+
+            Downsample(rgba, width, height, next);
+            rgba.swap(next);
+            width = std::max(1, width / 2);
+            height = std::max(1, height / 2);
+        }
+    }
+
+    // Compress the levels of a cooked chain as they are, keeping its per-tile mips.
+    // A 4x4 block holding texels of two tiles would blend them, so a tiled
+    // chain ends at the last level where tiles are still whole blocks.
+    void CompressMipChain(const MipChain& source, int channels, int tileWidth, int tileHeight, MipChain& compressed)
+    {
+        PROFILE_ZONE("CompressMipChain");
+
+        std::vector<unsigned char> rgba;
+        bool alpha = ExpandToRgba(source.Bytes(), (size_t)source.width * source.height, channels, rgba);
+
+        compressed.format = alpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        compressed.compressed = true;
+        compressed.width = source.width;
+        compressed.height = source.height;
+        compressed.levelSizes.clear();
+        compressed.data.clear();
+
+        bool tiled = tileWidth < source.width || tileHeight < source.height;
+        int width = source.width;
+        int height = source.height;
+        size_t offset = 0;
+        for (size_t size : source.levelSizes)
+        {
+            if (tiled && (tileWidth < 4 || tileHeight < 4) && !compressed.levelSizes.empty())
+                break;
+            ExpandToRgba(source.Bytes() + offset, (size_t)width * height, channels, rgba);
+            size_t before = compressed.data.size();
+            CompressLevel(rgba.data(), width, height, alpha, compressed.data);
+            compressed.levelSizes.push_back(compressed.data.size() - before);
+            offset += size;
+            width = std::max(1, width / 2);
+            height = std::max(1, height / 2);
+            tileWidth /= 2;
+            tileHeight /= 2;
+        }
+    }
+
+    // Drops the levels past maxLevel, they would never be sampled
+    void TruncateMipChain(MipChain& chain, int maxLevel)
+    {
+        if (maxLevel < 0 || chain.levelSizes.size() <= (size_t)maxLevel + 1)
+            return;
+        chain.levelSizes.resize((size_t)maxLevel + 1);
+        size_t bytes = 0;
+        for (size_t size : chain.levelSizes)
+            bytes += size;
+        if (chain.mapped)
+            chain.mappedSize = bytes;
+        else
+            chain.data.resize(bytes);
+    }
+
+    // Colour half of a BC1 or BC3 block into a 4x4 RGBA block, alpha left at 255
+    void DecodeColorBlock(const unsigned char* block, bool threeColor, unsigned char* out)
+    {
+        unsigned colors[2] = { (unsigned)(block[0] | block[1] << 8), (unsigned)(block[2] | block[3] << 8) };
+        unsigned char palette[4][4];
+        for (int i = 0; i < 2; i++)
+        {
+            palette[i][0] = (unsigned char)(((colors[i] >> 11) & 31) * 255 / 31);
+            palette[i][1] = (unsigned char)(((colors[i] >> 5) & 63) * 255 / 63);
+            palette[i][2] = (unsigned char)((colors[i] & 31) * 255 / 31);
+            palette[i][3] = 255;
+        }
+        bool fourColor = !threeColor || colors[0] > colors[1];
+        for (int c = 0; c < 4; c++)
+        {
+            palette[2][c] = (unsigned char)(fourColor ? (palette[0][c] * 2 + palette[1][c]) / 3 : (palette[0][c] + palette[1][c]) / 2);
+            palette[3][c] = (unsigned char)(fourColor ? (palette[0][c] + palette[1][c] * 2) / 3 : 0);
+        }
+        uint32_t indices = block[4] | block[5] << 8 | block[6] << 16 | (uint32_t)block[7] << 24;
+        for (int i = 0; i < 16; i++)
+            memcpy(&out[i * 4], palette[(indices >> (i * 2)) & 3], 4);
+    }
+
+    // Alpha half of a BC3 block into the alpha of a 4x4 RGBA block
+    void DecodeAlphaBlock(const unsigned char* block, unsigned char* out)
+    {
+        unsigned char palette[8] = { block[0], block[1] };
+        for (int i = 2; i < 8; i++)
+        {
+            if (block[0] > block[1])
+                palette[i] = (unsigned char)((block[0] * (8 - i) + block[1] * (i - 1)) / 7);
+            else
+                palette[i] = i < 6 ? (unsigned char)((block[0] * (6 - i) + block[1] * (i - 1)) / 5) : i == 6 ? 0 : 255;
+        }
+        uint64_t indices = 0;
+        for (int i = 0; i < 6; i++)
+            indices |= (uint64_t)block[2 + i] << (i * 8);
+        for (int i = 0; i < 16; i++)
+            out[i * 4 + 3] = palette[(indices >> (i * 3)) & 7];
+    }
+
+    // Back to a raw RGBA chain, for drivers without S3TC
+    void DecompressMipChain(MipChain& chain)
+    {
+        PROFILE_ZONE("DecompressMipChain");
+
+        bool alpha = chain.format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        int blockSize = alpha ? 16 : 8;
+        std::vector<size_t> levelSizes;
+        std::vector<unsigned char> rgba;
+        unsigned char block[16 * 4];
+        int width = chain.width;
+        int height = chain.height;
+        const unsigned char* source = chain.Bytes();
+        for (size_t size : chain.levelSizes)
+        {
+            size_t offset = rgba.size();
+            rgba.resize(offset + (size_t)width * height * 4);
+            int blocksX = (width + 3) / 4;
+            int blocksY = (height + 3) / 4;
+            for (int by = 0; by < blocksY; by++)
+            {
+                for (int bx = 0; bx < blocksX; bx++)
+                {
+                    const unsigned char* encoded = source + ((size_t)by * blocksX + bx) * blockSize;
+                    DecodeColorBlock(alpha ? encoded + 8 : encoded, !alpha, block);
+                    if (alpha)
+                        DecodeAlphaBlock(encoded, block);
+
+                    // Partial blocks at the edges drop the texels past them
+                    for (int y = 0; y < 4 && by * 4 + y < height; y++)
+                        for (int x = 0; x < 4 && bx * 4 + x < width; x++)
+                            memcpy(&rgba[offset + ((size_t)(by * 4 + y) * width + bx * 4 + x) * 4], &block[(y * 4 + x) * 4], 4);
+                }
+            }
+            levelSizes.push_back(rgba.size() - offset);
+            source += size;
+            width = std::max(1, width / 2);
+            height = std::max(1, height / 2);
+        }
+
+        chain.format = GL_RGBA;
+        chain.compressed = false;
+        chain.levelSizes.swap(levelSizes);
+        chain.data.swap(rgba);
+        chain.mapped = nullptr;
+        chain.mappedSize = 0;
+    }
+
+    // Raw RGBA chain with box filtered levels, for streamed textures that were not cooked
+    void BuildMipChain(const DecodedImage& image, MipChain& chain)
+    {
+        PROFILE_ZONE("BuildMipChain");
+
+        std::vector<unsigned char> rgba;
+        ExpandToRgba(image.pixels, (size_t)image.width * image.height, image.channels, rgba);
+
+        chain.format = GL_RGBA;
+        chain.compressed = false;
+        chain.width = image.width;
+        chain.height = image.height;
+        chain.levelSizes.clear();
+        chain.data.clear();
+
+        int width = image.width;
+        int height = image.height;
+        std::vector<unsigned char> next;
+        while (true)
+        {
+            chain.data.insert(chain.data.end(), rgba.begin(), rgba.end());
+            chain.levelSizes.push_back(rgba.size());
+            if (width == 1 && height == 1)
+                break;
+
+            Downsample(rgba, width, height, next);
+            rgba.swap(next);
+            width = std::max(1, width / 2);
+            height = std::max(1, height / 2);
+        }
+    }
+
+    GLenum ChannelFormat(int channels)
+    {
+        switch (channels)
+        {
+        case 1: return GL_RED;
+        case 2: return GL_RG;
+        case 3: return GL_RGB;
+        default: return GL_RGBA;
+        }
+    }
+
+    // "images/sheet.png" -> "images/cooked/sheet.ctex"
+    std::string CookedPath(const std::string& path)
+    {
+        size_t slash = path.find_last_of("/\\");
+        size_t nameStart = slash == std::string::npos ? 0 : slash + 1;
+        size_t dot = path.find_last_of('.');
+        if (dot == std::string::npos || dot < nameStart)
+            dot = path.size();
+        return path.substr(0, nameStart) + "cooked/" + path.substr(nameStart, dot - nameStart) + ".ctex";
+    }
+
+    // Levels are already laid out back to back after the header. Mapped assets
+    // are used in place, loose files hand their storage over to the chain.
+    bool ParseCooked(AssetData& asset, MipChain& chain, int& channels, int& tileWidth, int& tileHeight)
+    {
+        if (asset.size < sizeof(CookedHeader))
+            return false;
+        CookedHeader header;
+        memcpy(&header, asset.data, sizeof(header));
+        if (memcmp(header.magic, COOKED_MAGIC, sizeof(header.magic)) != 0 || header.version != COOKED_VERSION
+            || header.levelCount == 0 || header.levelCount > 32 || header.channels < 1 || header.channels > 4)
+            return false;
+
+        size_t tableEnd = sizeof(CookedHeader) + header.levelCount * sizeof(CookedLevel);
+        if (asset.size < tableEnd)
+            return false;
+
+        chain.levelSizes.clear();
+        size_t expected = tableEnd;
+        for (uint32_t i = 0; i < header.levelCount; i++)
+        {
+            CookedLevel level;
+            memcpy(&level, asset.data + sizeof(CookedHeader) + i * sizeof(CookedLevel), sizeof(level));
+            if (level.offset != expected || level.offset + level.size > asset.size)
+                return false;
+            chain.levelSizes.push_back((size_t)level.size);
+            expected += (size_t)level.size;
+        }
+
+        channels = (int)header.channels;
+        tileWidth = (int)header.tileWidth;
+        tileHeight = (int)header.tileHeight;
+        chain.format = ChannelFormat(channels);
+        chain.compressed = false;
+        chain.width = (int)header.width;
+        chain.height = (int)header.height;
+        if (asset.mapped)
+        {
+            chain.mapped = asset.data + tableEnd;
+            chain.mappedSize = expected - tableEnd;
+        }
+        else
+        {
+            asset.storage.erase(asset.storage.begin(), asset.storage.begin() + tableEnd);
+            asset.storage.resize(expected - tableEnd);
+            chain.data.swap(asset.storage);
+        }
+        return true;
+    }
+}
+
+DecodedImage DecodeImage(const std::string& filePath, bool flipVertically)
+{
+    PROFILE_ZONE("DecodeImage");
+
+    DecodedImage image;
+    image.path = filePath;
+
+    // Flip image vertically as OpenGL expects the 0.0 coordinate to be at the bottom left corner
+    stbi_set_flip_vertically_on_load_thread(flipVertically);
+    AssetData asset;
+    if (ReadAsset(filePath, asset))
+        image.pixels = stbi_load_from_memory(asset.data, (int)asset.size, &image.width, &image.height, &image.channels, 0);
+    return image;
+}
+
+void FreeImage(DecodedImage& image)
+{
+    stbi_image_free(image.pixels);
+    image.pixels = nullptr;
+}
+
+AssetLoader::~AssetLoader()
+{
+    // Without a GL context only the workers can be stopped safely
+    if (!_workers.empty())
+    {
+        {
+            std::lock_guard<std::mutex> lock(_jobMutex);
+            _stopping = true;
+        }
+        _jobCondition.notify_all();
+        for (std::thread& worker : _workers)
+            worker.join();
+    }
+
+    Result result;
+    while (_results.Pop(result))
+        FreeImage(result.image);
+}
+
+void AssetLoader::Start(int workerCount)
+{
+    if (workerCount <= 0)
+        workerCount = std::max(1, std::min(4, (int)std::thread::hardware_concurrency() - 1));
+
+    for (int i = 0; i < workerCount; i++)
+        _workers.emplace_back(&AssetLoader::WorkerLoop, this, i);
+}
+
+void AssetLoader::Shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(_jobMutex);
+        _stopping = true;
+        _jobs.clear();
+    }
+    _jobCondition.notify_all();
+    for (std::thread& worker : _workers)
+        worker.join();
+    _workers.clear();
+
+    Result result;
+    while (_results.Pop(result))
+        FreeImage(result.image);
+
+    for (Entry& entry : _entries)
+        if (entry.texture)
+            glDeleteTextures(1, &entry.texture);
+    _entries.clear();
+
+    if (_pbos[0])
+        glDeleteBuffers(PBO_COUNT, _pbos);
+    memset(_pbos, 0, sizeof(_pbos));
+}
+
+int AssetLoader::FindOrAddEntry(const std::string& path, const TextureOptions& options)
+{
+    for (size_t i = 0; i < _entries.size(); i++)
+        if (_entries[i].path == path)
+            return (int)i;
+
+    Entry entry;
+    entry.path = path;
+    entry.options = options;
+    _entries.push_back(entry);
+    int index = (int)_entries.size() - 1;
+
+    {
+        std::lock_guard<std::mutex> lock(_jobMutex);
+        _jobs.push_back({ index, path, options });
+    }
+    _jobCondition.notify_one();
+    _pending++;
+    return index;
+}
+
+void AssetLoader::Prefetch(const std::string& path, const TextureOptions& options)
+{
+    FindOrAddEntry(path, options);
+}
+
+GLuint AssetLoader::RequestTexture(const std::string& path, const TextureOptions& options)
+{
+    Entry& entry = _entries[FindOrAddEntry(path, options)];
+    if (!entry.texture)
+    {
+        // How the image is loaded was fixed when the decode job was queued
+        bool compress = entry.options.compress;
+        bool streamed = entry.options.streamed;
+        entry.options = options;
+        entry.options.compress = compress;
+        entry.options.streamed = streamed;
+        CreatePlaceholder(entry);
+    }
+    return entry.texture;
+}
+
+bool AssetLoader::IsResident(GLuint texture) const
+{
+    for (const Entry& entry : _entries)
+        if (entry.texture == texture)
+            return entry.resident;
+    return false;
+}
+
+void AssetLoader::CreatePlaceholder(Entry& entry)
+{
+    glGenTextures(1, &entry.texture);
+    glBindTexture(GL_TEXTURE_2D, entry.texture);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, entry.options.wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, entry.options.wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, entry.options.minFilter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, entry.options.magFilter);
+
+    // Single mid grey texel, complete at level 0 whatever the filter
+    const unsigned char grey[4] = { 128, 128, 128, 255 };
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+}
+
+void AssetLoader::Pump(size_t budgetBytes)
+{
+    PROFILE_FUNCTION();
+
+    size_t uploaded = 0;
+    Result result;
+    while (uploaded == 0 || uploaded < budgetBytes)
+    {
+        if (!_results.Pop(result))
+            break;
+
+        Entry& entry = _entries[result.entry];
+        if (!entry.texture)
+            CreatePlaceholder(entry);
+
+        // Blocks were encoded before the context could say whether it takes them
+        if (result.levels.compressed && !GLEW_EXT_texture_compression_s3tc)
+        {
+            if (!_warnedNoS3tc)
+                std::cerr << "S3TC is not supported, textures are uploaded uncompressed" << std::endl;
+            _warnedNoS3tc = true;
+            DecompressMipChain(result.levels);
+        }
+
+        if (result.levels.ByteCount() > 0 && entry.options.streamed && _residency)
+        {
+            // Only the chain's tail goes up now, the residency streams the rest
+            size_t residentBefore = _residency->ResidentBytes();
+            _residency->Adopt(entry.texture, std::move(result.levels));
+            uploaded += _residency->ResidentBytes() - residentBefore;
+            entry.resident = true;
+        }
+        else if (result.levels.ByteCount() > 0)
+        {
+            UploadMipChain(entry, result.levels);
+            uploaded += result.levels.ByteCount();
+        }
+        else if (result.image.pixels)
+        {
+            Upload(entry, result.image);
+            uploaded += (size_t)result.image.width * result.image.height * result.image.channels;
+        }
+        else
+        {
+            std::cerr << "Failed to load texture: " << entry.path << std::endl;
+        }
+        FreeImage(result.image);
+        _pending--;
+    }
+
+    _uploadedBytes += uploaded;
+    PROFILE_COUNTER("Texture upload bytes", uploaded);
+}
+
+void* AssetLoader::MapUploadBuffer(size_t size)
+{
+    if (!_pbos[0])
+        glGenBuffers(PBO_COUNT, _pbos);
+
+    // Copy into a freshly orphaned buffer, the driver then transfers it without blocking us
+    GLuint pbo = _pbos[_nextPbo];
+    _nextPbo = (_nextPbo + 1) % PBO_COUNT;
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+    void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (!mapped)
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    return mapped;
+}
+
+void AssetLoader::Upload(Entry& entry, DecodedImage& image)
+{
+    PROFILE_ZONE("Texture upload");
+    PROFILE_GPU_ZONE("Texture upload");
+
+    GLenum format = ChannelFormat(image.channels);
+
+    size_t size = (size_t)image.width * image.height * image.channels;
+    void* mapped = MapUploadBuffer(size);
+    const void* source = (const void*)0;
+    if (mapped)
+    {
+        memcpy(mapped, image.pixels, size);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    }
+    else
+    {
+        // Fall back to a client memory upload
+        source = image.pixels;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, entry.texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, entry.options.maxLevel);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, source);
+    if (entry.options.mipmaps)
+        glGenerateMipmap(GL_TEXTURE_2D);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    entry.resident = true;
+}
+
+void AssetLoader::UploadMipChain(Entry& entry, MipChain& image)
+{
+    PROFILE_ZONE("Mip chain upload");
+    PROFILE_GPU_ZONE("Mip chain upload");
+
+    void* mapped = MapUploadBuffer(image.ByteCount());
+    const unsigned char* source = nullptr;
+    if (mapped)
+    {
+        memcpy(mapped, image.Bytes(), image.ByteCount());
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    }
+    else
+    {
+        source = image.Bytes();
+    }
+
+    glBindTexture(GL_TEXTURE_2D, entry.texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)image.levelSizes.size() - 1);
+
+    int width = image.width;
+    int height = image.height;
+    size_t offset = 0;
+    for (size_t level = 0; level < image.levelSizes.size(); level++)
+    {
+        if (image.compressed)
+            glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)level, image.format, width, height, 0,
+                (GLsizei)image.levelSizes[level], source + offset);
+        else
+            glTexImage2D(GL_TEXTURE_2D, (GLint)level, image.format, width, height, 0,
+                image.format, GL_UNSIGNED_BYTE, source + offset);
+        offset += image.levelSizes[level];
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    entry.resident = true;
+}
+
+void AssetLoader::LoadTexture(const Job& job, Result& result)
+{
+    // A cooked texture needs no decode and carries its own mip chain
+    std::string sourcePath = CookedPath(job.path);
+    AssetData asset;
+    MipChain cooked;
+    int cookedChannels = 0;
+    int tileWidth = 0;
+    int tileHeight = 0;
+    bool isCooked = ReadAsset(sourcePath, asset);
+    uint64_t hash = isCooked ? asset.Hash() : 0;
+    isCooked = isCooked && ParseCooked(asset, cooked, cookedChannels, tileWidth, tileHeight);
+    if (!isCooked)
+    {
+        if (!job.options.compress)
+        {
+            result.image = DecodeImage(job.path);
+            if (job.options.streamed && result.image.pixels)
+            {
+                BuildMipChain(result.image, result.levels);
+                FreeImage(result.image);
+            }
+            return;
+        }
+
+        sourcePath = job.path;
+        if (!ReadAsset(sourcePath, asset))
+            return;
+        hash = asset.Hash();
+    }
+
+    if (!job.options.compress)
+    {
+        result.levels = std::move(cooked);
+        return;
+    }
+
+    // Mip generation is part of the cached data, so it is part of the key
+    hash = HashContent(&DXT_CACHE_VERSION, sizeof(DXT_CACHE_VERSION), hash);
+    bool mipmaps = job.options.mipmaps;
+    hash = HashContent(&mipmaps, sizeof(mipmaps), hash);
+
+    std::string cachePath = sourcePath + ".dxt";
+    if (ReadDxtCache(cachePath, hash, result.levels))
+        return;
+
+    if (isCooked)
+    {
+        CompressMipChain(cooked, cookedChannels, tileWidth, tileHeight, result.levels);
+    }
+    else
+    {
+        DecodedImage image;
+        image.path = job.path;
+        stbi_set_flip_vertically_on_load_thread(true);
+        image.pixels = stbi_load_from_memory(asset.data, (int)asset.size, &image.width, &image.height, &image.channels, 0);
+        if (!image.pixels)
+            return;
+
+        CompressImage(image, mipmaps, result.levels);
+        FreeImage(image);
+    }
+    WriteDxtCache(cachePath, hash, result.levels);
+}
+
+void AssetLoader::WorkerLoop(int index)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "Asset worker %d", index);
+    PROFILE_THREAD_NAME(name);
+
+    while (true)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(_jobMutex);
+            _jobCondition.wait(lock, [this] { return _stopping || !_jobs.empty(); });
+            if (_stopping)
+                return;
+            job = _jobs.front();
+            _jobs.pop_front();
+        }
+
+        PERF_STAGE("Decode image");
+        Result result;
+        result.entry = job.entry;
+        LoadTexture(job, result);
+        TruncateMipChain(result.levels, job.options.maxLevel);
+        _results.Push(std::move(result));
+    }
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "content_hash.h"
+#include "mpsc_queue.h"
+
+class TextureResidency;
+
+// Asynchronous texture loading.
+//
+// Images are decoded on a pool of worker threads. Decoded pixels are handed to
+// the GL thread through a lock-free queue and uploaded through pixel buffer
+// objects by Pump, within a per-frame byte budget. RequestTexture returns a
+// texture name right away that holds a placeholder until the upload is done;
+// the name never changes, so callers can bind it immediately.
+//
+// Textures requested with compress set are encoded to BC1 (opaque) or BC3
+// (with alpha) by the workers, mip chain included, and uploaded with
+// glCompressedTexImage2D, or decoded back to RGBA on a driver without S3TC.
+// The encoded blocks are cached next to the source image as "<file>.dxt",
+// keyed by a hash of the source file, so the encoder only runs again when the
+// image changes.
+//
+// When "cooked/<name>.ctex" exists next to a requested image it is used
+// instead: the file already holds the final mip chain, so loading is a read
+// and an upload with no PNG decode (see cooked_format.h). All files are read
+// through ReadAsset, so a cooked texture in the asset pack is uploaded
+// straight from the mapping.
+//
+// Streamed textures always arrive as a full mip chain and are handed to a
+// TextureResidency, which decides which of their levels live in VRAM.
+
+struct DecodedImage
+{
+    std::string path;
+    unsigned char* pixels = nullptr;
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+};
+
+struct TextureOptions
+{
+    GLint wrap = GL_REPEAT;
+    GLint minFilter = GL_NEAREST;
+    GLint magFilter = GL_NEAREST;
+    bool mipmaps = true;
+    int maxLevel = 1000;        // smallest mip level sampled, GL_TEXTURE_MAX_LEVEL
+    bool compress = false;      // BC1/BC3, decided when the image is first prefetched or requested
+    bool streamed = false;      // mip levels managed by the loader's TextureResidency
+};
+
+// Complete mip chain, levels stored back to back. Block compressed when
+// compressed is set, otherwise format gives the channel layout.
+struct MipChain
+{
+    GLenum format = 0;
+    bool compressed = false;
+    int width = 0;
+    int height = 0;
+    std::vector<size_t> levelSizes;
+    std::vector<unsigned char> data;
+    const unsigned char* mapped = nullptr;  // levels read in place from the asset pack instead of data
+    size_t mappedSize = 0;
+
+    const unsigned char* Bytes() const { return mapped ? mapped : data.data(); }
+    size_t ByteCount() const { return mapped ? mappedSize : data.size(); }
+};
+
+// Decode an image file, safe to call from any thread. Free with FreeImage.
+DecodedImage DecodeImage(const std::string& filePath, bool flipVertically = true);
+void FreeImage(DecodedImage& image);
+
+class AssetLoader
+{
+public:
+    AssetLoader() = default;
+    AssetLoader(const AssetLoader&) = delete;
+    AssetLoader& operator=(const AssetLoader&) = delete;
+    ~AssetLoader();
+
+    // Start the worker pool, can be called before a GL context exists
+    void Start(int workerCount = 0);
+
+    // Stop the workers and delete all textures, needs the GL context
+    void Shutdown();
+
+    // Start decoding an image before its texture is needed, no GL calls
+    void Prefetch(const std::string& path, const TextureOptions& options = TextureOptions());
+
+    // Texture name for an image, holds a placeholder until the upload completes. GL thread only.
+    GLuint RequestTexture(const std::string& path, const TextureOptions& options = TextureOptions());
+
+    bool IsResident(GLuint texture) const;
+
+    // Receiver of streamed textures, without one they are uploaded whole
+    void SetResidency(TextureResidency* residency) { _residency = residency; }
+
+    // Upload decoded images, at least one per call and then up to budgetBytes. GL thread only.
+    void Pump(size_t budgetBytes);
+
+    int PendingCount() const { return _pending; }
+    size_t UploadedBytes() const { return _uploadedBytes; }
+
+private:
+    struct Entry
+    {
+        std::string path;
+        GLuint texture = 0;
+        TextureOptions options;
+        bool resident = false;
+    };
+
+    struct Job
+    {
+        int entry;
+        std::string path;
+        TextureOptions options;
+    };
+
+    struct Result
+    {
+        int entry = -1;
+        DecodedImage image;
+        MipChain levels;
+    };
+
+    int FindOrAddEntry(const std::string& path, const TextureOptions& options);
+    void CreatePlaceholder(Entry& entry);
+    void* MapUploadBuffer(size_t size);
+    void Upload(Entry& entry, DecodedImage& image);
+    void UploadMipChain(Entry& entry, MipChain& chain);
+    static void LoadTexture(const Job& job, Result& result);
+    void WorkerLoop(int index);
+
+    std::vector<Entry> _entries;
+    TextureResidency* _residency = nullptr;
+    int _pending = 0;
+    size_t _uploadedBytes = 0;
+    bool _warnedNoS3tc = false;
+
+    // Jobs for the workers
+    std::mutex _jobMutex;
+    std::condition_variable _jobCondition;
+    std::deque<Job> _jobs;
+    bool _stopping = false;
+    std::vector<std::thread> _workers;
+
+    // Decoded images for the GL thread
+    MpscQueue<Result> _results;
+
+    // Ring of pixel unpack buffers so a new upload never waits on the previous one
+    static const int PBO_COUNT = 4;
+    GLuint _pbos[PBO_COUNT] = {};
+    int _nextPbo = 0;
+};
@@ -0,0 +1,128 @@
+#include "asset_pack.h"
+#include "content_hash.h"
+#include "mapped_file.h"
+#include "pack_format.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace
+{
+    MappedFile packFile;
+    const PackEntry* entries = nullptr;
+    uint32_t entryCount = 0;
+
+    const PackEntry* FindEntry(const std::string& name)
+    {
+        const PackEntry* end = entries + entryCount;
+        const PackEntry* it = std::lower_bound(entries, end, name,
+            [](const PackEntry& entry, const std::string& key) { return strncmp(entry.name, key.c_str(), sizeof(entry.name)) < 0; });
+        if (it == end || strncmp(it->name, name.c_str(), sizeof(it->name)) != 0)
+            return nullptr;
+        return it;
+    }
+}
+
+uint64_t AssetData::Hash() const
+{
+    return mapped ? packHash : HashContent(data, size);
+}
+
+bool AssetPack::Open(const std::string& path)
+{
+    PROFILE_FUNCTION();
+
+    Close();
+    if (!packFile.Open(path))
+        return false;
+
+    PackHeader header;
+    if (packFile.Size() < sizeof(header))
+    {
+        packFile.Close();
+        return false;
+    }
+    memcpy(&header, packFile.Data(), sizeof(header));
+    size_t tableEnd = sizeof(header) + (size_t)header.entryCount * sizeof(PackEntry);
+    if (memcmp(header.magic, PACK_MAGIC, sizeof(header.magic)) != 0 || header.version != PACK_VERSION
+        || packFile.Size() < tableEnd)
+    {
+        std::cerr << "Invalid asset pack: " << path << std::endl;
+        packFile.Close();
+        return false;
+    }
+
+    entries = (const PackEntry*)(packFile.Data() + sizeof(header));
+    entryCount = header.entryCount;
+    for (uint32_t i = 0; i < entryCount; i++)
+    {
+        if (entries[i].offset + entries[i].size > packFile.Size())
+        {
+            std::cerr << "Truncated asset pack: " << path << std::endl;
+            Close();
+            return false;
+        }
+    }
+    return true;
+}
+
+void AssetPack::Close()
+{
+    packFile.Close();
+    entries = nullptr;
+    entryCount = 0;
+}
+
+bool AssetPack::IsOpen()
+{
+    return packFile.IsOpen();
+}
+
+size_t AssetPack::EntryCount()
+{
+    return entryCount;
+}
+
+bool AssetPack::Find(const std::string& name, AssetData& asset)
+{
+    const PackEntry* entry = entries ? FindEntry(name) : nullptr;
+    if (!entry)
+        return false;
+
+    asset.storage.clear();
+    asset.data = packFile.Data() + entry->offset;
+    asset.size = (size_t)entry->size;
+    asset.mapped = true;
+    asset.packHash = entry->hash;
+    return true;
+}
+
+bool ReadAsset(const std::string& name, AssetData& asset)
+{
+    if (AssetPack::Find(name, asset))
+        return true;
+
+    std::ifstream file(name, std::ios::binary | std::ios::ate);
+    if (!file)
+        return false;
+    asset.storage.resize((size_t)file.tellg());
+    file.seekg(0);
+    if (!file.read((char*)asset.storage.data(), asset.storage.size()))
+        return false;
+    asset.data = asset.storage.data();
+    asset.size = asset.storage.size();
+    asset.mapped = false;
+    return true;
+}
+
+bool ReadAssetText(const std::string& name, std::string& text)
+{
+    AssetData asset;
+    if (!ReadAsset(name, asset))
+        return false;
+    text.assign((const char*)asset.data, asset.size);
+    return true;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Read access to game assets by relative path, "images/sky.png".
+//
+// With a pack open, assets are served straight from its memory mapping: one
+// open at startup, no per-file open or read, and the page cache is shared by
+// every running instance. Names missing from the pack, or everything when no
+// pack is open, fall back to reading the loose file. Reads are thread safe
+// once Open has returned.
+
+struct AssetData
+{
+    const unsigned char* data = nullptr;    // into the pack mapping or storage
+    size_t size = 0;
+    std::vector<unsigned char> storage;     // loose files only
+    bool mapped = false;
+    uint64_t packHash = 0;                  // from the pack index when mapped
+
+    uint64_t Hash() const;
+};
+
+namespace AssetPack
+{
+    bool Open(const std::string& path);
+    void Close();
+    bool IsOpen();
+    size_t EntryCount();
+
+    // Mapped contents of a packed asset, false when the pack does not have it
+    bool Find(const std::string& name, AssetData& asset);
+}
+
+// Contents of an asset, from the pack when it has it
+bool ReadAsset(const std::string& name, AssetData& asset);
+
+// Convenience for text assets such as shaders
+bool ReadAssetText(const std::string& name, std::string& text);
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+
+// Binary rect table written by "AssetTool atlas" and read by TextureAtlas.
+//
+// Layout: AtlasHeader, pageCount AtlasPage records, rectCount AtlasRect records.
+// Rects are in pixels with the origin at the top left of the page image, they
+// exclude the gutter around every frame.
+
+const char ATLAS_MAGIC[4] = { 'R', 'A', 'T', 'L' };
+const uint32_t ATLAS_VERSION = 1;
+
+#pragma pack(push, 1)
+
+struct AtlasHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t pageCount;
+    uint32_t rectCount;
+    uint32_t padding;       // gutter in pixels around every rect
+};
+
+struct AtlasPage
+{
+    uint32_t width;
+    uint32_t height;
+    char file[64];          // page image, relative to the rect table
+};
+
+struct AtlasRect
+{
+    char name[32];          // "<group>:<frame index>"
+    uint16_t page;
+    uint16_t x;
+    uint16_t y;
+    uint16_t width;
+    uint16_t height;
+};
+
+#pragma pack(pop)
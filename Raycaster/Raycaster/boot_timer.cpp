@@ -0,0 +1,51 @@
+#include "boot_timer.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+
+BootTimer::ScopedStep::ScopedStep(BootTimer& timer, const char* name)
+    : _timer(timer), _name(name), _start(Profiler::Now())
+{
+}
+
+BootTimer::ScopedStep::~ScopedStep()
+{
+    _timer.Record(_name, _start, Profiler::Now());
+}
+
+void BootTimer::Record(const char* name, uint64_t start, uint64_t end)
+{
+    std::string thread = Profiler::GetThreadBuffer().threadName;
+    std::lock_guard<std::mutex> lock(_mutex);
+    _steps.push_back({ name, thread, start, end });
+}
+
+void BootTimer::PrintReport()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::sort(_steps.begin(), _steps.end(), [](const Step& a, const Step& b) { return a.start < b.start; });
+
+    std::cout << "------ Boot timings ------\n";
+    char line[160];
+    for (const Step& step : _steps)
+    {
+        snprintf(line, sizeof(line), "%-28s %-12s start %8.2f ms  took %8.2f ms\n",
+            step.name, step.thread.c_str(), step.start / 1e6, (step.end - step.start) / 1e6);
+        std::cout << line;
+    }
+    std::cout << "--------------------------\n";
+}
+
+double BootTimer::FirstFrame()
+{
+    double ms = Profiler::Now() / 1e6;
+    PROFILE_COUNTER("Time to first frame (ms)", ms);
+
+    char line[128];
+    snprintf(line, sizeof(line), "Time to first frame: %.2f ms (target %.0f ms)%s\n",
+        ms, targetFirstFrameMs, ms > targetFirstFrameMs ? " - OVER TARGET" : "");
+    std::cout << line;
+    return ms;
+}
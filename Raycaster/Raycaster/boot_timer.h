@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "profiler.h"
+
+// Records how long every startup step takes and on which thread it ran, and
+// reports the time from process start to the first presented frame.
+
+class BootTimer
+{
+public:
+    struct Step
+    {
+        const char* name;
+        std::string thread;
+        uint64_t start;
+        uint64_t end;
+    };
+
+    class ScopedStep
+    {
+    public:
+        ScopedStep(BootTimer& timer, const char* name);
+        ~ScopedStep();
+
+    private:
+        BootTimer& _timer;
+        const char* _name;
+        uint64_t _start;
+    };
+
+    // Thread safe, steps can be recorded from worker threads
+    void Record(const char* name, uint64_t start, uint64_t end);
+
+    void PrintReport();
+
+    // Call after the first frame is presented, prints and returns the time to first frame in ms
+    double FirstFrame();
+
+    double targetFirstFrameMs = 1000.0;
+
+private:
+    std::mutex _mutex;
+    std::vector<Step> _steps;
+};
+
+#define BOOT_STEP(timer, name) BootTimer::ScopedStep PROFILE_CONCAT(_bootStep, __LINE__)(timer, name); PROFILE_ZONE(name)
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+
+// Cooked texture written by "AssetTool cook" and read by AssetLoader.
+//
+// Layout: CookedHeader, levelCount CookedLevel records, then the pixel data of
+// every level back to back. Pixels are 8 bits per channel with rows stored
+// bottom up, so each level can go to glTexImage2D as is. The mip chain is
+// built per tile, it stops once a tile is one texel wide or high so no level
+// ever mixes two tiles.
+
+const char COOKED_MAGIC[4] = { 'R', 'C', 'T', 'X' };
+const uint32_t COOKED_VERSION = 1;
+
+#pragma pack(push, 1)
+
+struct CookedHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint64_t sourceHash;    // source image bytes and cook settings
+    uint32_t width;
+    uint32_t height;
+    uint32_t channels;
+    uint32_t tileWidth;     // equal to width and height for untiled images
+    uint32_t tileHeight;
+    uint32_t levelCount;
+};
+
+struct CookedLevel
+{
+    uint32_t width;
+    uint32_t height;
+    uint64_t offset;        // from the start of the file
+    uint64_t size;
+};
+
+#pragma pack(pop)
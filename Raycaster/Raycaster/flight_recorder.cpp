@@ -0,0 +1,88 @@
+#include "flight_recorder.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+
+void FlightRecorder::OnFrame(double frameMs, const FlightRecorderState& state)
+{
+    _frameIndex++;
+    if (!enabled)
+        return;
+
+    if (_framesUntilDump > 0)
+    {
+        if (--_framesUntilDump == 0)
+            WriteDump();
+        // Frames while a dump is pending never trigger a new one
+        UpdateMedian(frameMs);
+        return;
+    }
+
+    // Need a settled median before relative spikes mean anything
+    bool warmedUp = _historyCount == MEDIAN_WINDOW;
+    bool spike = (thresholdMs > 0 && frameMs > thresholdMs)
+        || (warmedUp && medianMultiplier > 0 && frameMs > _medianMs * medianMultiplier);
+
+    uint64_t now = Profiler::Now();
+    bool coolingDown = _hasDumped && now - _lastDumpTime < (uint64_t)(cooldownSeconds * 1e9);
+
+    if (spike && warmedUp && !coolingDown)
+    {
+        _spikeTime = now;
+        _spikeMs = frameMs;
+        _spikeMedianMs = _medianMs;
+        _spikeFrame = _frameIndex;
+        _spikeState = state;
+        _framesUntilDump = std::max(postFrames, 1);
+    }
+
+    // Keep spikes out of the median so a burst of hitches is still detected
+    if (!spike)
+        UpdateMedian(frameMs);
+}
+
+void FlightRecorder::UpdateMedian(double frameMs)
+{
+    _history[_historyIndex] = (float)frameMs;
+    _historyIndex = (_historyIndex + 1) % MEDIAN_WINDOW;
+    if (_historyCount < MEDIAN_WINDOW)
+        _historyCount++;
+
+    float sorted[MEDIAN_WINDOW];
+    std::copy(_history, _history + _historyCount, sorted);
+    std::nth_element(sorted, sorted + _historyCount / 2, sorted + _historyCount);
+    _medianMs = sorted[_historyCount / 2];
+}
+
+void FlightRecorder::WriteDump()
+{
+    PROFILE_FUNCTION();
+
+    uint64_t now = Profiler::Now();
+    uint64_t history = (uint64_t)(historySeconds * 1e9);
+    uint64_t from = _spikeTime > history ? _spikeTime - history : 0;
+
+    char path[128];
+    snprintf(path, sizeof(path), "hitch_frame%llu_%.0fms.json", (unsigned long long)_spikeFrame, _spikeMs);
+
+    char metadata[512];
+    snprintf(metadata, sizeof(metadata),
+        "{\"frame\":%llu,\"frameMs\":%.3f,\"medianMs\":%.3f,"
+        "\"playerPosX\":%.4f,\"playerPosY\":%.4f,\"playerAngle\":%.4f,"
+        "\"mapWidth\":%d,\"mapHeight\":%d,\"mapHash\":\"%016llx\"}",
+        (unsigned long long)_spikeFrame, _spikeMs, _spikeMedianMs,
+        _spikeState.playerPosX, _spikeState.playerPosY, _spikeState.playerAngle,
+        _spikeState.mapWidth, _spikeState.mapHeight, (unsigned long long)_spikeState.mapHash);
+
+    if (Profiler::WriteChromeTrace(path, from, now, metadata))
+    {
+        _capturedCount++;
+        std::cout << "Hitch of " << _spikeMs << " ms (median " << _spikeMedianMs << " ms) written to " << path << std::endl;
+    }
+
+    // Writing the dump is a hitch of its own, start the cooldown after it
+    _lastDumpTime = Profiler::Now();
+    _hasDumped = true;
+}
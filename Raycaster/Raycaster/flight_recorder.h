@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+
+// Always-on hitch detector. The profiler ring buffers already hold the last few
+// seconds of zones; when a frame takes longer than the configured threshold (or
+// a multiple of the rolling median) the recorder waits a number of frames and
+// then writes that history, plus the frames after the spike, to a trace file
+// tagged with the game state at the time of the spike.
+
+struct FlightRecorderState
+{
+    double playerPosX = 0;
+    double playerPosY = 0;
+    double playerAngle = 0;
+    int mapWidth = 0;
+    int mapHeight = 0;
+    uint64_t mapHash = 0;
+};
+
+class FlightRecorder
+{
+public:
+    // Call once per frame with the duration of the previous frame
+    void OnFrame(double frameMs, const FlightRecorderState& state);
+
+    double MedianMs() const { return _medianMs; }
+    int CapturedCount() const { return _capturedCount; }
+
+    bool enabled = true;
+    float thresholdMs = 50.0f;      // absolute spike threshold, 0 disables it
+    float medianMultiplier = 4.0f;  // relative spike threshold, 0 disables it
+    float historySeconds = 3.0f;    // history before the spike included in the dump
+    int postFrames = 30;            // frames after the spike included in the dump
+    float cooldownSeconds = 5.0f;   // minimum time between two dumps
+
+private:
+    static const int MEDIAN_WINDOW = 128;
+
+    void UpdateMedian(double frameMs);
+    void WriteDump();
+
+    float _history[MEDIAN_WINDOW] = {};
+    int _historyCount = 0;
+    int _historyIndex = 0;
+    double _medianMs = 0;
+
+    // Pending dump
+    int _framesUntilDump = 0;
+    uint64_t _spikeTime = 0;
+    double _spikeMs = 0;
+    double _spikeMedianMs = 0;
+    uint64_t _spikeFrame = 0;
+    FlightRecorderState _spikeState;
+
+    uint64_t _frameIndex = 0;
+    uint64_t _lastDumpTime = 0;
+    bool _hasDumped = false;
+    int _capturedCount = 0;
+};
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+
+// Signed distance field font written by "AssetTool font" and read by TextRenderer.
+//
+// Layout: FontHeader, then glyphCount FontGlyph records. The atlas image is a
+// single channel where 0.5 is the glyph outline and the distance reaches 0 and
+// 1 at "spread" atlas pixels outside and inside. All metrics are in atlas
+// pixels, rects have their origin at the top left of the atlas image.
+
+const char FONT_MAGIC[4] = { 'R', 'F', 'N', 'T' };
+const uint32_t FONT_VERSION = 1;
+
+#pragma pack(push, 1)
+
+struct FontHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t glyphCount;
+    uint16_t atlasWidth;
+    uint16_t atlasHeight;
+    uint16_t lineHeight;
+    uint16_t spread;
+    char atlasFile[64];     // relative to the glyph table
+};
+
+struct FontGlyph
+{
+    uint32_t codepoint;
+    uint16_t x;
+    uint16_t y;
+    uint16_t width;
+    uint16_t height;
+    int16_t offsetX;        // from the pen position to the rect's left edge
+    int16_t offsetY;        // from the top of the line to the rect's top edge
+    uint16_t advance;
+};
+
+#pragma pack(pop)
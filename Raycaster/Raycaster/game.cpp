@@ -5,36 +5,74 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <cassert>
+#include <cmath>
+#include <future>
+#include <thread>
 #include "game.h"
-
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb_image.h>
+#include "profiler.h"
+#include "perf_counters.h"
+#include "asset_pack.h"
 
 
 #pragma region Initialization
 
 void Game::Initialize()
 {
+    PROFILE_THREAD_NAME("Main");
+    PROFILE_FUNCTION();
+
 	// Initialize subsystems
 
 	PrintBootMessage();
 
+    // Everything below reads through the pack when there is one, loose files otherwise
+    {
+        BOOT_STEP(bootTimer, "Map asset pack");
+        if (AssetPack::Open(ASSET_PACK_PATH))
+            std::cout << "Asset pack: " << ASSET_PACK_PATH << " (" << AssetPack::EntryCount() << " files)\n";
+    }
+
+    // Disk and decode work needs no GL context, start it right away so it
+    // overlaps with bringing up the window and context
+    TextureOptions textureOptions;
+    textureOptions.compress = compressTextures;
+    TextureOptions streamedOptions = textureOptions;
+    streamedOptions.streamed = true;
+    assetLoader.SetResidency(&textureResidency);
+    assetLoader.Start();
+    assetLoader.Prefetch("images/sheet.png", streamedOptions);
+    assetLoader.Prefetch("images/sky.png", textureOptions);
+
+    std::future<std::string> fragmentShaderSource = std::async(std::launch::async, [this] {
+        PROFILE_THREAD_NAME("Boot worker");
+        BOOT_STEP(bootTimer, "Read shaders");
+        return loadShaderFromFile("fragment_shader.glsl");
+    });
+
     // Initialize GLFW
-    if (!glfwInit()) {
-        std::cerr << "Failed to initialize GLFW\n";
-        exit(EXIT_FAILURE);
+    {
+        BOOT_STEP(bootTimer, "GLFW init");
+        if (!glfwInit()) {
+            std::cerr << "Failed to initialize GLFW\n";
+            exit(EXIT_FAILURE);
+        }
     }
 
     glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
 
     // Load window
-    bool retFlag;
-    bool retVal = LoadWindow(retFlag);
-    if (retFlag)
-        exit(EXIT_FAILURE);
+    {
+        BOOT_STEP(bootTimer, "Create window");
+        bool retFlag;
+        bool retVal = LoadWindow(retFlag);
+        if (retFlag)
+            exit(EXIT_FAILURE);
+    }
 
     // Print renderer boot message
     PrintRendererBootMessage();
@@ -43,34 +81,112 @@ void Game::Initialize()
     glfwSwapInterval(0);
 
     // Initialize GLEW
-    glewExperimental = GL_TRUE;
-    if (glewInit() != GLEW_OK) {
-        std::cerr << "Failed to initialize GLEW\n";
-        exit(EXIT_FAILURE);
+    {
+        BOOT_STEP(bootTimer, "GLEW init");
+        glewExperimental = GL_TRUE;
+        if (glewInit() != GLEW_OK) {
+            std::cerr << "Failed to initialize GLEW\n";
+            exit(EXIT_FAILURE);
+        }
     }
 
     // print glew version
     std::cout << "GLEW version: " << glewGetString(GLEW_VERSION) << std::endl;
 
-    compileShaders();
-    setupBuffers();
+    // GPU timestamps for the profiler
+    Profiler::InitGpu();
+
+    // Let the driver compile shaders on its own threads, status is only checked in finishShaders
+    if (GLEW_ARB_parallel_shader_compile)
+        glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+    else if (GLEW_KHR_parallel_shader_compile)
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+
+    {
+        BOOT_STEP(bootTimer, "Submit shaders");
+        compileShaders(fragmentShaderSource.get());
+        setupBuffers();
+    }
+
+    // Initialize ImGui, its heap traffic goes through the allocation tracker
+    {
+        BOOT_STEP(bootTimer, "ImGui init");
+        IMGUI_CHECKVERSION();
+        ImGui::SetAllocatorFunctions(AllocTracker::ImGuiAlloc, AllocTracker::ImGuiFree);
+        ImGui::CreateContext();
+        ImGuiIO& io = ImGui::GetIO(); (void)io;
+        ImGui::StyleColorsDark();
+
+        ImGui_ImplGlfw_InitForOpenGL(_window, true);
+        ImGui_ImplOpenGL3_Init("#version 130");
+    }
+
+    // The font atlas is pure CPU work, the main thread does not touch ImGui until it is joined
+    std::thread fontAtlasThread([this] {
+        PROFILE_THREAD_NAME("Boot worker");
+        BOOT_STEP(bootTimer, "ImGui font atlas");
+        unsigned char* pixels;
+        int width, height;
+        ImGui::GetIO().Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+    });
+
+    // Textures hold a placeholder until the loader has uploaded them, startup does not wait
+    {
+        BOOT_STEP(bootTimer, "Request textures");
+        wallTexture = assetLoader.RequestTexture("images/sheet.png", streamedOptions);
+        skyTexture = assetLoader.RequestTexture("images/sky.png", textureOptions);
+        spriteAtlas.Load("images/atlas/atlas.bin", assetLoader, streamedOptions);
+    }
+
+    // Frames are resolved once, animating only picks another region
+    {
+        BOOT_STEP(bootTimer, "HUD layer");
+        hudLayer.Init(spriteAtlas);
+        hudLayer.SetResidency(&textureResidency);
+        for (int i = 0; i < WEAPON_COUNT * WEAPON_FRAMES; i++)
+            spriteAtlas.Find("gun", i, weaponFrames[i]);
+        spriteAtlas.Find("overlay", 0, overlayRegion);
+    }
+
+    {
+        BOOT_STEP(bootTimer, "Text renderer");
+        hudText.Init("images/font/font.bin", assetLoader);
+    }
+
+    // Load the level and its GPU copy, a generated map stands in when the file is missing.
+    // Binary levels are streamed in around the player.
+    {
+        BOOT_STEP(bootTimer, "Load map");
+        mapGenerator.LoadTemplate(MAP_TEMPLATE_PATH);
+        mapEditor.SetSavePath(MAP_EDITED_PATH);
+        if (!LoadLevel())
+            mapGenerator.Generate(map, 64, 64, (uint32_t)generateMapSeed);
+    }
+
+    {
+        BOOT_STEP(bootTimer, "Upload map");
+        minimap.Init();
+        mapPages.Init();
+        OnMapLoaded();
+    }
 
-    // Load the wall texture
-    wallTexture = loadImage("images/sheet.png");
-    overlayTexture = loadImage("images/overlay.png");
-    skyTexture = loadImage("images/sky.png");
+    {
+        BOOT_STEP(bootTimer, "Link shaders");
+        finishShaders();
+    }
 
-    // Load map data to GPU
-    LoadMapToGpu(mapData);
+    {
+        BOOT_STEP(bootTimer, "Wait for font atlas");
+        fontAtlasThread.join();
+    }
 
-    // Initialize ImGui
-    IMGUI_CHECKVERSION();
-    ImGui::CreateContext();
-    ImGuiIO& io = ImGui::GetIO(); (void)io;
-    ImGui::StyleColorsDark();
+    {
+        BOOT_STEP(bootTimer, "ImGui device objects");
+        ImGui_ImplOpenGL3_CreateDeviceObjects();
+        debugUICache.Init(_width, _height);
+    }
 
-    ImGui_ImplGlfw_InitForOpenGL(_window, true);
-    ImGui_ImplOpenGL3_Init("#version 130");
+    bootTimer.PrintReport();
 
     // Time variables
     lastFrameTime = glfwGetTime();
@@ -150,6 +266,11 @@ void Game::PrintRendererBootMessage()
 
 void Game::Frame()
 {
+    PROFILE_FUNCTION();
+
+    uint64_t allocationsAtStart = AllocTracker::ThreadStats().allocations;
+    frameArena.Reset();
+
     double currentTime = glfwGetTime();
     double deltaTime = currentTime - lastFrameTime;
     lastFrameTime = currentTime;
@@ -164,52 +285,237 @@ void Game::Frame()
         }
         fps = (float)(120.0 / sum);
 
-        
-        for (int i = 200 - 1; i > 0; i--) {
-			frameScreenshot[i] = frameScreenshot[i - 1];
-		}
-        frameScreenshot[0] = fps;
+        frameScreenshot[frameScreenshotIndex] = fps;
+        frameScreenshotIndex = (frameScreenshotIndex + 1) % 200;
     }
 
 
+    // Upload textures that finished decoding
+    assetLoader.Pump(TEXTURE_UPLOAD_BUDGET);
+    if (!texturesResident && assetLoader.PendingCount() == 0)
+    {
+        texturesResident = true;
+        std::cout << "All textures resident after " << Profiler::Now() / 1e6 << " ms" << std::endl;
+    }
+
     // Update and draw game
     glClear(GL_COLOR_BUFFER_BIT);
 
-    processInput(_window, deltaTime, mapData);
+    processInput(_window, deltaTime);
+    UpdateWeapon(_window, deltaTime);
+
+    // Bring in the map around the player and its GPU pages, changed chunks are redrawn on the minimap
+    mapStreamer.Update(playerPosX, playerPosY, deltaTime);
+    for (int index : mapStreamer.ChangedChunks())
+        mapPages.Invalidate(index % map.ChunksX(), index / map.ChunksX());
+    mapPages.Update(map, playerPosX, playerPosY);
+    if (regionGraph.FinishBuild(map))
+        regionBuildMs = (glfwGetTime() - regionBuildStart) * 1000.0;
+    for (int index : mapPages.ChangedChunks())
+    {
+        int x = index % map.ChunksX() * MAP_CHUNK_SIZE;
+        int y = index / map.ChunksX() * MAP_CHUNK_SIZE;
+        minimap.MarkCellsChanged(x, y, x + MAP_CHUNK_SIZE - 1, y + MAP_CHUNK_SIZE - 1);
+    }
+    FlushMapEdits();
+    mapPvs.Patch(map);
 
+    // Stream texture levels for what is on screen
+    UpdateVisibility();
+    textureResidency.Update();
 
 
     // Render here
     glClear(GL_COLOR_BUFFER_BIT);
 
+    RenderScene();
+
+    DrawHud();
+
+    DrawHudText();
+
+    DrawDebugUI();
+
+    // Swap buffers and poll events
+    {
+        PROFILE_ZONE("Swap buffers");
+        PERF_STAGE("Swap buffers");
+        glfwSwapBuffers(_window);
+    }
+    glfwPollEvents();
+
+    if (frameCount == 0)
+        bootTimer.FirstFrame();
+
+    PROFILE_COUNTER("Frame time (ms)", deltaTime * 1000.0);
+    PerfCounters::EndFrame();
+
+    // Heap allocations of this frame, trace and hitch dumps below are excluded
+    frameAllocations = AllocTracker::ThreadStats().allocations - allocationsAtStart;
+    PROFILE_COUNTER("Heap allocations", frameAllocations);
+    if (++frameCount > ALLOCATION_WARMUP_FRAMES && frameAllocations > 0)
+    {
+        if (allocatingFrames++ == 0)
+            std::cerr << "Steady-state frame " << frameCount << " made " << frameAllocations << " heap allocations\n";
+#ifdef RAYCASTER_ZERO_ALLOC_FRAMES
+        assert(!"Heap allocation in a steady-state frame");
+#endif
+    }
+
+    PROFILE_FRAME_MARK();
+
+    // Hitch detection, dumps the recent trace history when this frame was a spike
+    FlightRecorderState recorderState;
+    recorderState.playerPosX = playerPosX;
+    recorderState.playerPosY = playerPosY;
+    recorderState.playerAngle = playerAngle;
+    recorderState.mapWidth = map.Width();
+    recorderState.mapHeight = map.Height();
+    recorderState.mapHash = mapHash;
+    flightRecorder.OnFrame(deltaTime * 1000.0, recorderState);
+}
+
+void Game::UpdateVisibility()
+{
+    PROFILE_FUNCTION();
+    PERF_STAGE("UpdateVisibility");
+
+    // Same DDA as the fragment shader, through the center of every column group
+    int columnPixels = std::max(1, _width / VISIBILITY_COLUMNS);
+    int floorPixels = 0;
+    for (int i = 0; i < VISIBILITY_COLUMNS; i++)
+    {
+        double screenX = ((i + 0.5) / VISIBILITY_COLUMNS - 0.5) * 2.0;
+        double rayAngle = playerAngle + atan(screenX);
+        double rayDirX = cos(rayAngle);
+        double rayDirY = sin(rayAngle);
+        double stepSizeX = std::abs(1.0 / rayDirX);
+        double stepSizeY = std::abs(1.0 / rayDirY);
+
+        int cellX = (int)floor(playerPosX);
+        int cellY = (int)floor(playerPosY);
+        int stepX = rayDirX < 0 ? -1 : 1;
+        int stepY = rayDirY < 0 ? -1 : 1;
+        double rayLengthX = (rayDirX < 0 ? playerPosX - cellX : cellX + 1 - playerPosX) * stepSizeX;
+        double rayLengthY = (rayDirY < 0 ? playerPosY - cellY : cellY + 1 - playerPosY) * stepSizeY;
+
+        ColumnHit& hit = columnHits[i];
+        hit.hit = false;
+        minimap.MarkExplored(cellX, cellY);
+        double distance = 0;
+        double maxDistance = RayDistanceLimit();
+        while (!hit.hit && distance < maxDistance)
+        {
+            if (rayLengthX < rayLengthY)
+            {
+                cellX += stepX;
+                distance = rayLengthX;
+                rayLengthX += stepSizeX;
+            }
+            else
+            {
+                cellY += stepY;
+                distance = rayLengthY;
+                rayLengthY += stepSizeY;
+            }
+
+            if (!map.InBounds(cellX, cellY))
+            {
+                hit.hit = true;
+                hit.cell = 0xFF;
+            }
+            else
+            {
+                // Every cell a ray passes through or stops at has been seen
+                minimap.MarkExplored(cellX, cellY);
+                if (map.At(cellX, cellY) != 0)
+                {
+                    hit.hit = true;
+                    hit.cell = map.At(cellX, cellY);
+                }
+            }
+        }
+
+        double perpendicularDist = distance * cos(rayAngle - playerAngle);
+        double wallHeight = (1.0 / perpendicularDist) * (_height / 2.0) * cos(atan2(0.5, perpendicularDist));
+        hit.cellX = cellX;
+        hit.cellY = cellY;
+        hit.distance = (float)distance;
+        hit.wallPixels = (float)(wallHeight * 2.0);
+
+        // A wall tile is stretched over the wall's height, the column covers that much of the screen
+        if (hit.hit)
+            textureResidency.MarkVisible(wallTexture, WALL_TILE_TEXELS / std::max(1.0f, hit.wallPixels),
+                (int)(columnPixels * std::min(hit.wallPixels, (float)_height)));
+        floorPixels += (int)(columnPixels * std::max(0.0f, (_height - hit.wallPixels) * 0.5f));
+    }
+
+    // The floor below the walls samples the same sheet, at floorPos / height
+    // in texture coordinates. Its bottom row is the nearest and finest: one
+    // pixel there moves 2 / height across the sheet up the screen and 2 / width
+    // sideways, and the larger step picks the level.
+    if (floorPixels > 0)
+    {
+        float sheetTexels = WALL_TILE_TEXELS * std::max(wallTextureX, wallTextureY);
+        textureResidency.MarkVisible(wallTexture, 2.0f * sheetTexels / std::max(1, std::min(_width, _height)), floorPixels);
+    }
+}
+
+void Game::RenderScene()
+{
+    PROFILE_FUNCTION();
+    PERF_STAGE("RenderScene");
+    PROFILE_GPU_ZONE("RenderScene");
+
     // Use the shader program
     glUseProgram(shaderProgram);
 
-    // Bind the preloaded texture
+    // Map cells are read through the page table from the chunk pool
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, mapTexture);
+    glBindTexture(GL_TEXTURE_2D, mapPages.PageTexture());
+
+    glActiveTexture(GL_TEXTURE3);
+    glBindTexture(GL_TEXTURE_2D, mapPages.PoolTexture());
 
     glActiveTexture(GL_TEXTURE1);
     glBindTexture(GL_TEXTURE_2D, wallTexture);
 
     glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_2D, overlayTexture);
-
-    glActiveTexture(GL_TEXTURE3);
     glBindTexture(GL_TEXTURE_2D, skyTexture);
 
     // Update uniforms that change every frame
     GLint resolutionLoc = glGetUniformLocation(shaderProgram, "uResolution");
     glUniform2f(resolutionLoc, _width, _height);
 
+    // The shader works relative to the player's chunk, so its floats stay small and
+    // exact however far into the map the player is. The origin goes separately as integers.
+    int originX = ((int)floor(playerPosX) >> MAP_CHUNK_SHIFT) << MAP_CHUNK_SHIFT;
+    int originY = ((int)floor(playerPosY) >> MAP_CHUNK_SHIFT) << MAP_CHUNK_SHIFT;
     GLint playerPosLoc = glGetUniformLocation(shaderProgram, "uPlayerPos");
-    glUniform2f(playerPosLoc, (GLfloat)playerPosX, (GLfloat)playerPosY);
+    glUniform2f(playerPosLoc, (GLfloat)(playerPosX - originX), (GLfloat)(playerPosY - originY));
+
+    GLint originLoc = glGetUniformLocation(shaderProgram, "uOrigin");
+    glUniform2i(originLoc, originX, originY);
+
+    double floorOffsetX = originX / (double)_height;
+    double floorOffsetY = originY / (double)_height;
+    GLint floorOffsetLoc = glGetUniformLocation(shaderProgram, "uFloorOffset");
+    glUniform2f(floorOffsetLoc, (GLfloat)(floorOffsetX - floor(floorOffsetX)), (GLfloat)(floorOffsetY - floor(floorOffsetY)));
 
     GLint playerAngleLoc = glGetUniformLocation(shaderProgram, "uPlayerAngle");
     glUniform1f(playerAngleLoc, (GLfloat)playerAngle);
 
-    GLint mapLoc = glGetUniformLocation(shaderProgram, "map");
-    glUniform1i(mapLoc, 0); // Texture unit 0
+    GLint pagesLoc = glGetUniformLocation(shaderProgram, "pages");
+    glUniform1i(pagesLoc, 0); // Texture unit 0
+
+    GLint poolLoc = glGetUniformLocation(shaderProgram, "pool");
+    glUniform1i(poolLoc, 3); // Texture unit 3
+
+    GLint poolSlotsLoc = glGetUniformLocation(shaderProgram, "uPoolSlotsX");
+    glUniform1i(poolSlotsLoc, mapPages.PoolSlotsX());
+
+    GLint mapSizeLoc = glGetUniformLocation(shaderProgram, "uMapSize");
+    glUniform2i(mapSizeLoc, map.Width(), map.Height());
 
     GLint wallLoc = glGetUniformLocation(shaderProgram, "textures");
     glUniform1i(wallLoc, 1); // Texture unit 1
@@ -221,78 +527,489 @@ void Game::Frame()
     GLint wallYLoc = glGetUniformLocation(shaderProgram, "texturesY");
     glUniform1i(wallYLoc, wallTextureY);
 
-    GLint overlayLoc = glGetUniformLocation(shaderProgram, "overlay");
-    glUniform1i(overlayLoc, 2); // Texture unit 2
-
     GLint skyLoc = glGetUniformLocation(shaderProgram, "skybox");
-    glUniform1i(skyLoc, 3); // Texture unit 3
+    glUniform1i(skyLoc, 2); // Texture unit 2
+
+    // Ray loop bound and distance shading no longer follow the map texture size
+    GLint maxDistanceLoc = glGetUniformLocation(shaderProgram, "uMaxDistance");
+    glUniform1f(maxDistanceLoc, RayDistanceLimit());
+
+    GLint shadeDistanceLoc = glGetUniformLocation(shaderProgram, "uShadeDistance");
+    glUniform1f(shadeDistanceLoc, SHADE_DISTANCE);
 
     // Draw the quad
     glBindVertexArray(VAO);
     glDrawArrays(GL_TRIANGLES, 0, 6);
+}
+
+void Game::UpdateWeapon(GLFWwindow* window, double deltaTime)
+{
+    PROFILE_FUNCTION();
+
+    if (gameFocused)
+    {
+        for (int i = 0; i < WEAPON_COUNT; i++)
+        {
+            if (weaponFrame == 0 && glfwGetKey(window, GLFW_KEY_1 + i) == GLFW_PRESS)
+                currentWeapon = i;
+        }
+        if (weaponFrame == 0 && glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS)
+        {
+            weaponFrame = 1;
+            weaponFrameTime = 0;
+        }
+    }
+
+    // Play the firing frames once, then back to idle
+    if (weaponFrame > 0)
+    {
+        weaponFrameTime += deltaTime;
+        while (weaponFrame > 0 && weaponFrameTime >= WEAPON_FRAME_SECONDS)
+        {
+            weaponFrameTime -= WEAPON_FRAME_SECONDS;
+            weaponFrame = (weaponFrame + 1) % WEAPON_FRAMES;
+        }
+    }
+}
+
+void Game::DrawHud()
+{
+    PROFILE_FUNCTION();
+    PERF_STAGE("DrawHud");
+    PROFILE_GPU_ZONE("DrawHud");
+
+    hudLayer.Begin(_width, _height);
+
+    // Vignette over the scene
+    hudLayer.Shade(overlayRegion, 0, 0, (float)_width, (float)_height);
+
+    // Weapon, bottom center, frames are square
+    float weaponSize = _height * 0.45f;
+    const AtlasRegion& weapon = weaponFrames[currentWeapon * WEAPON_FRAMES + weaponFrame];
+    hudLayer.Sprite(weapon, (_width - weaponSize) * 0.5f, _height - weaponSize, weaponSize, weaponSize);
+
+    // Minimap, top right, markers on top of the cached image
+    if (showMinimap)
+    {
+        minimap.Update(mapPages);
+
+        // Large maps shrink to fit the same corner
+        float cell = MINIMAP_CELL_SCREEN_PIXELS;
+        int largestSide = std::max(map.Width(), map.Height());
+        if (largestSide * cell > MINIMAP_MAX_SCREEN_PIXELS)
+            cell = MINIMAP_MAX_SCREEN_PIXELS / largestSide;
+        float mapWidth = map.Width() * cell;
+        float mapHeight = map.Height() * cell;
+        float left = _width - mapWidth - 16.0f;
+        float top = 16.0f;
+        hudLayer.Image(minimap.Texture(), left, top, mapWidth, mapHeight, 0.0f, 1.0f, 1.0f, 0.0f);
+
+        float playerX = left + (float)playerPosX * cell;
+        float playerY = top + (float)playerPosY * cell;
+        uint32_t playerColor = TextRenderer::Color(255, 80, 40);
+        hudLayer.Rect(playerX - 3.0f, playerY - 3.0f, 6.0f, 6.0f, playerColor);
+        for (int i = 1; i <= 3; i++)
+        {
+            float along = 3.0f + i * 3.0f;
+            hudLayer.Rect(playerX + (float)cos(playerAngle) * along - 1.0f, playerY + (float)sin(playerAngle) * along - 1.0f, 2.0f, 2.0f, playerColor);
+        }
+    }
+
+    if (showCrosshair)
+    {
+        float centerX = _width * 0.5f;
+        float centerY = _height * 0.5f;
+        uint32_t color = TextRenderer::Color(255, 255, 255, 200);
+        const float gap = 4.0f, length = 10.0f, thickness = 2.0f;
+        hudLayer.Rect(centerX - gap - length, centerY - thickness * 0.5f, length, thickness, color);
+        hudLayer.Rect(centerX + gap, centerY - thickness * 0.5f, length, thickness, color);
+        hudLayer.Rect(centerX - thickness * 0.5f, centerY - gap - length, thickness, length, color);
+        hudLayer.Rect(centerX - thickness * 0.5f, centerY + gap, thickness, length, color);
+    }
+
+    hudLayer.End();
+}
+
+void Game::DrawHudText()
+{
+    PROFILE_FUNCTION();
+    PERF_STAGE("DrawHudText");
+    PROFILE_GPU_ZONE("DrawHudText");
+
+    hudText.Begin(_width, _height);
+    if (showHudText)
+    {
+        uint32_t white = TextRenderer::Color(255, 255, 255);
+        uint32_t grey = TextRenderer::Color(200, 200, 200, 220);
+        float line = HUD_TEXT_SIZE;
+        float frameMs = fps > 0 ? 1000.0f / fps : 0.0f;
+        hudText.Printf(16, 16, line, white, "FPS %.0f", fps);
+        hudText.Printf(16, 16 + line, line * 0.75f, grey, "%.2f ms", frameMs);
+        hudText.Printf(16, 16 + line * 1.75f, line * 0.75f, grey, "X %.1f Y %.1f", playerPosX, playerPosY);
+    }
+    hudText.End();
+}
 
+void Game::DrawDebugUI()
+{
+    PROFILE_FUNCTION();
+    PERF_STAGE("DrawDebugUI");
 
+    // F1 hides the window, ImGui is skipped entirely while it is hidden
+    bool toggleDown = glfwGetKey(_window, GLFW_KEY_F1) == GLFW_PRESS;
+    if (toggleDown && !debugUIToggleDown)
+    {
+        debugUIMode = debugUIMode == DEBUG_UI_HIDDEN ? DEBUG_UI_CACHED : DEBUG_UI_HIDDEN;
+        debugUICache.Invalidate();
+        debugUIInteracting = false;
+    }
+    debugUIToggleDown = toggleDown;
+
+    // Input still queues up through the GLFW callbacks, drop it while nobody reads it
+    if (debugUIMode == DEBUG_UI_HIDDEN)
+    {
+        ImGui::GetIO().ClearEventsQueue();
+        return;
+    }
+
+    if (debugUIMode == DEBUG_UI_LIVE)
+    {
+        BuildDebugUI();
+        PROFILE_GPU_ZONE("DrawDebugUI");
+        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        return;
+    }
+
+    // Cached: rebuilt at the reduced rate, every frame while the mouse or keyboard is on it
+    double now = glfwGetTime();
+    if (debugUIInteracting || !debugUICache.IsValid() || now - lastDebugUIUpdate >= 1.0 / std::max(1.0f, debugUIRateHz))
+    {
+        lastDebugUIUpdate = now;
+        BuildDebugUI();
+        PROFILE_GPU_ZONE("DrawDebugUI");
+        debugUICache.BeginCapture();
+        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        debugUICache.EndCapture();
+    }
+
+    PROFILE_GPU_ZONE("Composite debug UI");
+    debugUICache.Composite();
+}
+
+void Game::BuildDebugUI()
+{
+    PROFILE_FUNCTION();
 
     // Start the ImGui frame
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
 
-    std::string fpsString = std::to_string(fps);
-
     ImGui::Begin("Very useful window for cool raycaster - Dante Deketele");
-    ImGui::Text("FPS: %s", fpsString.c_str());
+    ImGui::Text("FPS: %f", fps);
     ImGui::Text("Player position: (%f, %f)", playerPosX, playerPosY);
     ImGui::Text("Player angle: %f", playerAngle);
 
-    float fpsArray[200];
-    for (int i = 0; i < 200; i++) {
-		fpsArray[i] = frameScreenshot[i];
-	}
+    // The FPS history is a ring buffer, the offset starts the plot at the oldest entry
+    ImGui::PlotLines("FPS", frameScreenshot, 200, frameScreenshotIndex, NULL, 0, 4000, ImVec2(0, 80));
 
-    ImGui::PlotLines("FPS", fpsArray, 200, 0, NULL, 0, 4000, ImVec2(0, 80));
+    // Frame times are derived into frame scratch memory
+    float* msArray = frameArena.Allocate<float>(200);
+    if (msArray)
+    {
+        float maxMs = 0;
+        for (int i = 0; i < 200; i++) {
+            float entry = frameScreenshot[(frameScreenshotIndex + i) % 200];
+            msArray[i] = entry > 0 ? 1000.0f / entry : 0;
+            if (msArray[i] > maxMs) {
+                maxMs = msArray[i];
+            }
+        }
 
-    float msArray[200];
-    float maxMs = 0;
-    for (int i = 0; i < 200; i++) {
-        msArray[i] = 1/frameScreenshot[i];
-        if (msArray[i] > maxMs) {
-			maxMs = msArray[i];
-		}
+        ImGui::PlotLines("ms", msArray, 200, 0, NULL, 0, maxMs, ImVec2(0, 80));
     }
 
-    ImGui::PlotLines("ms", msArray, 200, 0, NULL, 0, maxMs, ImVec2(0, 80));
+    AllocTracker::Stats allocStats = AllocTracker::GlobalStats();
+    ImGui::Text("Heap allocations last frame: %llu, allocating frames: %llu",
+        (unsigned long long)frameAllocations, (unsigned long long)allocatingFrames);
+    ImGui::Text("Heap allocations total: %llu (%llu KB), frame arena peak: %zu KB",
+        (unsigned long long)allocStats.allocations, (unsigned long long)(allocStats.bytes / 1024), frameArena.HighWater() / 1024);
+
+    // Trace capture
+    ImGui::InputInt("Trace frames", &traceCaptureFrames);
+    if (Profiler::IsCapturing())
+        ImGui::Text("Capturing trace...");
+    else if (ImGui::Button("Capture trace"))
+        Profiler::RequestCapture(traceCaptureFrames, "trace.json");
+
+    // Flight recorder
+    ImGui::Checkbox("Hitch recorder", &flightRecorder.enabled);
+    ImGui::SliderFloat("Hitch threshold (ms)", &flightRecorder.thresholdMs, 0.0f, 200.0f);
+    ImGui::SliderFloat("Hitch x median", &flightRecorder.medianMultiplier, 0.0f, 20.0f);
+    ImGui::Text("Median frame: %.3f ms, hitches captured: %d", flightRecorder.MedianMs(), flightRecorder.CapturedCount());
+
+    // Map size, for measuring how the renderer scales
+    ImGui::Text("Map: %dx%d cells, %d of %d chunks decoded, %zu KB", map.Width(), map.Height(),
+        map.DecodedChunkCount(), map.ChunksX() * map.ChunksY(), map.ResidentBytes() / 1024);
+    if (mapStreamer.IsActive())
+    {
+        ImGui::Text("Streaming: %d chunks resident, %d pending, %llu loaded, %llu evicted", mapStreamer.ResidentCount(),
+            mapStreamer.PendingCount(), (unsigned long long)mapStreamer.LoadedTotal(), (unsigned long long)mapStreamer.EvictedTotal());
+        ImGui::SliderInt("Resident radius", &mapStreamer.residentRadius, 1, 8);
+        mapStreamer.evictRadius = std::max(mapStreamer.evictRadius, mapStreamer.residentRadius + 2);
+    }
+    ImGui::Text("GPU pages: %d of %d pool slots, %d empty chunks skipped, pool %zu KB, radius %d", mapPages.UsedSlotCount(),
+        mapPages.PoolSlotCount(), mapPages.EmptyPageCount(), mapPages.PoolBytes() / 1024, mapPages.Radius());
+    int playerComponent = regionGraph.ComponentAt((int)playerPosX, (int)playerPosY);
+    if (regionGraph.Building())
+        ImGui::Text("Regions: building in the background, %.0f ms so far", (glfwGetTime() - regionBuildStart) * 1000.0);
+    else
+        ImGui::Text("Regions: %d in %d components, built in %.0f ms, %zu KB, player's area %d cells", regionGraph.RegionCount(),
+            regionGraph.ComponentCount(), regionBuildMs, regionGraph.MemoryBytes() / 1024,
+            playerComponent >= 0 ? regionGraph.ComponentCells(playerComponent) : 0);
+    if (map.HasPvs())
+    {
+        ImGui::Text("PVS: %d clusters visible from the player, %d sets pending", mapPvs.VisibleClusterCount(map, (int)playerPosX, (int)playerPosY),
+            mapPvs.PendingCount());
+        ImGui::SliderInt("PVS sets per frame", &mapPvs.clustersPerPatch, 1, 64);
+    }
+    else
+        ImGui::Text("PVS: none in this map");
+    if (ImGui::Button("Build PVS"))
+    {
+        // Reads every chunk, loaded or not, on all cores
+        mapStreamer.Stop();
+        double start = glfwGetTime();
+        mapPvs.Build(map);
+        pvsBuildMs = (glfwGetTime() - start) * 1000.0;
+        mapStreamer.Start(map, playerPosX, playerPosY);
+    }
+    if (pvsBuildMs > 0)
+    {
+        ImGui::SameLine();
+        ImGui::Text("built in %.0f ms", pvsBuildMs);
+    }
+    ImGui::SliderFloat("Max ray distance", &maxRayDistance, 0.0f, 1024.0f, maxRayDistance > 0.0f ? "%.0f" : "whole map");
+    ImGui::InputInt("Generated size", &generateMapSize, 64, 1024);
+    ImGui::InputInt("Generated seed", &generateMapSeed);
+    if (ImGui::Button("Generate map"))
+    {
+        mapStreamer.Stop();
+        regionGraph.CancelBuild();
+        double start = glfwGetTime();
+        int size = std::max(4, std::min(generateMapSize, 32768));
+        mapGenerator.Generate(map, size, size, (uint32_t)generateMapSeed);
+        generateMapMs = (glfwGetTime() - start) * 1000.0;
+        OnMapLoaded();
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Reload level"))
+    {
+        mapStreamer.Stop();
+        regionGraph.CancelBuild();
+        if (LoadLevel())
+            OnMapLoaded();
+    }
+    ImGui::SameLine();
+    ImGui::Checkbox("Map editor", &mapEditor.open);
+    if (generateMapMs > 0)
+        ImGui::Text("Generated in %.0f ms on %u threads, %s", generateMapMs, std::max(1u, std::thread::hardware_concurrency()),
+            mapGenerator.HasTemplate() ? "Wang tiles" : "room grid");
+
+    // Texture streaming
+    float budgetMb = textureResidency.budgetBytes / (1024.0f * 1024.0f);
+    if (ImGui::SliderFloat("Texture budget (MB)", &budgetMb, 1.0f, 256.0f))
+        textureResidency.budgetBytes = (size_t)(budgetMb * 1024 * 1024);
+    ImGui::Text("Streamed textures: %d, resident %zu KB, uploaded %zu KB this frame", textureResidency.TrackedCount(),
+        textureResidency.ResidentBytes() / 1024, textureResidency.UploadedBytesLastFrame() / 1024);
+
+    // HUD
+    ImGui::Checkbox("Crosshair", &showCrosshair);
+    ImGui::SameLine();
+    ImGui::Text("%d sprites in %d draw", hudLayer.SpritesLastFrame(), hudLayer.DrawCallsLastFrame());
+    ImGui::Checkbox("Minimap", &showMinimap);
+    ImGui::SameLine();
+    ImGui::Text("%d cells explored, %d redraws", minimap.ExploredCount(), minimap.RedrawCount());
+    ImGui::Checkbox("HUD text", &showHudText);
+    ImGui::SameLine();
+    ImGui::Text("%d glyphs in %d draw", hudText.GlyphsLastFrame(), hudText.DrawCallsLastFrame());
+
+    // Debug window
+    ImGui::Combo("Debug UI", &debugUIMode, "Every frame\0Cached\0Hidden (F1)\0");
+    if (debugUIMode == DEBUG_UI_CACHED)
+        ImGui::SliderFloat("Debug UI rate (Hz)", &debugUIRateHz, 1.0f, 60.0f);
+
+    DrawPerfCounters();
     ImGui::End();
 
+    if (mapEditor.BuildWindow(map, mapPvs, playerPosX, playerPosY, playerAngle))
+        SaveEditedMap();
+
 
     // Rendering
     ImGui::Render();
-    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
-    // Swap buffers and poll events
-    glfwSwapBuffers(_window);
-    glfwPollEvents();
+    ImGuiIO& io = ImGui::GetIO();
+    debugUIInteracting = io.WantCaptureMouse || io.WantCaptureKeyboard;
+}
+
+void Game::DrawPerfCounters()
+{
+    if (!ImGui::CollapsingHeader("Performance counters"))
+        return;
+
+    bool hardware = PerfCounters::Available();
+    if (!hardware)
+        ImGui::Text("Hardware counters unavailable, showing timings only");
+
+    const ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit;
+    if (!ImGui::BeginTable("perf", hardware ? 7 : 2, flags))
+        return;
+
+    ImGui::TableSetupColumn("Stage / thread");
+    ImGui::TableSetupColumn("ms");
+    if (hardware)
+    {
+        ImGui::TableSetupColumn("cycles");
+        ImGui::TableSetupColumn("instructions");
+        ImGui::TableSetupColumn("IPC");
+        ImGui::TableSetupColumn("cache misses");
+        ImGui::TableSetupColumn("branch misses");
+    }
+    ImGui::TableHeadersRow();
+
+    auto row = [hardware](const char* name, const PerfCounters::Values& v) {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn(); ImGui::TextUnformatted(name);
+        ImGui::TableNextColumn(); ImGui::Text("%.3f", v.ns / 1e6);
+        if (!hardware)
+            return;
+        const uint64_t* c = v.counters;
+        ImGui::TableNextColumn(); ImGui::Text("%llu", (unsigned long long)c[PerfCounters::Cycles]);
+        ImGui::TableNextColumn(); ImGui::Text("%llu", (unsigned long long)c[PerfCounters::Instructions]);
+        ImGui::TableNextColumn(); ImGui::Text("%.2f", c[PerfCounters::Cycles] ? (double)c[PerfCounters::Instructions] / c[PerfCounters::Cycles] : 0.0);
+        ImGui::TableNextColumn(); ImGui::Text("%llu", (unsigned long long)c[PerfCounters::CacheMisses]);
+        ImGui::TableNextColumn(); ImGui::Text("%llu", (unsigned long long)c[PerfCounters::BranchMisses]);
+    };
+
+    for (int i = 0; i < PerfCounters::StageCount(); i++)
+    {
+        const PerfCounters::Stage& stage = PerfCounters::GetStage(i);
+        row(stage.name, stage.lastFrame);
+    }
+    for (int i = 0; i < PerfCounters::ThreadCount(); i++)
+    {
+        const PerfCounters::ThreadRecord& thread = PerfCounters::GetThread(i);
+        row(thread.profilerBuffer->threadName, thread.lastFrame);
+    }
+    ImGui::EndTable();
 }
 
-void Game::LoadMapToGpu(uint8_t mapData[16][16]) {
-    // Generate and bind a texture object
-    glGenTextures(1, &mapTexture);
-    glBindTexture(GL_TEXTURE_2D, mapTexture);
+bool Game::LoadLevel()
+{
+    // A map saved from the editor wins over the level built into the pack,
+    // delete it to get the built one back
+    if (std::ifstream(MAP_EDITED_PATH).good())
+    {
+        if (map.LoadBinary(MAP_EDITED_PATH))
+            return true;
+        std::cerr << "Falling back to the built level" << std::endl;
+    }
+    return map.LoadBinary(MAP_PATH) || map.LoadText(MAP_TEXT_PATH);
+}
 
-    // Set texture parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+void Game::OnMapLoaded()
+{
+    PROFILE_FUNCTION();
+
+    // Labeling every chunk takes seconds on a large map, it runs in the
+    // background and the game takes the graph over when it is done
+    regionGraph.StartBuild(map);
+    regionBuildStart = glfwGetTime();
+    regionBuildMs = 0;
+    mapPvs.Reset(map);
+
+    // A start inside a wall, or walled off in a pocket, moves to the nearest
+    // cell of an area at least a chunk large. Only the cells around the start
+    // are flooded, so this does not wait for the region graph.
+    playerPosX = map.StartX();
+    playerPosY = map.StartY();
+    int spawnX, spawnY;
+    if (RegionGraph::FindOpenCell(map, (int)playerPosX, (int)playerPosY, MAP_CHUNK_CELLS, spawnX, spawnY) &&
+        (spawnX != (int)playerPosX || spawnY != (int)playerPosY))
+    {
+        playerPosX = spawnX + 0.5;
+        playerPosY = spawnY + 0.5;
+    }
+    mapStreamer.Start(map, playerPosX, playerPosY);
+    minimap.Resize(map.Width(), map.Height());
+    LoadMapToGpu();
 
-    // Transfer map data to the texture
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, MAP_WIDTH, MAP_HEIGHT, 0, GL_RED, GL_UNSIGNED_BYTE, mapData);
+    std::cout << "Map: " << map.Width() << "x" << map.Height() << " cells" << std::endl;
 }
 
+void Game::LoadMapToGpu() {
+    PROFILE_FUNCTION();
+
+    // Page table for the new map, the chunks around the player go into the pool.
+    // On a streamed map the rest follow as they are loaded.
+    mapPages.Reset(map, playerPosX, playerPosY);
 
+    // Identifies the map state in hitch reports
+    mapHash = map.Hash();
+}
+
+void Game::FlushMapEdits()
+{
+    // Everything derived from the map follows its edits here, once per frame,
+    // and only around the cells that changed. The page table has already
+    // uploaded them in its Update.
+    if (map.DirtyRects().empty())
+        return;
+
+    PROFILE_FUNCTION();
+    for (const MapDirtyRect& rect : map.DirtyRects())
+        minimap.MarkCellsChanged(rect.x0, rect.y0, rect.x1, rect.y1);
+    regionGraph.Update(map, map.DirtyRects());
+    mapPvs.Update(map, map.DirtyRects());
+    map.ClearDirty();
+    mapHash = map.Hash();
+}
 
-void Game::processInput(GLFWwindow* window, double deltaTime, uint8_t mapData[16][16])
+void Game::SaveEditedMap()
 {
+    PROFILE_FUNCTION();
+
+    // The streamer reads the map file on its thread, and the file may be the one being replaced.
+    // So does a region build still running, it starts over on the saved file.
+    double start = glfwGetTime();
+    mapStreamer.Stop();
+    bool regionsBuilding = regionGraph.Building();
+    regionGraph.CancelBuild();
+    bool saved = map.SaveAndReopen(mapEditor.SavePath());
+    if (regionsBuilding)
+        regionGraph.StartBuild(map);
+    mapStreamer.Start(map, playerPosX, playerPosY);
+    mapEditor.SaveResult(saved, (glfwGetTime() - start) * 1000.0);
+    mapHash = map.Hash();
+    if (saved)
+        std::cout << "Map saved: " << mapEditor.SavePath() << std::endl;
+}
+
+float Game::RayDistanceLimit() const
+{
+    // Farther than any two cells of the map are apart
+    float acrossMap = (float)std::sqrt((double)map.Width() * map.Width() + (double)map.Height() * map.Height()) + 1.0f;
+    return maxRayDistance > 0.0f ? std::min(maxRayDistance, acrossMap) : acrossMap;
+}
+
+
+
+void Game::processInput(GLFWwindow* window, double deltaTime)
+{
+    PROFILE_FUNCTION();
+    PERF_STAGE("processInput");
+
     const double moveSpeed = 2.5f * deltaTime; // Adjust movement speed with delta time
     const double turnSpeed = 0.001f; // Adjust turn speed with delta time
 
@@ -323,10 +1040,11 @@ void Game::processInput(GLFWwindow* window, double deltaTime, uint8_t mapData[16
             moveY -= sin(playerAngle - PI / 2) * moveSpeed;
         }
 
-        if (playerPosX + moveX / abs(moveX) * playerRadius >= 0 && playerPosX + moveX / abs(moveX) * playerRadius < MAP_WIDTH && mapData[(int)(playerPosX + moveX / abs(moveX) * playerRadius)][(int)playerPosY] == 0)
+        // Probe one radius ahead on each axis, outside the map is solid
+        if (moveX != 0 && !map.IsSolid((int)floor(playerPosX + (moveX < 0 ? -playerRadius : playerRadius)), (int)floor(playerPosY)))
             playerPosX += moveX;
 
-        if (playerPosY + moveY / abs(moveY) * playerRadius >= 0 && playerPosY + moveY / abs(moveY) * playerRadius < MAP_HEIGHT && mapData[(int)playerPosX][(int)(playerPosY + moveY / abs(moveY) * playerRadius)] == 0)
+        if (moveY != 0 && !map.IsSolid((int)floor(playerPosX), (int)floor(playerPosY + (moveY < 0 ? -playerRadius : playerRadius))))
             playerPosY += moveY;
 
         // Handle mouse movement
@@ -338,7 +1056,7 @@ void Game::processInput(GLFWwindow* window, double deltaTime, uint8_t mapData[16
 
         // Check if the mouse is hovering over ImGui UI
         ImGuiIO& io = ImGui::GetIO();
-        if (!io.WantCaptureMouse)
+        if (debugUIMode == DEBUG_UI_HIDDEN || !io.WantCaptureMouse)
         {
             
 
@@ -382,63 +1100,17 @@ void Game::processInput(GLFWwindow* window, double deltaTime, uint8_t mapData[16
 }
 
 std::string Game::loadShaderFromFile(const std::string& filePath) {
-    std::ifstream shaderFile("shaders/" + filePath);
-    if (!shaderFile) {
+    std::string source;
+    if (!ReadAssetText("shaders/" + filePath, source)) {
         std::cerr << "Failed to load shader: shaders/" << filePath << std::endl;
         return "";
     }
-    std::stringstream shaderStream;
-    shaderStream << shaderFile.rdbuf();
-    return shaderStream.str();
-}
-
-// Function to load an image file into a texture
-GLuint Game::loadImage(const std::string& filePath)
-{
-    GLuint textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_2D, textureID);
-
-    // Set texture wrapping parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    // Set texture filtering parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-
-    // Load image using stb_image
-    int width, height, nrChannels;
-    stbi_set_flip_vertically_on_load(true); // Flip image vertically as OpenGL expects the 0.0 coordinate to be at the bottom left corner
-    unsigned char* data = stbi_load(filePath.c_str(), &width, &height, &nrChannels, 0);
-    if (data)
-    {
-        GLenum format = GL_RGB;
-        if (nrChannels == 1)
-            format = GL_RED;
-        else if (nrChannels == 3)
-            format = GL_RGB;
-        else if (nrChannels == 4)
-            format = GL_RGBA;
-
-
-        // Generate the texture
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    }
-    else
-    {
-        std::cerr << "Failed to load texture: " << filePath << std::endl;
-    }
-    stbi_image_free(data);
-
-    return textureID;
+    return source;
 }
 
-void Game::compileShaders()
+void Game::compileShaders(const std::string& fragmentShaderSource)
 {
-    // Load fragment shader code from file
-    std::string fragmentShaderSource = loadShaderFromFile("fragment_shader.glsl").c_str();
-
+    PROFILE_FUNCTION();
 
     // Compile vertex shader
     GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
@@ -455,38 +1127,44 @@ void Game::compileShaders()
     glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
     glCompileShader(vertexShader);
 
+    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+    const char* fragmentShaderSourcePtr = fragmentShaderSource.c_str();
+    glShaderSource(fragmentShader, 1, &fragmentShaderSourcePtr, NULL);
+    glCompileShader(fragmentShader);
+
+    // Link shaders, errors are checked in finishShaders so the driver can
+    // keep compiling while the rest of startup runs
+    shaderProgram = glCreateProgram();
+    glAttachShader(shaderProgram, vertexShader);
+    glAttachShader(shaderProgram, fragmentShader);
+    glLinkProgram(shaderProgram);
+
+    pendingVertexShader = vertexShader;
+    pendingFragmentShader = fragmentShader;
+}
+
+void Game::finishShaders()
+{
+    PROFILE_FUNCTION();
+
     // Check for shader compile errors
     int success;
     char infoLog[512];
-    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
+    glGetShaderiv(pendingVertexShader, GL_COMPILE_STATUS, &success);
     if (!success)
     {
-        glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
+        glGetShaderInfoLog(pendingVertexShader, 512, NULL, infoLog);
         std::cerr << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
     }
 
-    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    const char* fragmentShaderSourcePtr = fragmentShaderSource.c_str();
-    glShaderSource(fragmentShader, 1, &fragmentShaderSourcePtr, NULL);
-    glCompileShader(fragmentShader);
-
     // Check for shader compile errors
-    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
+    glGetShaderiv(pendingFragmentShader, GL_COMPILE_STATUS, &success);
     if (!success)
     {
-        glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
+        glGetShaderInfoLog(pendingFragmentShader, 512, NULL, infoLog);
         std::cerr << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
     }
 
-
-
-    // Link shaders
-    shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-
-
     // Check for linking errors
     glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
     if (!success) {
@@ -495,8 +1173,10 @@ void Game::compileShaders()
     }
 
 
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+    glDeleteShader(pendingVertexShader);
+    glDeleteShader(pendingFragmentShader);
+    pendingVertexShader = 0;
+    pendingFragmentShader = 0;
 }
 
 void Game::setupBuffers()
@@ -536,6 +1216,18 @@ void Game::Shutdown()
 {
     PrintShutdownMessage();
 
+    Profiler::ShutdownGpu();
+    mapStreamer.Stop();
+    regionGraph.CancelBuild();
+    mapPages.Shutdown();
+    debugUICache.Shutdown();
+    minimap.Shutdown();
+    hudLayer.Shutdown();
+    hudText.Shutdown();
+    textureResidency.Clear();
+    assetLoader.Shutdown();
+    AssetPack::Close();
+
     // Clean up
     glDeleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
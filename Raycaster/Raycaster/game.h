@@ -3,6 +3,23 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include <iostream>
+#include "flight_recorder.h"
+#include "alloc_tracker.h"
+#include "boot_timer.h"
+#include "asset_loader.h"
+#include "texture_atlas.h"
+#include "texture_residency.h"
+#include "text_renderer.h"
+#include "hud_layer.h"
+#include "minimap.h"
+#include "overlay_cache.h"
+#include "map.h"
+#include "map_editor.h"
+#include "map_generator.h"
+#include "map_pages.h"
+#include "map_pvs.h"
+#include "map_streamer.h"
+#include "region_graph.h"
 
 class Game
 {
@@ -31,10 +48,24 @@ private:
     void PrintShutdownMessage();
 
     void Frame();
-    void compileShaders();
-    GLuint loadImage(const std::string& filePath);
-    void LoadMapToGpu(uint8_t mapData[16][16]);
-    void processInput(GLFWwindow* window, double deltaTime, uint8_t mapData[16][16]);
+    void UpdateVisibility();
+    void RenderScene();
+    void UpdateWeapon(GLFWwindow* window, double deltaTime);
+    void DrawHud();
+    void DrawHudText();
+    void DrawDebugUI();
+    void BuildDebugUI();
+    void DrawPerfCounters();
+    void compileShaders(const std::string& fragmentShaderSource);
+    void finishShaders();
+
+    bool LoadLevel();
+    void OnMapLoaded();
+    void LoadMapToGpu();
+    void FlushMapEdits();
+    void SaveEditedMap();
+    float RayDistanceLimit() const;
+    void processInput(GLFWwindow* window, double deltaTime);
     void setupBuffers();
     std::string loadShaderFromFile(const std::string& filePath);
 
@@ -49,29 +80,50 @@ private:
     // FPS system
     double frameTimes[120] = {};
     float frameScreenshot[200] = {};
+    int frameScreenshotIndex = 0;
     int frameTimeIndex = 0;
     float fps = 0;
     double lastFrameTime = 0;
 
-    const int MAP_WIDTH = 16;
-    const int MAP_HEIGHT = 16;
-    uint8_t mapData[16][16] = {
-        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-        { 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-        { 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-        { 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-        { 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 }
-    };
+    // Debug window, rebuilt every frame, at a lower rate into a cached texture, or not at all
+    enum DebugUIMode { DEBUG_UI_LIVE, DEBUG_UI_CACHED, DEBUG_UI_HIDDEN };
+    int debugUIMode = DEBUG_UI_CACHED;
+    float debugUIRateHz = 10.0f;
+    double lastDebugUIUpdate = 0;
+    bool debugUIInteracting = false;
+    bool debugUIToggleDown = false;
+    OverlayCache debugUICache;
+
+    // Profiler
+    int traceCaptureFrames = 60;
+    FlightRecorder flightRecorder;
+
+    // Allocation tracking, steady-state frames are expected to do no heap allocations
+    FrameArena frameArena{ 1 << 20 };
+    uint64_t frameCount = 0;
+    uint64_t frameAllocations = 0;
+    uint64_t allocatingFrames = 0;
+    const uint64_t ALLOCATION_WARMUP_FRAMES = 600;
+
+    // Level, loaded from a text file or generated
+    Map map;
+    MapStreamer mapStreamer;
+    const char* const MAP_PATH = "maps/level1.rmap";         // converted from the text level at build time
+    const char* const MAP_TEXT_PATH = "maps/level1.lvl";
+    const char* const MAP_EDITED_PATH = "level1_edited.rmap";  // saved by the map editor, outside the pack
+    const char* const MAP_TEMPLATE_PATH = "maps/wang_rooms_and_corridors.png";
+    MapGenerator mapGenerator;
+    RegionGraph regionGraph;            // which floor cells connect, for spawns and reachability
+    double regionBuildStart = 0;
+    double regionBuildMs = 0;
+    MapPvs mapPvs;                      // which clusters can see which, stored in the map file
+    double pvsBuildMs = 0;
+    MapEditor mapEditor;
+    int generateMapSize = 1024;
+    int generateMapSeed = 1;
+    double generateMapMs = 0;
+    float maxRayDistance = 0.0f;        // 0 reaches across the whole map
+    const float SHADE_DISTANCE = 16.0f;
 
 
     // Define PI
@@ -83,15 +135,68 @@ private:
     double playerAngle = 0.0f;
     double playerRadius = 0.2f;
 
+    // CPU rays through a subset of screen columns, what the shader will hit this frame
+    struct ColumnHit
+    {
+        bool hit = false;
+        uint8_t cell = 0;           // map value, 0xFF for the map border
+        int cellX = 0;
+        int cellY = 0;
+        float distance = 0;
+        float wallPixels = 0;       // projected wall height on screen
+    };
+    static const int VISIBILITY_COLUMNS = 160;
+    ColumnHit columnHits[VISIBILITY_COLUMNS];
+
+    // Startup timings
+    BootTimer bootTimer;
+
     // Shaders
     GLuint shaderProgram;
+    GLuint pendingVertexShader = 0;
+    GLuint pendingFragmentShader = 0;
     GLuint VAO, VBO;
 
-    GLuint mapTexture;
+    MapPages mapPages;
+    uint64_t mapHash = 0;
     GLuint wallTexture;
     int wallTextureX = 6;
     int wallTextureY = 20;
+    const float WALL_TILE_TEXELS = 64.0f;
 
-    GLuint overlayTexture;
     GLuint skyTexture;
+
+    // Enemy, gun, glow and font frames, packed at build time
+    TextureAtlas spriteAtlas;
+
+    // HUD sprites in one draw, weapon frames come from the gun sheet
+    HudLayer hudLayer;
+    static const int WEAPON_COUNT = 4;
+    static const int WEAPON_FRAMES = 5;         // idle, then the firing animation
+    const double WEAPON_FRAME_SECONDS = 0.07;
+    AtlasRegion weaponFrames[WEAPON_COUNT * WEAPON_FRAMES];
+    AtlasRegion overlayRegion;
+    int currentWeapon = 1;
+    int weaponFrame = 0;
+    double weaponFrameTime = 0;
+    bool showCrosshair = true;
+
+    // Cached top-down map, cells are explored by the visibility rays
+    Minimap minimap;
+    bool showMinimap = true;
+    const float MINIMAP_CELL_SCREEN_PIXELS = 10.0f;
+    const float MINIMAP_MAX_SCREEN_PIXELS = 256.0f;
+
+    // Batched distance field text, all of a frame's HUD text in one draw
+    TextRenderer hudText;
+    bool showHudText = true;
+    const float HUD_TEXT_SIZE = 28.0f;
+
+    // Texture streaming
+    const char* const ASSET_PACK_PATH = "assets.pak";
+    AssetLoader assetLoader;
+    const size_t TEXTURE_UPLOAD_BUDGET = 4 << 20;
+    bool compressTextures = true;   // BC1/BC3 in VRAM, encoded once and cached on disk
+    TextureResidency textureResidency;
+    bool texturesResident = false;
 };
\ No newline at end of file
@@ -0,0 +1,177 @@
+#include "hud_layer.h"
+#include "asset_pack.h"
+#include "profiler.h"
+#include "shader.h"
+#include "texture_residency.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+
+bool HudLayer::Init(const TextureAtlas& atlas)
+{
+    _atlas = &atlas;
+
+    std::string vertexSource, fragmentSource;
+    if (!ReadAssetText("shaders/hud_vertex_shader.glsl", vertexSource) || !ReadAssetText("shaders/hud_fragment_shader.glsl", fragmentSource))
+    {
+        std::cerr << "Failed to load HUD shaders" << std::endl;
+        return false;
+    }
+    _program = createShaderProgramFromSource(vertexSource.c_str(), fragmentSource.c_str());
+    _screenSizeLoc = glGetUniformLocation(_program, "uScreenSize");
+    _spritesLoc = glGetUniformLocation(_program, "sprites");
+
+    _instances.Create(sizeof(Instance), MAX_SPRITES);
+    glGenVertexArrays(1, &_vao);
+    glBindVertexArray(_vao);
+    for (GLuint attribute = 0; attribute < 4; attribute++)
+    {
+        glEnableVertexAttribArray(attribute);
+        glVertexAttribDivisor(attribute, 1);
+    }
+    glBindVertexArray(0);
+    return true;
+}
+
+void HudLayer::Shutdown()
+{
+    _instances.Destroy();
+    if (_vao)
+        glDeleteVertexArrays(1, &_vao);
+    if (_program)
+        glDeleteProgram(_program);
+    _vao = 0;
+    _program = 0;
+}
+
+void HudLayer::Begin(int screenWidth, int screenHeight)
+{
+    _screenWidth = screenWidth;
+    _screenHeight = screenHeight;
+    _count = 0;
+    _frame = _program ? (Instance*)_instances.Begin() : nullptr;
+}
+
+void HudLayer::Sprite(const AtlasRegion& region, float x, float y, float width, float height, uint32_t color)
+{
+    Add(region, x, y, width, height, color, MODE_SPRITE);
+}
+
+void HudLayer::Shade(const AtlasRegion& region, float x, float y, float width, float height, uint32_t color)
+{
+    Add(region, x, y, width, height, color, MODE_SHADE);
+}
+
+void HudLayer::Image(GLuint texture, float x, float y, float width, float height, float u0, float v0, float u1, float v1, uint32_t color)
+{
+    Instance* instance = Add(texture, x, y, width, height, color, MODE_SPRITE);
+    if (!instance)
+        return;
+    instance->u0 = u0;
+    instance->v0 = v0;
+    instance->u1 = u1;
+    instance->v1 = v1;
+}
+
+void HudLayer::Rect(float x, float y, float width, float height, uint32_t color)
+{
+    // Solid rects do not sample, they join whatever run is current
+    Add(_count > 0 ? _textures[_count - 1] : 0, x, y, width, height, color, MODE_SOLID);
+}
+
+HudLayer::Instance* HudLayer::Add(GLuint texture, float x, float y, float width, float height, uint32_t color, Mode mode)
+{
+    if (!_frame || _count >= MAX_SPRITES)
+        return nullptr;
+
+    Instance& instance = _frame[_count];
+    instance.x = x;
+    instance.y = y;
+    instance.width = width;
+    instance.height = height;
+    instance.u0 = 0.0f;
+    instance.v0 = 0.0f;
+    instance.u1 = 0.0f;
+    instance.v1 = 0.0f;
+    instance.color = color;
+    instance.mode = mode;
+    _textures[_count] = texture;
+    _count++;
+    return &instance;
+}
+
+HudLayer::Instance* HudLayer::Add(const AtlasRegion& region, float x, float y, float width, float height, uint32_t color, Mode mode)
+{
+    if (region.page < 0 || region.page >= _atlas->PageCount())
+        return nullptr;
+
+    GLuint page = _atlas->PageTexture(region.page);
+    Instance* instance = Add(page, x, y, width, height, color, mode);
+    if (!instance)
+        return nullptr;
+    instance->u0 = region.u0;
+    instance->v0 = region.v0;
+    instance->u1 = region.u1;
+    instance->v1 = region.v1;
+
+    if (_residency && width > 0 && height > 0)
+    {
+        float texelsPerPixel = std::max(region.width / width, region.height / height);
+        _residency->MarkVisible(page, texelsPerPixel, (int)(width * height));
+    }
+    return instance;
+}
+
+void HudLayer::End()
+{
+    PROFILE_FUNCTION();
+
+    _spritesLastFrame = _count;
+    _drawCallsLastFrame = 0;
+    if (!_frame)
+        return;
+    _frame = nullptr;
+
+    GLintptr offset = _instances.End(_count);
+    if (_count == 0)
+    {
+        _instances.Fence();
+        return;
+    }
+
+    glUseProgram(_program);
+    glUniform2f(_screenSizeLoc, (GLfloat)_screenWidth, (GLfloat)_screenHeight);
+    glUniform1i(_spritesLoc, 0);
+    glActiveTexture(GL_TEXTURE0);
+
+    glBindVertexArray(_vao);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    // Runs of sprites on one texture, submission order is draw order
+    int first = 0;
+    while (first < _count)
+    {
+        int last = first + 1;
+        while (last < _count && _textures[last] == _textures[first])
+            last++;
+
+        GLintptr runOffset = offset + first * sizeof(Instance);
+        glBindBuffer(GL_ARRAY_BUFFER, _instances.Buffer());
+        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)(runOffset + offsetof(Instance, x)));
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)(runOffset + offsetof(Instance, u0)));
+        glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Instance), (void*)(runOffset + offsetof(Instance, color)));
+        glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, sizeof(Instance), (void*)(runOffset + offsetof(Instance, mode)));
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        glBindTexture(GL_TEXTURE_2D, _textures[first]);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, last - first);
+        _drawCallsLastFrame++;
+        first = last;
+    }
+
+    glDisable(GL_BLEND);
+    glBindVertexArray(0);
+    _instances.Fence();
+}
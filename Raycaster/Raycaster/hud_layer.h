@@ -0,0 +1,85 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cstdint>
+#include "instance_buffer.h"
+#include "texture_atlas.h"
+
+class TextureResidency;
+
+// Screen-space sprites drawn over the scene: weapon, crosshair, overlays.
+//
+// Calls between Begin and End append instances to a persistently mapped
+// buffer, End draws them in submission order with one instanced draw per run
+// of sprites on the same texture. The HUD frames are packed on one atlas
+// page, so the sprites are a single draw; a cached image such as the minimap
+// adds one more. Animation is only a
+// different atlas region per frame, nothing is rebound. Positions are in
+// pixels with the origin at the top left.
+
+class HudLayer
+{
+public:
+    static const int MAX_SPRITES = 1024;
+
+    // Needs the GL context and a loaded atlas
+    bool Init(const TextureAtlas& atlas);
+    void Shutdown();
+
+    // Sprites report their atlas page and on-screen size here
+    void SetResidency(TextureResidency* residency) { _residency = residency; }
+
+    void Begin(int screenWidth, int screenHeight);
+    void End();
+
+    // Atlas frame, color multiplies the texels
+    void Sprite(const AtlasRegion& region, float x, float y, float width, float height, uint32_t color = 0xFFFFFFFF);
+
+    // Darkens what is below by one minus the frame's red channel, for vignettes
+    void Shade(const AtlasRegion& region, float x, float y, float width, float height, uint32_t color = 0xFF000000);
+
+    // Any texture, for cached render targets. v1 is the top edge.
+    void Image(GLuint texture, float x, float y, float width, float height, float u0, float v0, float u1, float v1, uint32_t color = 0xFFFFFFFF);
+
+    // Untextured rectangle
+    void Rect(float x, float y, float width, float height, uint32_t color);
+
+    int SpritesLastFrame() const { return _spritesLastFrame; }
+    int DrawCallsLastFrame() const { return _drawCallsLastFrame; }
+
+private:
+    enum Mode : uint32_t
+    {
+        MODE_SPRITE = 0,
+        MODE_SHADE = 1,
+        MODE_SOLID = 2
+    };
+
+    struct Instance
+    {
+        float x, y, width, height;
+        float u0, v0, u1, v1;
+        uint32_t color;
+        uint32_t mode;
+    };
+
+    Instance* Add(GLuint texture, float x, float y, float width, float height, uint32_t color, Mode mode);
+    Instance* Add(const AtlasRegion& region, float x, float y, float width, float height, uint32_t color, Mode mode);
+
+    const TextureAtlas* _atlas = nullptr;
+    TextureResidency* _residency = nullptr;
+
+    GLuint _program = 0;
+    GLuint _vao = 0;
+    GLint _screenSizeLoc = -1;
+    GLint _spritesLoc = -1;
+    InstanceBuffer _instances;
+
+    Instance* _frame = nullptr;
+    GLuint _textures[MAX_SPRITES] = {};
+    int _count = 0;
+    int _screenWidth = 0;
+    int _screenHeight = 0;
+    int _spritesLastFrame = 0;
+    int _drawCallsLastFrame = 0;
+};
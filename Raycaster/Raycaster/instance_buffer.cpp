@@ -0,0 +1,89 @@
+#include "instance_buffer.h"
+#include "profiler.h"
+
+bool InstanceBuffer::Create(size_t instanceSize, int capacity)
+{
+    _instanceSize = instanceSize;
+    _capacity = capacity;
+    size_t regionSize = instanceSize * capacity;
+
+    glGenBuffers(1, &_buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, _buffer);
+    if (GLEW_ARB_buffer_storage)
+    {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_ARRAY_BUFFER, regionSize * REGION_COUNT, nullptr, flags);
+        _mapped = (unsigned char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, regionSize * REGION_COUNT, flags);
+    }
+    if (!_mapped)
+    {
+        glBufferData(GL_ARRAY_BUFFER, regionSize, nullptr, GL_STREAM_DRAW);
+        _staging.resize(regionSize);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return _buffer != 0;
+}
+
+void InstanceBuffer::Destroy()
+{
+    for (GLsync& fence : _fences)
+    {
+        if (fence)
+            glDeleteSync(fence);
+        fence = nullptr;
+    }
+    if (_mapped)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, _buffer);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        _mapped = nullptr;
+    }
+    if (_buffer)
+        glDeleteBuffers(1, &_buffer);
+    _buffer = 0;
+    _staging.clear();
+    _staging.shrink_to_fit();
+}
+
+void* InstanceBuffer::Begin()
+{
+    if (!_mapped)
+        return _staging.data();
+
+    GLsync& fence = _fences[_region];
+    if (fence)
+    {
+        PROFILE_ZONE("Wait for instance region");
+        GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        while (status == GL_TIMEOUT_EXPIRED)
+            status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+    return _mapped + _instanceSize * _capacity * _region;
+}
+
+GLintptr InstanceBuffer::End(int count)
+{
+    if (_mapped)
+        return (GLintptr)(_instanceSize * _capacity * _region);
+
+    // Orphan so the driver never stalls on last frame's draw
+    size_t regionSize = _instanceSize * _capacity;
+    glBindBuffer(GL_ARRAY_BUFFER, _buffer);
+    glBufferData(GL_ARRAY_BUFFER, regionSize, nullptr, GL_STREAM_DRAW);
+    if (count > 0)
+        glBufferSubData(GL_ARRAY_BUFFER, 0, _instanceSize * count, _staging.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return 0;
+}
+
+void InstanceBuffer::Fence()
+{
+    if (!_mapped)
+        return;
+
+    _fences[_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    _region = (_region + 1) % REGION_COUNT;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <vector>
+
+// Per-frame instance data streamed to the GPU for batched draws.
+//
+// With ARB_buffer_storage the buffer is mapped once, persistently and
+// coherently, and split into REGION_COUNT regions used round robin. A fence
+// placed after the frame's draws guards each region, so Begin only waits when
+// the GPU is still reading instances from REGION_COUNT frames ago. Without the
+// extension Begin hands out a CPU staging copy that End uploads into an
+// orphaned buffer. Either way a frame never allocates.
+
+class InstanceBuffer
+{
+public:
+    InstanceBuffer() = default;
+    InstanceBuffer(const InstanceBuffer&) = delete;
+    InstanceBuffer& operator=(const InstanceBuffer&) = delete;
+
+    // Needs the GL context
+    bool Create(size_t instanceSize, int capacity);
+    void Destroy();
+
+    // Room for Capacity() instances of this frame
+    void* Begin();
+
+    // Makes count instances visible to the GPU, returns their byte offset in Buffer()
+    GLintptr End(int count);
+
+    // After the last draw that reads this frame's instances
+    void Fence();
+
+    GLuint Buffer() const { return _buffer; }
+    int Capacity() const { return _capacity; }
+    bool IsPersistent() const { return _mapped != nullptr; }
+
+private:
+    static const int REGION_COUNT = 3;
+
+    GLuint _buffer = 0;
+    size_t _instanceSize = 0;
+    int _capacity = 0;
+    unsigned char* _mapped = nullptr;
+    std::vector<unsigned char> _staging;
+    int _region = 0;
+    GLsync _fences[REGION_COUNT] = {};
+};
@@ -0,0 +1,694 @@
+#include "map.h"
+#include "content_hash.h"
+#include "parallel_for.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+    size_t ChunkBytes(const MapChunk& chunk)
+    {
+        return sizeof(MapChunk) + (chunk.metadata ? MAP_CHUNK_CELLS : 0);
+    }
+
+    bool IsEmpty(const MapChunk& chunk)
+    {
+        for (uint64_t row : chunk.occupancy)
+            if (row)
+                return false;
+        for (uint8_t material : chunk.material)
+            if (material)
+                return false;
+        return !chunk.metadata;
+    }
+
+    bool DecodeRle(const unsigned char* data, size_t size, unsigned char* out, size_t rawSize)
+    {
+        size_t written = 0;
+        for (size_t i = 0; i + 1 < size; i += 2)
+        {
+            size_t run = (size_t)data[i] + 1;
+            if (written + run > rawSize)
+                return false;
+            memset(out + written, data[i + 1], run);
+            written += run;
+        }
+        return written == rawSize;
+    }
+
+    void EncodeRle(const unsigned char* data, size_t size, std::vector<unsigned char>& out)
+    {
+        out.clear();
+        for (size_t i = 0; i < size;)
+        {
+            size_t run = 1;
+            while (i + run < size && run < 256 && data[i + run] == data[i])
+                run++;
+            out.push_back((unsigned char)(run - 1));
+            out.push_back(data[i]);
+            i += run;
+        }
+    }
+
+    MapChunk MakeUnloadedChunk()
+    {
+        MapChunk chunk;
+        memset(chunk.occupancy, 0xFF, sizeof(chunk.occupancy));
+        memset(chunk.material, MAP_CELL_UNLOADED, sizeof(chunk.material));
+        chunk.solidCount = MAP_CHUNK_CELLS;
+        return chunk;
+    }
+
+    int CountSolid(const MapChunk& chunk)
+    {
+        int count = 0;
+        for (uint64_t row : chunk.occupancy)
+            for (; row; row &= row - 1)
+                count++;
+        return count;
+    }
+
+    const unsigned char* LayerBytes(const MapChunk& chunk, uint32_t layer)
+    {
+        static const uint8_t zeros[MAP_CHUNK_CELLS] = {};
+        switch (layer)
+        {
+        case MAP_LAYER_OCCUPANCY: return (const unsigned char*)chunk.occupancy;
+        case MAP_LAYER_MATERIAL: return chunk.material;
+        default: return chunk.metadata ? chunk.metadata.get() : zeros;
+        }
+    }
+}
+
+const MapChunk Map::UNLOADED_CHUNK = MakeUnloadedChunk();
+
+bool Map::LoadText(const std::string& path)
+{
+    PROFILE_FUNCTION();
+
+    std::string text;
+    if (!ReadAssetText(path, text))
+    {
+        std::cerr << "Failed to load map: " << path << std::endl;
+        return false;
+    }
+
+    std::vector<std::string> rows;
+    std::istringstream lines(text);
+    std::string line;
+    size_t width = 0;
+    while (std::getline(lines, line))
+    {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (!line.empty() && line[0] == '#')
+            continue;
+        width = std::max(width, line.size());
+        rows.push_back(line);
+    }
+    while (!rows.empty() && rows.back().empty())
+        rows.pop_back();
+
+    if (width == 0 || rows.empty())
+    {
+        std::cerr << "Empty map: " << path << std::endl;
+        return false;
+    }
+
+    Resize((int)width, (int)rows.size());
+    for (int y = 0; y < _height; y++)
+    {
+        const std::string& row = rows[y];
+        for (int x = 0; x < (int)row.size(); x++)
+        {
+            char c = row[x];
+            if (c >= '0' && c <= '9')
+                Set(x, y, (uint8_t)(c - '0'));
+            else if (c == 'P')
+            {
+                _startX = x + 0.5;
+                _startY = y + 0.5;
+            }
+            else if (c != '.' && c != ' ')
+            {
+                std::cerr << path << ": unknown cell '" << c << "' at " << x << ", " << y << std::endl;
+                return false;
+            }
+        }
+    }
+    _contentHash = HashContent(text.data(), text.size());
+    ResetDirty();
+    _revision = 0;
+    return true;
+}
+
+bool Map::LoadBinary(const std::string& path)
+{
+    PROFILE_FUNCTION();
+
+    CloseFile();
+
+    // Mapped either way: from the pack when it has the map, the loose file otherwise
+    AssetData asset;
+    if (AssetPack::Find(path, asset))
+    {
+        _asset = std::move(asset);
+        _fileData = _asset.data;
+        _fileSize = _asset.size;
+    }
+    else if (_file.Open(path))
+    {
+        _fileData = _file.Data();
+        _fileSize = _file.Size();
+    }
+    else
+    {
+        std::cerr << "Failed to open map: " << path << std::endl;
+        return false;
+    }
+
+    MapHeader header;
+    if (_fileSize < sizeof(header))
+    {
+        std::cerr << "Invalid map: " << path << std::endl;
+        CloseFile();
+        return false;
+    }
+    memcpy(&header, _fileData, sizeof(header));
+    uint64_t entryCount = (uint64_t)header.chunksX * header.chunksY * header.layerCount;
+    if (memcmp(header.magic, MAP_MAGIC, sizeof(header.magic)) != 0 || header.version != MAP_VERSION
+        || header.chunkSize != (uint32_t)MAP_CHUNK_SIZE || header.layerCount != MAP_LAYER_COUNT
+        || header.chunksX != (header.width + MAP_CHUNK_SIZE - 1) / MAP_CHUNK_SIZE
+        || header.chunksY != (header.height + MAP_CHUNK_SIZE - 1) / MAP_CHUNK_SIZE
+        || header.directoryOffset > _fileSize || entryCount * sizeof(MapChunkEntry) > _fileSize - header.directoryOffset)
+    {
+        std::cerr << "Invalid map: " << path << std::endl;
+        CloseFile();
+        return false;
+    }
+
+    // Nothing is decoded yet, chunks come in as they are touched
+    _width = (int)header.width;
+    _height = (int)header.height;
+    _chunksX = (int)header.chunksX;
+    _chunksY = (int)header.chunksY;
+    _chunks.clear();
+    _chunks.resize((size_t)_chunksX * _chunksY);
+    _state.assign(_chunks.size(), CHUNK_UNLOADED);
+    ResetDirty();
+    _decodedCount = 0;
+    _residentBytes = 0;
+    _directory = (const MapChunkEntry*)(_fileData + header.directoryOffset);
+    _startX = header.startX;
+    _startY = header.startY;
+    _contentHash = header.contentHash;
+    _revision = 0;
+    ResetPvs((header.flags & MAP_FLAG_PVS) != 0);
+    return true;
+}
+
+const MapChunk* Map::DecodeChunk(size_t index) const
+{
+    std::unique_ptr<MapChunk> chunk = DecodeChunkData((int)(index % _chunksX), (int)(index / _chunksX));
+    _state[index] = CHUNK_LOADED;
+    _decodedCount++;
+    if (!chunk)
+        return nullptr;
+
+    _residentBytes += ChunkBytes(*chunk);
+    _chunks[index] = std::move(chunk);
+    return _chunks[index].get();
+}
+
+std::unique_ptr<MapChunk> Map::DecodeChunkData(int chunkX, int chunkY) const
+{
+    if (!_fileData)
+        return nullptr;
+
+    size_t index = (size_t)chunkY * _chunksX + chunkX;
+    std::unique_ptr<MapChunk> chunk(new MapChunk());
+    for (uint32_t layer = 0; layer < MAP_CELL_LAYER_COUNT; layer++)
+    {
+        MapChunkEntry entry;
+        memcpy(&entry, &_directory[index * MAP_LAYER_COUNT + layer], sizeof(entry));
+
+        if (entry.compression == MAP_COMPRESSION_UNIFORM && entry.uniformValue == 0)
+            continue;
+
+        unsigned char* out;
+        if (layer == MAP_LAYER_OCCUPANCY)
+            out = (unsigned char*)chunk->occupancy;
+        else if (layer == MAP_LAYER_MATERIAL)
+            out = chunk->material;
+        else
+        {
+            chunk->metadata.reset(new uint8_t[MAP_CHUNK_CELLS]);
+            out = chunk->metadata.get();
+        }
+
+        uint32_t rawSize = MapLayerBytes(layer);
+        bool valid = entry.rawSize == rawSize && entry.offset <= _fileSize && entry.size <= _fileSize - entry.offset;
+        const unsigned char* data = _fileData + entry.offset;
+        if (valid && entry.compression == MAP_COMPRESSION_UNIFORM)
+            memset(out, entry.uniformValue, rawSize);
+        else if (valid && entry.compression == MAP_COMPRESSION_NONE && entry.size == rawSize)
+            memcpy(out, data, rawSize);
+        else if (!valid || entry.compression != MAP_COMPRESSION_RLE || !DecodeRle(data, entry.size, out, rawSize))
+        {
+            std::cerr << "Corrupt map chunk " << index << ", layer " << layer << std::endl;
+            memset(out, 0, rawSize);
+        }
+    }
+
+    if (IsEmpty(*chunk))
+        return nullptr;
+    chunk->solidCount = CountSolid(*chunk);
+    return chunk;
+}
+
+void Map::InstallChunk(int chunkX, int chunkY, std::unique_ptr<MapChunk> chunk)
+{
+    size_t index = (size_t)chunkY * _chunksX + chunkX;
+    if (_state[index] != CHUNK_UNLOADED)
+        return;
+
+    _state[index] = CHUNK_LOADED;
+    _decodedCount++;
+    if (chunk)
+        _residentBytes += ChunkBytes(*chunk);
+    _chunks[index] = std::move(chunk);
+}
+
+bool Map::EvictChunk(int chunkX, int chunkY)
+{
+    // Edited chunks only exist in memory, dropping them would lose the edits
+    size_t index = (size_t)chunkY * _chunksX + chunkX;
+    if (_state[index] != CHUNK_LOADED || !_fileData)
+        return false;
+
+    _state[index] = CHUNK_UNLOADED;
+    _decodedCount--;
+    if (_chunks[index])
+        _residentBytes -= ChunkBytes(*_chunks[index]);
+    _chunks[index].reset();
+    return true;
+}
+
+bool Map::SaveBinary(const std::string& path) const
+{
+    PROFILE_FUNCTION();
+
+    MapHeader header = {};
+    memcpy(header.magic, MAP_MAGIC, sizeof(header.magic));
+    header.version = MAP_VERSION;
+    header.width = (uint32_t)_width;
+    header.height = (uint32_t)_height;
+    header.chunkSize = (uint32_t)MAP_CHUNK_SIZE;
+    header.chunksX = (uint32_t)_chunksX;
+    header.chunksY = (uint32_t)_chunksY;
+    header.layerCount = MAP_LAYER_COUNT;
+    header.startX = (float)_startX;
+    header.startY = (float)_startY;
+    header.directoryOffset = sizeof(header);
+    header.flags = _hasPvs ? (uint32_t)MAP_FLAG_PVS : 0u;
+
+    size_t chunkCount = (size_t)_chunksX * _chunksY;
+    std::vector<MapChunkEntry> directory(chunkCount * MAP_LAYER_COUNT);
+    std::vector<unsigned char> data;
+    std::vector<unsigned char> encoded;
+    uint64_t dataOffset = sizeof(header) + directory.size() * sizeof(MapChunkEntry);
+    uint64_t contentHash = HashContent(&header.width, sizeof(header.width) * 2);
+
+    // Chunks that are not loaded are decoded one at a time and let go again
+    static const MapChunk emptyChunk;
+    std::unique_ptr<MapChunk> unloaded;
+    for (size_t index = 0; index < chunkCount; index++)
+    {
+        int chunkX = (int)(index % _chunksX);
+        int chunkY = (int)(index / _chunksX);
+        const MapChunk* chunk;
+        if (_state[index] != CHUNK_UNLOADED)
+            chunk = _chunks[index].get();
+        else
+        {
+            unloaded = DecodeChunkData(chunkX, chunkY);
+            chunk = unloaded.get();
+        }
+        if (!chunk)
+            chunk = &emptyChunk;
+
+        for (uint32_t layer = 0; layer < MAP_CELL_LAYER_COUNT; layer++)
+        {
+            const unsigned char* raw = LayerBytes(*chunk, layer);
+            uint32_t rawSize = MapLayerBytes(layer);
+            contentHash = HashContent(raw, rawSize, contentHash);
+
+            MapChunkEntry& entry = directory[index * MAP_LAYER_COUNT + layer];
+            entry.rawSize = rawSize;
+            if (std::all_of(raw, raw + rawSize, [raw](unsigned char b) { return b == raw[0]; }))
+            {
+                entry.compression = MAP_COMPRESSION_UNIFORM;
+                entry.uniformValue = raw[0];
+                continue;
+            }
+
+            EncodeRle(raw, rawSize, encoded);
+            entry.offset = dataOffset + data.size();
+            if (encoded.size() < rawSize)
+            {
+                entry.compression = MAP_COMPRESSION_RLE;
+                entry.size = (uint32_t)encoded.size();
+                data.insert(data.end(), encoded.begin(), encoded.end());
+            }
+            else
+            {
+                entry.compression = MAP_COMPRESSION_NONE;
+                entry.size = rawSize;
+                data.insert(data.end(), raw, raw + rawSize);
+            }
+        }
+
+        // Sets are stored as they are, 4-byte aligned, to be read in place
+        size_t pvsBytes;
+        const unsigned char* pvs = PvsData(chunkX, chunkY, pvsBytes);
+        MapChunkEntry& entry = directory[index * MAP_LAYER_COUNT + MAP_LAYER_PVS];
+        entry.rawSize = (uint32_t)pvsBytes;
+        if (!pvs)
+        {
+            entry.compression = MAP_COMPRESSION_UNIFORM;
+            continue;
+        }
+        data.resize((data.size() + dataOffset + 3) / 4 * 4 - dataOffset);
+        entry.compression = MAP_COMPRESSION_NONE;
+        entry.offset = dataOffset + data.size();
+        entry.size = (uint32_t)pvsBytes;
+        data.insert(data.end(), pvs, pvs + pvsBytes);
+    }
+    header.contentHash = contentHash;
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+    {
+        std::cerr << "Failed to write map: " << path << std::endl;
+        return false;
+    }
+    file.write((const char*)&header, sizeof(header));
+    file.write((const char*)directory.data(), directory.size() * sizeof(MapChunkEntry));
+    file.write((const char*)data.data(), data.size());
+    return (bool)file;
+}
+
+bool Map::SaveAndReopen(const std::string& path)
+{
+    PROFILE_FUNCTION();
+
+    // Written beside the target first: chunks that are not loaded are read out
+    // of the old file while saving, and the target may be that very file
+    std::string temporary = path + ".tmp";
+    if (!SaveBinary(temporary))
+        return false;
+
+    // Nothing maps the old file once it is closed, so it can be replaced.
+    // Every chunk still in memory is in the new file exactly as it is here.
+    CloseFile();
+    std::remove(path.c_str());
+    std::string saved = path;
+    if (std::rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        std::cerr << "Failed to replace map: " << path << ", saved as " << temporary << std::endl;
+        saved = temporary;
+    }
+
+    // Unloaded chunks read as empty if the file cannot be mapped again
+    MapHeader header;
+    if (!_file.Open(saved) || _file.Size() < sizeof(header))
+    {
+        std::cerr << "Failed to reopen map: " << saved << std::endl;
+        _file.Close();
+        return false;
+    }
+    _fileData = _file.Data();
+    _fileSize = _file.Size();
+    memcpy(&header, _fileData, sizeof(header));
+    _directory = (const MapChunkEntry*)(_fileData + header.directoryOffset);
+    _contentHash = header.contentHash;
+    _revision = 0;
+    for (ChunkState& state : _state)
+        if (state == CHUNK_EDITED)
+            state = CHUNK_LOADED;
+    for (size_t index = 0; index < _chunks.size(); index++)
+        if (_pvsReplaced[index])
+            _residentBytes -= _pvs[index].size();
+    ResetPvs((header.flags & MAP_FLAG_PVS) != 0);
+    return saved == path;
+}
+
+void Map::Generate(int width, int height, uint32_t seed)
+{
+    PROFILE_FUNCTION();
+
+    uint64_t contentHash = HashContent(&seed, sizeof(seed), HashContent(&width, sizeof(width), HashContent(&height, sizeof(height))));
+
+    // Room walls on a coarse grid with door gaps, then scattered pillars.
+    // Every chunk has its own random sequence, so chunks do not depend on each other.
+    const int ROOM = 12;
+    int chunksX = (width + MAP_CHUNK_SIZE - 1) / MAP_CHUNK_SIZE;
+    Build(width, height, contentHash, [=](int chunkX, int chunkY) {
+        uint32_t state = seed * 2654435761u ^ (uint32_t)(chunkY * chunksX + chunkX) * 40503u;
+        state = state ? state : 1;
+        auto next = [&state]() {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            return state;
+        };
+
+        std::unique_ptr<MapChunk> chunk(new MapChunk());
+        int x0 = chunkX * MAP_CHUNK_SIZE;
+        int y0 = chunkY * MAP_CHUNK_SIZE;
+        for (int cy = 0; cy < MAP_CHUNK_SIZE && y0 + cy < height; cy++)
+        {
+            int y = y0 + cy;
+            bool wallRow = y % ROOM == 0;
+            for (int cx = 0; cx < MAP_CHUNK_SIZE && x0 + cx < width; cx++)
+            {
+                int x = x0 + cx;
+                bool wallColumn = x % ROOM == 0;
+                uint32_t r = next();
+                uint8_t value;
+                if (x == 0 || y == 0 || x == width - 1 || y == height - 1)
+                    value = 1;
+                else if ((wallRow || wallColumn) && (x % ROOM < 4 || x % ROOM > 7) && (y % ROOM < 4 || y % ROOM > 7))
+                    value = (r & 7) == 0 ? 0 : 1;
+                else
+                    value = (r % 100) < 3 ? 1 : 0;
+
+                chunk->material[(cy << MAP_CHUNK_SHIFT) | cx] = value;
+                if (value)
+                    chunk->occupancy[cy] |= 1ull << cx;
+            }
+        }
+        return chunk;
+    });
+
+    // Start in the middle of the first room
+    int start = std::min(ROOM / 2, std::max(1, std::min(width, height) / 2));
+    _startX = start + 0.5;
+    _startY = start + 0.5;
+    if (InBounds(start, start))
+        Set(start, start, 0);
+    ResetDirty();
+    _revision = 0;
+}
+
+void Map::Build(int width, int height, uint64_t contentHash, const ChunkBuilder& makeChunk, int threads)
+{
+    PROFILE_FUNCTION();
+
+    Resize(width, height);
+    _contentHash = contentHash;
+
+    // Each worker fills its own slots, the vector itself is sized up front and not touched otherwise
+    ParallelFor(_chunks.size(), threads, "Map builder", [&](size_t index, int) {
+        std::unique_ptr<MapChunk> chunk = makeChunk((int)(index % _chunksX), (int)(index / _chunksX));
+        if (chunk && IsEmpty(*chunk))
+            chunk.reset();
+        if (chunk)
+            chunk->solidCount = CountSolid(*chunk);
+        _chunks[index] = std::move(chunk);
+    });
+
+    for (const std::unique_ptr<MapChunk>& chunk : _chunks)
+        if (chunk)
+            _residentBytes += ChunkBytes(*chunk);
+}
+
+void Map::Resize(int width, int height)
+{
+    CloseFile();
+    _width = std::max(0, width);
+    _height = std::max(0, height);
+    _chunksX = (_width + MAP_CHUNK_SIZE - 1) / MAP_CHUNK_SIZE;
+    _chunksY = (_height + MAP_CHUNK_SIZE - 1) / MAP_CHUNK_SIZE;
+    _chunks.clear();
+    _chunks.resize((size_t)_chunksX * _chunksY);
+    _state.assign(_chunks.size(), CHUNK_LOADED);
+    ResetDirty();
+    _decodedCount = (int)_chunks.size();
+    _residentBytes = 0;
+    _contentHash = 0;
+    _revision = 0;
+    ResetPvs(false);
+}
+
+void Map::CloseFile()
+{
+    _directory = nullptr;
+    _fileData = nullptr;
+    _fileSize = 0;
+    _asset = AssetData();
+    _file.Close();
+}
+
+MapChunk* Map::MutableChunk(int chunkX, int chunkY)
+{
+    // Editing a chunk loads it for good, even on a streamed map
+    size_t index = (size_t)chunkY * _chunksX + chunkX;
+    if (_state[index] == CHUNK_UNLOADED)
+        DecodeChunk(index);
+    _state[index] = CHUNK_EDITED;
+    if (!_chunks[index])
+    {
+        _chunks[index].reset(new MapChunk());
+        _residentBytes += sizeof(MapChunk);
+    }
+    return _chunks[index].get();
+}
+
+uint8_t Map::Metadata(int x, int y) const
+{
+    const MapChunk* chunk = Chunk(x >> MAP_CHUNK_SHIFT, y >> MAP_CHUNK_SHIFT);
+    return chunk && chunk->metadata ? chunk->metadata[((y & (MAP_CHUNK_SIZE - 1)) << MAP_CHUNK_SHIFT) | (x & (MAP_CHUNK_SIZE - 1))] : 0;
+}
+
+void Map::Set(int x, int y, uint8_t material)
+{
+    MapChunk* chunk = MutableChunk(x >> MAP_CHUNK_SHIFT, y >> MAP_CHUNK_SHIFT);
+    int cx = x & (MAP_CHUNK_SIZE - 1);
+    int cy = y & (MAP_CHUNK_SIZE - 1);
+    uint8_t& cell = chunk->material[(cy << MAP_CHUNK_SHIFT) | cx];
+    if (cell == material)
+        return;
+
+    // The occupancy bit and solid count follow the material
+    bool wasSolid = cell != 0;
+    cell = material;
+    if (material && !wasSolid)
+    {
+        chunk->occupancy[cy] |= 1ull << cx;
+        chunk->solidCount++;
+    }
+    else if (!material && wasSolid)
+    {
+        chunk->occupancy[cy] &= ~(1ull << cx);
+        chunk->solidCount--;
+    }
+    MarkDirty(x, y);
+    _revision++;
+}
+
+void Map::MarkDirty(int x, int y)
+{
+    size_t index = (size_t)(y >> MAP_CHUNK_SHIFT) * _chunksX + (x >> MAP_CHUNK_SHIFT);
+    int& slot = _dirtyIndex[index];
+    if (slot < 0)
+    {
+        slot = (int)_dirtyRects.size();
+        _dirtyRects.push_back({ x, y, x, y });
+        return;
+    }
+    MapDirtyRect& rect = _dirtyRects[slot];
+    rect.x0 = std::min(rect.x0, x);
+    rect.y0 = std::min(rect.y0, y);
+    rect.x1 = std::max(rect.x1, x);
+    rect.y1 = std::max(rect.y1, y);
+}
+
+void Map::ClearDirty()
+{
+    for (const MapDirtyRect& rect : _dirtyRects)
+        _dirtyIndex[(size_t)(rect.y0 >> MAP_CHUNK_SHIFT) * _chunksX + (rect.x0 >> MAP_CHUNK_SHIFT)] = -1;
+    _dirtyRects.clear();
+}
+
+void Map::ResetDirty()
+{
+    _dirtyRects.clear();
+    _dirtyIndex.assign(_chunks.size(), -1);
+}
+
+void Map::ResetPvs(bool hasPvs)
+{
+    _hasPvs = hasPvs;
+    _pvs.clear();
+    _pvs.resize(_chunks.size());
+    _pvsReplaced.assign(_chunks.size(), 0);
+}
+
+const unsigned char* Map::PvsData(int chunkX, int chunkY, size_t& bytes) const
+{
+    size_t index = (size_t)chunkY * _chunksX + chunkX;
+    if (_pvsReplaced[index])
+    {
+        bytes = _pvs[index].size();
+        return bytes ? _pvs[index].data() : nullptr;
+    }
+
+    // Straight out of the mapping, anything that does not fit the file counts as missing
+    bytes = 0;
+    if (!_fileData)
+        return nullptr;
+    MapChunkEntry entry;
+    memcpy(&entry, &_directory[index * MAP_LAYER_COUNT + MAP_LAYER_PVS], sizeof(entry));
+    if (entry.compression != MAP_COMPRESSION_NONE || entry.size == 0
+        || entry.offset > _fileSize || entry.size > _fileSize - entry.offset)
+        return nullptr;
+    bytes = entry.size;
+    return _fileData + entry.offset;
+}
+
+void Map::SetPvsData(int chunkX, int chunkY, std::vector<unsigned char> data)
+{
+    size_t index = (size_t)chunkY * _chunksX + chunkX;
+    if (_pvsReplaced[index])
+        _residentBytes -= _pvs[index].size();
+    _residentBytes += data.size();
+    _pvs[index] = std::move(data);
+    _pvsReplaced[index] = 1;
+    _hasPvs = true;
+}
+
+void Map::SetMetadata(int x, int y, uint8_t value)
+{
+    MapChunk* chunk = MutableChunk(x >> MAP_CHUNK_SHIFT, y >> MAP_CHUNK_SHIFT);
+    if (!chunk->metadata)
+    {
+        if (value == 0)
+            return;
+        chunk->metadata.reset(new uint8_t[MAP_CHUNK_CELLS]());
+        _residentBytes += MAP_CHUNK_CELLS;
+    }
+    chunk->metadata[((y & (MAP_CHUNK_SIZE - 1)) << MAP_CHUNK_SHIFT) | (x & (MAP_CHUNK_SIZE - 1))] = value;
+    _revision++;
+}
+
+uint64_t Map::Hash() const
+{
+    return HashContent(&_revision, sizeof(_revision), _contentHash);
+}
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "asset_pack.h"
+#include "map_format.h"
+#include "mapped_file.h"
+
+// Grid of map cells with its size decided at runtime.
+//
+// Cells are grouped in MAP_CHUNK_SIZE chunks with an occupancy bit, a
+// material byte and a metadata byte each (see map_format.h). A cell is a wall
+// when its occupancy bit is set, the material is what the wall looks like.
+// Everything outside the map counts as wall. Chunks with nothing in them are
+// not stored at all.
+//
+// Binary maps are memory mapped and every chunk is decoded the first time
+// one of its cells is touched, so opening a huge level only reads its header
+// and memory follows the area actually visited. A streamed map never decodes
+// on touch: chunks are brought in and dropped by a MapStreamer, and a chunk
+// that is not loaded reads as solid MAP_CELL_UNLOADED cells, so collision and
+// rays stop at its edge instead of walking into unknown space.
+
+// Material of cells in chunks a streamed map has not loaded
+const uint8_t MAP_CELL_UNLOADED = 0xFF;
+
+struct MapChunk
+{
+    uint64_t occupancy[MAP_CHUNK_SIZE] = {};        // bit x of row y
+    uint8_t material[MAP_CHUNK_CELLS] = {};         // row by row
+    std::unique_ptr<uint8_t[]> metadata;            // null while all zero
+    int solidCount = 0;                             // set occupancy bits, 0 when there is nothing to hit
+};
+
+// Cells changed by Map::Set, inclusive map cells, never crossing a chunk edge
+struct MapDirtyRect
+{
+    int x0, y0, x1, y1;
+};
+
+class Map
+{
+public:
+    Map() = default;
+    Map(const Map&) = delete;
+    Map& operator=(const Map&) = delete;
+
+    // Text levels: one row of cells per line, '.' or ' ' is floor, a digit is
+    // that cell value, 'P' is floor where the player starts
+    bool LoadText(const std::string& path);
+
+    // Chunked binary map, through the asset pack when it has it
+    bool LoadBinary(const std::string& path);
+    bool SaveBinary(const std::string& path) const;
+
+    // Saves and carries on from the saved file, which may be the one this map
+    // is mapped from. Edited chunks are then part of the file and can be
+    // evicted again. Nothing may read the file meanwhile: stop streaming first.
+    bool SaveAndReopen(const std::string& path);
+
+    // Walled border with rooms and pillars, the same seed gives the same map
+    void Generate(int width, int height, uint32_t seed);
+
+    // Replaces the map with one made chunk by chunk on worker threads, 0 uses
+    // every core. makeChunk(chunkX, chunkY) returns the chunk's cells or null
+    // when it is empty, and runs for many chunks at once, so it may only read
+    // shared state. The solid counts are filled in here.
+    using ChunkBuilder = std::function<std::unique_ptr<MapChunk>(int chunkX, int chunkY)>;
+    void Build(int width, int height, uint64_t contentHash, const ChunkBuilder& makeChunk, int threads = 0);
+    void SetStart(double x, double y) { _startX = x; _startY = y; }
+
+    void Resize(int width, int height);
+
+    int Width() const { return _width; }
+    int Height() const { return _height; }
+    int ChunksX() const { return _chunksX; }
+    int ChunksY() const { return _chunksY; }
+    bool InBounds(int x, int y) const { return x >= 0 && y >= 0 && x < _width && y < _height; }
+
+    // Material of a cell inside the map, 0 is floor
+    uint8_t At(int x, int y) const
+    {
+        const MapChunk* chunk = Chunk(x >> MAP_CHUNK_SHIFT, y >> MAP_CHUNK_SHIFT);
+        return chunk ? chunk->material[((y & (MAP_CHUNK_SIZE - 1)) << MAP_CHUNK_SHIFT) | (x & (MAP_CHUNK_SIZE - 1))] : 0;
+    }
+
+    bool IsSolid(int x, int y) const
+    {
+        if (!InBounds(x, y))
+            return true;
+        const MapChunk* chunk = Chunk(x >> MAP_CHUNK_SHIFT, y >> MAP_CHUNK_SHIFT);
+        return chunk && ((chunk->occupancy[y & (MAP_CHUNK_SIZE - 1)] >> (x & (MAP_CHUNK_SIZE - 1))) & 1);
+    }
+
+    uint8_t Metadata(int x, int y) const;
+
+    // A non-zero material makes the cell a wall. Changed cells are recorded in DirtyRects.
+    void Set(int x, int y, uint8_t material);
+    void SetMetadata(int x, int y, uint8_t value);
+
+    // Decoded chunk, null when the chunk is empty. Decodes on first touch,
+    // or while streamed gives the all-solid unloaded chunk until it is loaded.
+    const MapChunk* Chunk(int chunkX, int chunkY) const
+    {
+        size_t index = (size_t)chunkY * _chunksX + chunkX;
+        if (_state[index] != CHUNK_UNLOADED)
+            return _chunks[index].get();
+        return _streamed ? &UNLOADED_CHUNK : DecodeChunk(index);
+    }
+
+    // Streaming, only binary maps have chunks to leave out
+    bool HasFile() const { return _fileData != nullptr; }
+    void SetStreamed(bool streamed) { _streamed = streamed; }
+    bool IsStreamed() const { return _streamed; }
+    bool IsLoaded(int chunkX, int chunkY) const { return _state[(size_t)chunkY * _chunksX + chunkX] != CHUNK_UNLOADED; }
+
+    // Decode a chunk out of the file without keeping it, null when empty.
+    // Only reads the mapping, so any thread may call it until the map is reloaded.
+    std::unique_ptr<MapChunk> DecodeChunkData(int chunkX, int chunkY) const;
+
+    // Keep a decoded chunk, ignored when the chunk is already loaded
+    void InstallChunk(int chunkX, int chunkY, std::unique_ptr<MapChunk> chunk);
+
+    // Drop a loaded chunk, edited chunks are kept. Returns whether it was dropped.
+    bool EvictChunk(int chunkX, int chunkY);
+
+    // Potentially visible sets of a chunk's clusters in the MAP_LAYER_PVS
+    // layout, null when the map has none for it. They are read in place from
+    // the file until replaced, MapPvs builds and patches them.
+    bool HasPvs() const { return _hasPvs; }
+    const unsigned char* PvsData(int chunkX, int chunkY, size_t& bytes) const;
+    void SetPvsData(int chunkX, int chunkY, std::vector<unsigned char> data);
+
+    // Cells edited since the last ClearDirty, one rectangle per touched chunk.
+    // Loading or generating a map clears them, the whole map is new then.
+    const std::vector<MapDirtyRect>& DirtyRects() const { return _dirtyRects; }
+    void ClearDirty();
+
+    // Identifies the map contents, changes with every edit
+    uint64_t Hash() const;
+
+    double StartX() const { return _startX; }
+    double StartY() const { return _startY; }
+
+    int DecodedChunkCount() const { return _decodedCount; }     // loaded, empty ones included
+    size_t ResidentBytes() const { return _residentBytes; }
+
+private:
+    enum ChunkState : uint8_t { CHUNK_UNLOADED, CHUNK_LOADED, CHUNK_EDITED };
+    static const MapChunk UNLOADED_CHUNK;
+
+    MapChunk* MutableChunk(int chunkX, int chunkY);
+    const MapChunk* DecodeChunk(size_t index) const;
+    void CloseFile();
+    void ResetDirty();
+    void ResetPvs(bool hasPvs);
+    void MarkDirty(int x, int y);
+
+    int _width = 0;
+    int _height = 0;
+    int _chunksX = 0;
+    int _chunksY = 0;
+    double _startX = 1.5;
+    double _startY = 1.5;
+    uint64_t _contentHash = 0;
+    uint64_t _revision = 0;
+
+    // Decoded chunks, a null chunk that is loaded is empty
+    mutable std::vector<std::unique_ptr<MapChunk>> _chunks;
+    mutable std::vector<ChunkState> _state;
+    bool _streamed = false;
+
+    // Edits not yet picked up, with the rectangle of each chunk in _dirtyRects
+    std::vector<MapDirtyRect> _dirtyRects;
+    std::vector<int> _dirtyIndex;       // per chunk, -1 when clean
+    mutable int _decodedCount = 0;
+    mutable size_t _residentBytes = 0;
+
+    // Sets replaced since the file was mapped, the rest are in the file
+    bool _hasPvs = false;
+    std::vector<std::vector<unsigned char>> _pvs;
+    std::vector<uint8_t> _pvsReplaced;
+
+    // Backing binary map, chunks are decoded out of it
+    MappedFile _file;
+    AssetData _asset;
+    const unsigned char* _fileData = nullptr;
+    size_t _fileSize = 0;
+    const MapChunkEntry* _directory = nullptr;
+};
@@ -0,0 +1,312 @@
+#include "map_editor.h"
+#include "asset_pack.h"
+#include "imgui.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+namespace
+{
+    const float MIN_CELL_PIXELS = 4.0f;
+    const float MAX_CELL_PIXELS = 48.0f;
+
+    const ImU32 OUTSIDE_COLOR = IM_COL32(20, 20, 24, 255);
+    const ImU32 FLOOR_COLOR = IM_COL32(48, 48, 52, 255);
+    const ImU32 UNLOADED_COLOR = IM_COL32(0, 0, 0, 255);
+    const ImU32 GRID_COLOR = IM_COL32(255, 255, 255, 40);
+    const ImU32 HIDDEN_COLOR = IM_COL32(0, 0, 0, 150);
+
+    // Materials cycle through a few distinct wall colors
+    const ImU32 MATERIAL_COLORS[] = {
+        IM_COL32(220, 220, 220, 255), IM_COL32(200, 120, 80, 255), IM_COL32(90, 160, 210, 255),
+        IM_COL32(120, 190, 100, 255), IM_COL32(210, 190, 90, 255), IM_COL32(170, 110, 190, 255),
+    };
+    const int MATERIAL_COLOR_COUNT = sizeof(MATERIAL_COLORS) / sizeof(MATERIAL_COLORS[0]);
+
+    ImU32 CellColor(uint8_t value)
+    {
+        if (value == 0)
+            return FLOOR_COLOR;
+        if (value == MAP_CELL_UNLOADED)
+            return UNLOADED_COLOR;
+        return MATERIAL_COLORS[(value - 1) % MATERIAL_COLOR_COUNT];
+    }
+}
+
+bool MapEditor::BuildWindow(Map& map, const MapPvs& pvs, double playerX, double playerY, double playerAngle)
+{
+    if (!open)
+        return false;
+
+    PROFILE_FUNCTION();
+
+    ImGui::SetNextWindowSize(ImVec2(640, 720), ImGuiCond_FirstUseEver);
+    if (!ImGui::Begin("Map editor", &open))
+    {
+        ImGui::End();
+        return false;
+    }
+
+    // Brush and view
+    ImGui::SliderInt("Material", &brushMaterial, 0, MAX_MATERIAL, brushMaterial == 0 ? "floor" : "%d");
+    ImGui::SliderInt("Brush size", &brushSize, 1, 16);
+    ImGui::SliderFloat("Zoom", &cellPixels, MIN_CELL_PIXELS, MAX_CELL_PIXELS, "%.0f px per cell");
+    ImGui::Checkbox("Follow player", &followPlayer);
+    ImGui::SameLine();
+    if (ImGui::Button("Start at player"))
+        map.SetStart(playerX, playerY);
+    if (map.HasPvs())
+    {
+        ImGui::SameLine();
+        ImGui::Checkbox("PVS", &showPvs);
+    }
+
+    // Saving is left to the caller, the map file may be streamed from
+    bool save = false;
+    if (ImGui::InputText("File", _savePath, sizeof(_savePath)))
+        SetSavePath(_savePath);
+    ImGui::SameLine();
+    if (ImGui::Button("Save"))
+        save = true;
+    if (_saveShadowed)
+        ImGui::TextColored(ImVec4(1.0f, 0.6f, 0.2f, 1.0f), "The asset pack has this file, loading will not see the save");
+    if (_saveState == SAVE_OK)
+        ImGui::Text("Saved in %.0f ms", _saveMs);
+    else if (_saveState == SAVE_FAILED)
+        ImGui::Text("Save failed, see the log");
+
+    // The view takes the rest of the window
+    ImVec2 size = ImGui::GetContentRegionAvail();
+    size.x = std::max(size.x, 64.0f);
+    size.y = std::max(size.y, 64.0f);
+    ImVec2 topLeft = ImGui::GetCursorScreenPos();
+    ImGui::InvisibleButton("view", size,
+        ImGuiButtonFlags_MouseButtonLeft | ImGuiButtonFlags_MouseButtonRight | ImGuiButtonFlags_MouseButtonMiddle);
+    bool hovered = ImGui::IsItemHovered();
+    bool active = ImGui::IsItemActive();
+    ImGuiIO& io = ImGui::GetIO();
+    float centerX = topLeft.x + size.x * 0.5f;
+    float centerY = topLeft.y + size.y * 0.5f;
+
+    if (followPlayer)
+    {
+        _viewX = playerX;
+        _viewY = playerY;
+    }
+    if (active && ImGui::IsMouseDragging(ImGuiMouseButton_Middle, 0.0f))
+    {
+        followPlayer = false;
+        _viewX -= io.MouseDelta.x / cellPixels;
+        _viewY -= io.MouseDelta.y / cellPixels;
+    }
+
+    // Zooms around the cursor, or the player while following it
+    if (hovered && io.MouseWheel != 0.0f)
+    {
+        double anchorX = followPlayer ? _viewX : _viewX + (io.MousePos.x - centerX) / cellPixels;
+        double anchorY = followPlayer ? _viewY : _viewY + (io.MousePos.y - centerY) / cellPixels;
+        cellPixels = std::max(MIN_CELL_PIXELS, std::min(MAX_CELL_PIXELS, cellPixels * std::pow(1.2f, io.MouseWheel)));
+        if (!followPlayer)
+        {
+            _viewX = anchorX - (io.MousePos.x - centerX) / cellPixels;
+            _viewY = anchorY - (io.MousePos.y - centerY) / cellPixels;
+        }
+    }
+
+    // Painting happens before drawing, so the view already shows this frame's strokes
+    int mouseX = (int)std::floor(_viewX + (io.MousePos.x - centerX) / cellPixels);
+    int mouseY = (int)std::floor(_viewY + (io.MousePos.y - centerY) / cellPixels);
+    if (active && ImGui::IsMouseDown(ImGuiMouseButton_Left))
+    {
+        if (!_painting)
+        {
+            _lastX = mouseX;
+            _lastY = mouseY;
+            _painting = true;
+        }
+        PaintLine(map, _lastX, _lastY, mouseX, mouseY, (int)std::floor(playerX), (int)std::floor(playerY));
+        _lastX = mouseX;
+        _lastY = mouseY;
+    }
+    else
+        _painting = false;
+    if (hovered && ImGui::IsMouseClicked(ImGuiMouseButton_Right) && map.InBounds(mouseX, mouseY)
+        && map.At(mouseX, mouseY) != MAP_CELL_UNLOADED)
+        brushMaterial = map.At(mouseX, mouseY);
+
+    DrawCells(map, topLeft.x, topLeft.y, topLeft.x + size.x, topLeft.y + size.y);
+    if (showPvs && map.HasPvs())
+        DrawPvs(map, pvs, (int)std::floor(playerX), (int)std::floor(playerY), topLeft.x, topLeft.y, topLeft.x + size.x, topLeft.y + size.y);
+
+    // Player, start and brush on top
+    ImDrawList* drawList = ImGui::GetWindowDrawList();
+    drawList->PushClipRect(topLeft, ImVec2(topLeft.x + size.x, topLeft.y + size.y), true);
+    ImVec2 player((float)(centerX + (playerX - _viewX) * cellPixels), (float)(centerY + (playerY - _viewY) * cellPixels));
+    drawList->AddCircleFilled(player, std::max(3.0f, cellPixels * 0.3f), IM_COL32(255, 80, 80, 255));
+    drawList->AddLine(player, ImVec2(player.x + (float)std::cos(playerAngle) * cellPixels,
+        player.y + (float)std::sin(playerAngle) * cellPixels), IM_COL32(255, 80, 80, 255), 2.0f);
+    ImVec2 start((float)(centerX + (map.StartX() - _viewX) * cellPixels), (float)(centerY + (map.StartY() - _viewY) * cellPixels));
+    drawList->AddCircle(start, std::max(3.0f, cellPixels * 0.3f), IM_COL32(80, 255, 80, 255), 0, 2.0f);
+    if (hovered)
+    {
+        int brushX = mouseX - (brushSize - 1) / 2;
+        int brushY = mouseY - (brushSize - 1) / 2;
+        ImVec2 brushMin((float)(centerX + (brushX - _viewX) * cellPixels), (float)(centerY + (brushY - _viewY) * cellPixels));
+        ImVec2 brushMax(brushMin.x + brushSize * cellPixels, brushMin.y + brushSize * cellPixels);
+        drawList->AddRect(brushMin, brushMax, IM_COL32(255, 255, 0, 255));
+    }
+    drawList->PopClipRect();
+
+    if (hovered && map.InBounds(mouseX, mouseY))
+        ImGui::SetTooltip("(%d, %d) %d", mouseX, mouseY, map.At(mouseX, mouseY));
+
+    ImGui::End();
+    return save;
+}
+
+void MapEditor::SetSavePath(const char* path)
+{
+    if (path != _savePath)
+        snprintf(_savePath, sizeof(_savePath), "%s", path);
+    AssetData packed;
+    _saveShadowed = AssetPack::Find(_savePath, packed);
+}
+
+void MapEditor::SaveResult(bool saved, double milliseconds)
+{
+    _saveState = saved ? SAVE_OK : SAVE_FAILED;
+    _saveMs = milliseconds;
+}
+
+void MapEditor::PaintLine(Map& map, int x0, int y0, int x1, int y1, int playerX, int playerY)
+{
+    // Every cell between the last position and this one, a fast stroke leaves no gaps
+    int dx = std::abs(x1 - x0);
+    int dy = -std::abs(y1 - y0);
+    int stepX = x0 < x1 ? 1 : -1;
+    int stepY = y0 < y1 ? 1 : -1;
+    int error = dx + dy;
+    while (true)
+    {
+        PaintBrush(map, x0, y0, playerX, playerY);
+        if (x0 == x1 && y0 == y1)
+            break;
+        int twice = error * 2;
+        if (twice >= dy)
+        {
+            error += dy;
+            x0 += stepX;
+        }
+        if (twice <= dx)
+        {
+            error += dx;
+            y0 += stepY;
+        }
+    }
+}
+
+void MapEditor::PaintBrush(Map& map, int x, int y, int playerX, int playerY)
+{
+    // Cells already holding the material are skipped by Map::Set and stay clean
+    int material = std::max(0, std::min(brushMaterial, (int)MAX_MATERIAL));
+    int left = x - (brushSize - 1) / 2;
+    int top = y - (brushSize - 1) / 2;
+    for (int cellY = std::max(0, top); cellY < std::min(map.Height(), top + brushSize); cellY++)
+    {
+        for (int cellX = std::max(0, left); cellX < std::min(map.Width(), left + brushSize); cellX++)
+        {
+            // Never wall the player in
+            if (material != 0 && cellX == playerX && cellY == playerY)
+                continue;
+            map.Set(cellX, cellY, (uint8_t)material);
+        }
+    }
+}
+
+void MapEditor::DrawCells(const Map& map, float left, float top, float right, float bottom) const
+{
+    PROFILE_FUNCTION();
+
+    ImDrawList* drawList = ImGui::GetWindowDrawList();
+    drawList->PushClipRect(ImVec2(left, top), ImVec2(right, bottom), true);
+    drawList->AddRectFilled(ImVec2(left, top), ImVec2(right, bottom), OUTSIDE_COLOR);
+
+    // Cells on screen, clipped to the map
+    float centerX = (left + right) * 0.5f;
+    float centerY = (top + bottom) * 0.5f;
+    int x0 = std::max(0, (int)std::floor(_viewX - (centerX - left) / cellPixels));
+    int y0 = std::max(0, (int)std::floor(_viewY - (centerY - top) / cellPixels));
+    int x1 = std::min(map.Width() - 1, (int)std::floor(_viewX + (right - centerX) / cellPixels));
+    int y1 = std::min(map.Height() - 1, (int)std::floor(_viewY + (bottom - centerY) / cellPixels));
+    auto screenX = [&](int x) { return (float)(centerX + (x - _viewX) * cellPixels); };
+    auto screenY = [&](int y) { return (float)(centerY + (y - _viewY) * cellPixels); };
+    if (x0 > x1 || y0 > y1)
+    {
+        drawList->PopClipRect();
+        return;
+    }
+
+    // One rectangle per run of equal cells
+    for (int y = y0; y <= y1; y++)
+    {
+        int runStart = x0;
+        uint8_t runValue = map.At(x0, y);
+        for (int x = x0 + 1; x <= x1 + 1; x++)
+        {
+            uint8_t value = x <= x1 ? map.At(x, y) : 0;
+            if (x <= x1 && value == runValue)
+                continue;
+            drawList->AddRectFilled(ImVec2(screenX(runStart), screenY(y)), ImVec2(screenX(x), screenY(y + 1)), CellColor(runValue));
+            runStart = x;
+            runValue = value;
+        }
+    }
+
+    // Chunk edges, where the GPU pages and the region labels split
+    for (int x = (x0 + MAP_CHUNK_SIZE - 1) & ~(MAP_CHUNK_SIZE - 1); x <= x1; x += MAP_CHUNK_SIZE)
+        drawList->AddLine(ImVec2(screenX(x), screenY(y0)), ImVec2(screenX(x), screenY(y1 + 1)), GRID_COLOR);
+    for (int y = (y0 + MAP_CHUNK_SIZE - 1) & ~(MAP_CHUNK_SIZE - 1); y <= y1; y += MAP_CHUNK_SIZE)
+        drawList->AddLine(ImVec2(screenX(x0), screenY(y)), ImVec2(screenX(x1 + 1), screenY(y)), GRID_COLOR);
+    drawList->PopClipRect();
+}
+
+void MapEditor::DrawPvs(const Map& map, const MapPvs& pvs, int playerX, int playerY, float left, float top, float right, float bottom) const
+{
+    PROFILE_FUNCTION();
+
+    ImDrawList* drawList = ImGui::GetWindowDrawList();
+    drawList->PushClipRect(ImVec2(left, top), ImVec2(right, bottom), true);
+
+    // Clusters on screen, clipped to the map
+    float centerX = (left + right) * 0.5f;
+    float centerY = (top + bottom) * 0.5f;
+    int x0 = std::max(0, (int)std::floor(_viewX - (centerX - left) / cellPixels)) >> MAP_PVS_CLUSTER_SHIFT;
+    int y0 = std::max(0, (int)std::floor(_viewY - (centerY - top) / cellPixels)) >> MAP_PVS_CLUSTER_SHIFT;
+    int x1 = std::min(map.Width() - 1, (int)std::floor(_viewX + (right - centerX) / cellPixels)) >> MAP_PVS_CLUSTER_SHIFT;
+    int y1 = std::min(map.Height() - 1, (int)std::floor(_viewY + (bottom - centerY) / cellPixels)) >> MAP_PVS_CLUSTER_SHIFT;
+    auto screenX = [&](int x) { return (float)(centerX + (x - _viewX) * cellPixels); };
+    auto screenY = [&](int y) { return (float)(centerY + (y - _viewY) * cellPixels); };
+
+    // One rectangle per run of hidden clusters, clipped to the map's last cells
+    for (int y = y0; y <= y1; y++)
+    {
+        int cellY = y << MAP_PVS_CLUSTER_SHIFT;
+        int bottomY = std::min(map.Height(), cellY + MAP_PVS_CLUSTER_SIZE);
+        int runStart = -1;
+        for (int x = x0; x <= x1 + 1; x++)
+        {
+            bool hidden = x <= x1 && !pvs.Visible(map, playerX, playerY, x << MAP_PVS_CLUSTER_SHIFT, cellY);
+            if (hidden && runStart < 0)
+                runStart = x;
+            if (hidden || runStart < 0)
+                continue;
+            int rightX = std::min(map.Width(), x << MAP_PVS_CLUSTER_SHIFT);
+            drawList->AddRectFilled(ImVec2(screenX(runStart << MAP_PVS_CLUSTER_SHIFT), screenY(cellY)), ImVec2(screenX(rightX), screenY(bottomY)), HIDDEN_COLOR);
+            runStart = -1;
+        }
+    }
+    drawList->PopClipRect();
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "map.h"
+#include "map_pvs.h"
+
+// Top-down map editor in an ImGui window.
+//
+// The view is drawn straight from the map cells on screen, one rectangle per
+// run of equal cells in a row, so its cost follows the window and not the
+// map. Painting goes through Map::Set like any other edit: the map collects
+// the changed cells in its dirty rectangles and the game brings the GPU
+// pages, the minimap, the region graph and the PVS along for just those, in
+// the same frame. Saving writes the binary map format, PVS included, to a
+// loose file the game loads instead of the packed level.
+//
+// Left drag paints the brush, right click picks the material under the
+// cursor, middle drag pans and the wheel zooms. The PVS overlay darkens the
+// clusters the player's cell cannot see, patches showing up as they land.
+
+class MapEditor
+{
+public:
+    static const int MAX_MATERIAL = MAP_CELL_UNLOADED - 1;
+
+    bool open = false;
+    int brushMaterial = 1;              // 0 paints floor
+    int brushSize = 1;                  // cells on a side
+    float cellPixels = 12.0f;           // zoom
+    bool followPlayer = true;           // keep the view on the player
+    bool showPvs = false;               // darken what the player's cell cannot see
+
+    // Window for the current ImGui frame. Returns true when Save was pressed,
+    // the caller saves the map to SavePath and reports back with SaveResult.
+    bool BuildWindow(Map& map, const MapPvs& pvs, double playerX, double playerY, double playerAngle);
+
+    // Where Save writes to. Maps in the asset pack load from the pack, a
+    // path it also has would never be read back, so the editor warns about it.
+    void SetSavePath(const char* path);
+    const char* SavePath() const { return _savePath; }
+    void SaveResult(bool saved, double milliseconds);
+
+private:
+    void PaintLine(Map& map, int x0, int y0, int x1, int y1, int playerX, int playerY);
+    void PaintBrush(Map& map, int x, int y, int playerX, int playerY);
+    void DrawCells(const Map& map, float left, float top, float right, float bottom) const;
+    void DrawPvs(const Map& map, const MapPvs& pvs, int playerX, int playerY, float left, float top, float right, float bottom) const;
+
+    char _savePath[260] = "";
+    bool _saveShadowed = false;         // the pack has a file at _savePath
+    double _viewX = 0.0;                // map position at the middle of the view
+    double _viewY = 0.0;
+    bool _painting = false;
+    int _lastX = 0;                     // cell painted last in the current stroke
+    int _lastY = 0;
+
+    enum SaveState { SAVE_NONE, SAVE_OK, SAVE_FAILED };
+    SaveState _saveState = SAVE_NONE;
+    double _saveMs = 0.0;
+};
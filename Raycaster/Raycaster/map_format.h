@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+
+// Binary map written by Map::SaveBinary and "AssetTool map", read by Map::LoadBinary.
+//
+// Layout: MapHeader, then chunksX * chunksY * layerCount MapChunkEntry records
+// at directoryOffset (chunk index cy * chunksX + cx, then layer), then the
+// chunk data they point to. A chunk covers MAP_CHUNK_SIZE x MAP_CHUNK_SIZE
+// cells, row by row; edge chunks are stored whole with the cells past the map
+// set to zero. Every layer of every chunk is stored on its own, so a chunk
+// can be decoded without touching any other part of the file.
+//
+// The PVS layer is not per cell: it holds the potentially visible sets of the
+// chunk's clusters (see below), always uncompressed so it is read in place
+// from the mapping, and with no data when the map was saved without them.
+
+const char MAP_MAGIC[4] = { 'R', 'M', 'A', 'P' };
+const uint32_t MAP_VERSION = 2;
+const int MAP_CHUNK_SHIFT = 6;
+const int MAP_CHUNK_SIZE = 1 << MAP_CHUNK_SHIFT;
+const int MAP_CHUNK_CELLS = MAP_CHUNK_SIZE * MAP_CHUNK_SIZE;
+
+enum MapLayer : uint32_t
+{
+    MAP_LAYER_OCCUPANCY = 0,    // one bit per cell, bit x of the 64-bit word of row y
+    MAP_LAYER_MATERIAL = 1,     // one byte per cell, the wall texture, 0 on floor
+    MAP_LAYER_METADATA = 2,     // one byte per cell of game flags
+    MAP_LAYER_PVS = 3,          // visible clusters of each cluster of the chunk
+    MAP_LAYER_COUNT = 4,
+    MAP_CELL_LAYER_COUNT = 3    // the layers decoded into cells, PVS comes after them
+};
+
+enum MapFlags : uint32_t
+{
+    MAP_FLAG_PVS = 1            // the PVS layer was built
+};
+
+enum MapCompression : uint8_t
+{
+    MAP_COMPRESSION_NONE = 0,
+    MAP_COMPRESSION_RLE = 1,        // (run length - 1, value) byte pairs
+    MAP_COMPRESSION_UNIFORM = 2     // every byte is uniformValue, no data
+};
+
+// Potentially visible sets. Clusters are MAP_PVS_CLUSTER_SIZE cells on a side.
+// The set of a cluster is a MAP_PVS_WINDOW x MAP_PVS_WINDOW bitset centered
+// on it: bit x of row y is the cluster (x - MAP_PVS_RANGE, y - MAP_PVS_RANGE)
+// away, and clusters farther than MAP_PVS_RANGE on either axis are never in
+// it. Only rows with a bit set are stored. The layer of a chunk is a
+// MapPvsCluster for each of its clusters, row by row, then the stored rows as
+// 32-bit words: row y is there when bit y of rowMask is set, at firstRow plus
+// the number of lower rowMask bits set.
+const int MAP_PVS_CLUSTER_SHIFT = 3;
+const int MAP_PVS_CLUSTER_SIZE = 1 << MAP_PVS_CLUSTER_SHIFT;
+const int MAP_PVS_CHUNK_CLUSTERS = MAP_CHUNK_SIZE / MAP_PVS_CLUSTER_SIZE;   // on a side
+const int MAP_PVS_RANGE = 15;
+const int MAP_PVS_WINDOW = MAP_PVS_RANGE * 2 + 1;
+
+#pragma pack(push, 1)
+
+struct MapHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t chunkSize;
+    uint32_t chunksX;
+    uint32_t chunksY;
+    uint32_t layerCount;
+    float startX;
+    float startY;
+    uint64_t contentHash;       // FNV-1a of the decoded layers, identifies the map
+    uint64_t directoryOffset;
+    uint32_t flags;             // MapFlags
+};
+
+struct MapChunkEntry
+{
+    uint64_t offset;
+    uint32_t size;              // stored bytes
+    uint32_t rawSize;           // decoded bytes
+    uint8_t compression;
+    uint8_t uniformValue;
+    uint16_t reserved;
+};
+
+struct MapPvsCluster
+{
+    uint32_t rowMask;
+    uint32_t firstRow;          // words after the last MapPvsCluster of the chunk
+};
+
+#pragma pack(pop)
+
+// Decoded size of a cell layer
+inline uint32_t MapLayerBytes(uint32_t layer)
+{
+    return layer == MAP_LAYER_OCCUPANCY ? MAP_CHUNK_CELLS / 8 : MAP_CHUNK_CELLS;
+}
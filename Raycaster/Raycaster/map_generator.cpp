@@ -0,0 +1,319 @@
+#include "map_generator.h"
+#include "asset_pack.h"
+#include "content_hash.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include <stb_image.h>
+
+#define STB_HBWANG_STATIC
+#define STB_HERRINGBONE_WANG_TILE_IMPLEMENTATION
+#include <stb_herringbone_wang_tile.h>
+
+#define STB_PERLIN_IMPLEMENTATION
+#include <stb_perlin.h>
+
+namespace
+{
+    // Corner types of a tile's a..f corners, see the diagram in stb_herringbone_wang_tile.h.
+    // With corner (x, y) of type (x - y + 1) & 3 these follow from where the pattern puts each tile.
+    const int H_CORNER_TYPES[6] = { 1, 2, 3, 0, 1, 2 };
+    const int V_CORNER_TYPES[6] = { 0, 3, 2, 1, 0, 3 };
+
+    // Noise is sampled every NOISE_STEP cells of a chunk and interpolated in between
+    const int NOISE_STEP = 8;
+    const int NOISE_SAMPLES = MAP_CHUNK_SIZE / NOISE_STEP + 1;
+
+    uint32_t HashCell(uint32_t seed, int x, int y, uint32_t salt)
+    {
+        uint32_t h = seed * 0x9E3779B1u ^ (uint32_t)x * 0x85EBCA77u ^ (uint32_t)y * 0xC2B2AE3Du ^ salt * 0x27D4EB2Fu;
+        h ^= h >> 16;
+        h *= 0x7FEB352Du;
+        h ^= h >> 15;
+        h *= 0x846CA68Bu;
+        h ^= h >> 16;
+        return h;
+    }
+
+    // Templates draw walls white and floor in any color
+    bool IsWallPixel(const unsigned char* rgb)
+    {
+        return rgb[0] >= 200 && rgb[1] >= 200 && rgb[2] >= 200;
+    }
+
+    float Lerp(float a, float b, float t)
+    {
+        return a + (b - a) * t;
+    }
+}
+
+bool MapGenerator::LoadTemplate(const std::string& path)
+{
+    AssetData asset;
+    if (!ReadAsset(path, asset))
+    {
+        std::cerr << "Failed to open map template: " << path << std::endl;
+        return false;
+    }
+
+    int width, height;
+    unsigned char* pixels = stbi_load_from_memory(asset.data, (int)asset.size, &width, &height, nullptr, 3);
+    if (!pixels)
+    {
+        std::cerr << "Failed to decode map template: " << path << std::endl;
+        return false;
+    }
+    bool loaded = LoadTemplate(pixels, width, height);
+    stbi_image_free(pixels);
+    if (!loaded)
+        std::cerr << "Invalid map template: " << path << std::endl;
+    return loaded;
+}
+
+bool MapGenerator::LoadTemplate(const unsigned char* pixels, int width, int height)
+{
+    PROFILE_FUNCTION();
+
+    _side = 0;
+
+    // stbhw reads the tile layout out of marker pixels, it wants a writable copy
+    std::vector<unsigned char> image(pixels, pixels + (size_t)width * height * 3);
+    stbhw_tileset tileset;
+    if (!stbhw_build_tileset_from_image(&tileset, image.data(), width * 3, width, height))
+    {
+        std::cerr << "Wang tile template: " << stbhw_get_last_error() << std::endl;
+        return false;
+    }
+
+    // Edge colored templates constrain tiles by their neighbors, only corners can be hashed independently
+    if (!tileset.is_corner || tileset.num_h_tiles == 0 || tileset.num_v_tiles == 0)
+    {
+        std::cerr << "Wang tile template needs corner colors" << std::endl;
+        stbhw_free_tileset(&tileset);
+        return false;
+    }
+
+    int side = tileset.short_side_len;
+    int tileCells = 2 * side * side;
+    std::vector<int> hCorners, vCorners;
+    _hCells.assign((size_t)tileset.num_h_tiles * tileCells, 0);
+    _vCells.assign((size_t)tileset.num_v_tiles * tileCells, 0);
+    for (int pass = 0; pass < 2; pass++)
+    {
+        stbhw_tile** tiles = pass == 0 ? tileset.h_tiles : tileset.v_tiles;
+        int count = pass == 0 ? tileset.num_h_tiles : tileset.num_v_tiles;
+        std::vector<uint8_t>& cells = pass == 0 ? _hCells : _vCells;
+        std::vector<int>& corners = pass == 0 ? hCorners : vCorners;
+        for (int t = 0; t < count; t++)
+        {
+            const stbhw_tile* tile = tiles[t];
+            int constraints[6] = { tile->a, tile->b, tile->c, tile->d, tile->e, tile->f };
+            corners.insert(corners.end(), constraints, constraints + 6);
+            for (int i = 0; i < tileCells; i++)
+                cells[(size_t)t * tileCells + i] = IsWallPixel(tile->pixels + i * 3) ? 1 : 0;
+        }
+    }
+    for (int type = 0; type < 4; type++)
+        _colors[type] = std::max(1, std::min(4, tileset.num_color[type]));
+    stbhw_free_tileset(&tileset);
+
+    _side = side;
+    BuildCandidates(hCorners, H_CORNER_TYPES, (int)hCorners.size() / 6, _hKeys, _hTiles);
+    BuildCandidates(vCorners, V_CORNER_TYPES, (int)vCorners.size() / 6, _vKeys, _vTiles);
+    _templateHash = HashContent(_hCells.data(), _hCells.size(), HashContent(_vCells.data(), _vCells.size(),
+        HashContent(&side, sizeof(side))));
+    return true;
+}
+
+void MapGenerator::BuildCandidates(const std::vector<int>& corners, const int types[6], int tileCount,
+    std::vector<Candidates>& keys, std::vector<uint32_t>& tiles)
+{
+    // Every combination of corner colors gets the tiles that fit it. A template
+    // missing a combination falls back to the tiles that fit the most corners,
+    // where stbhw would give up.
+    keys.assign(KEY_COUNT, Candidates());
+    tiles.clear();
+    for (int key = 0; key < KEY_COUNT; key++)
+    {
+        int colors[6];
+        bool valid = true;
+        for (int corner = 0; corner < 6; corner++)
+        {
+            colors[corner] = (key >> (corner * 2)) & 3;
+            valid = valid && colors[corner] < _colors[types[corner]];
+        }
+        if (!valid)
+            continue;
+
+        int bestScore = -1;
+        keys[key].first = (uint32_t)tiles.size();
+        for (int t = 0; t < tileCount; t++)
+        {
+            int score = 0;
+            for (int corner = 0; corner < 6; corner++)
+                score += corners[t * 6 + corner] == colors[corner];
+            if (score < bestScore)
+                continue;
+            if (score > bestScore)
+            {
+                tiles.resize(keys[key].first);
+                bestScore = score;
+            }
+            tiles.push_back((uint32_t)t);
+        }
+        keys[key].count = (uint32_t)tiles.size() - keys[key].first;
+    }
+}
+
+int MapGenerator::CornerColor(uint32_t seed, int x, int y) const
+{
+    return (int)(HashCell(seed, x, y, 0) % (uint32_t)_colors[(x - y + 1) & 3]);
+}
+
+const uint8_t* MapGenerator::HorizontalTile(uint32_t seed, int x, int y) const
+{
+    // Two tiles wide, corners along its top and bottom edges
+    int key = 0;
+    for (int i = 0; i < 3; i++)
+        key |= CornerColor(seed, x + i, y) << (i * 2) | CornerColor(seed, x + i, y + 1) << (i * 2 + 6);
+    const Candidates& candidates = _hKeys[key];
+    uint32_t tile = _hTiles[candidates.first + HashCell(seed, x, y, 1) % candidates.count];
+    return &_hCells[(size_t)tile * 2 * _side * _side];
+}
+
+const uint8_t* MapGenerator::VerticalTile(uint32_t seed, int x, int y) const
+{
+    // Two tiles tall, corners down its left and right edges
+    int key = 0;
+    for (int i = 0; i < 3; i++)
+        key |= CornerColor(seed, x, y + i) << (i * 2) | CornerColor(seed, x + 1, y + i) << (i * 2 + 6);
+    const Candidates& candidates = _vKeys[key];
+    uint32_t tile = _vTiles[candidates.first + HashCell(seed, x, y, 2) % candidates.count];
+    return &_vCells[(size_t)tile * 2 * _side * _side];
+}
+
+std::unique_ptr<MapChunk> MapGenerator::GenerateChunk(int chunkX, int chunkY, int width, int height, uint32_t seed) const
+{
+    int x0 = chunkX << MAP_CHUNK_SHIFT;
+    int y0 = chunkY << MAP_CHUNK_SHIFT;
+    int x1 = std::min(width, x0 + MAP_CHUNK_SIZE);
+    int y1 = std::min(height, y0 + MAP_CHUNK_SIZE);
+    if (!HasTemplate() || x0 >= x1 || y0 >= y1)
+        return nullptr;
+
+    // Coarse noise, the seed picks the slice through the 3D noise
+    float noiseZ = (HashCell(seed, 0, 0, 3) & 0xFFFF) / 256.0f;
+    int noiseSeed = (int)(HashCell(seed, 0, 0, 4) & 0xFF);
+    float cave[NOISE_SAMPLES][NOISE_SAMPLES];
+    float material[NOISE_SAMPLES][NOISE_SAMPLES];
+    for (int sy = 0; sy < NOISE_SAMPLES; sy++)
+    {
+        for (int sx = 0; sx < NOISE_SAMPLES; sx++)
+        {
+            float x = (float)(x0 + sx * NOISE_STEP);
+            float y = (float)(y0 + sy * NOISE_STEP);
+            float value = 0.0f, amplitude = 1.0f, frequency = caveScale;
+            for (int octave = 0; octave < 3; octave++)
+            {
+                value += amplitude * stb_perlin_noise3_seed(x * frequency, y * frequency, noiseZ, 0, 0, 0, noiseSeed + octave);
+                amplitude *= 0.5f;
+                frequency *= 2.0f;
+            }
+            cave[sy][sx] = value;
+            material[sy][sx] = stb_perlin_noise3_seed(x * materialScale, y * materialScale, noiseZ, 0, 0, 0, noiseSeed + 3);
+        }
+    }
+
+    // The chunk is covered block by block, a block being one half of a tile.
+    // Along a row of blocks the herringbone repeats every 4: the left and right
+    // half of a horizontal tile, the bottom half of the vertical tile that
+    // started a row up, and the top half of a new vertical one.
+    std::unique_ptr<MapChunk> chunk(new MapChunk());
+    int side = _side;
+    for (int blockY = y0 / side; blockY <= (y1 - 1) / side; blockY++)
+    {
+        for (int blockX = x0 / side; blockX <= (x1 - 1) / side; blockX++)
+        {
+            const uint8_t* tile;
+            int stride;
+            switch ((blockX - blockY) & 3)
+            {
+            case 0:  tile = HorizontalTile(seed, blockX, blockY); stride = 2 * side; break;
+            case 1:  tile = HorizontalTile(seed, blockX - 1, blockY) + side; stride = 2 * side; break;
+            case 2:  tile = VerticalTile(seed, blockX, blockY - 1) + side * side; stride = side; break;
+            default: tile = VerticalTile(seed, blockX, blockY); stride = side; break;
+            }
+
+            int cellX0 = std::max(x0, blockX * side), cellX1 = std::min(x1, (blockX + 1) * side);
+            int cellY0 = std::max(y0, blockY * side), cellY1 = std::min(y1, (blockY + 1) * side);
+            for (int y = cellY0; y < cellY1; y++)
+            {
+                const uint8_t* row = tile + (y - blockY * side) * stride;
+                int localY = y - y0;
+                int sampleY = localY / NOISE_STEP;
+                float fy = (localY % NOISE_STEP) / (float)NOISE_STEP;
+                for (int x = cellX0; x < cellX1; x++)
+                {
+                    int localX = x - x0;
+                    bool border = x == 0 || y == 0 || x == width - 1 || y == height - 1;
+                    if (!row[x - blockX * side] && !border)
+                        continue;
+
+                    int sampleX = localX / NOISE_STEP;
+                    float fx = (localX % NOISE_STEP) / (float)NOISE_STEP;
+                    float open = Lerp(Lerp(cave[sampleY][sampleX], cave[sampleY][sampleX + 1], fx),
+                        Lerp(cave[sampleY + 1][sampleX], cave[sampleY + 1][sampleX + 1], fx), fy);
+                    if (open > caveThreshold && !border)
+                        continue;
+
+                    float band = Lerp(Lerp(material[sampleY][sampleX], material[sampleY][sampleX + 1], fx),
+                        Lerp(material[sampleY + 1][sampleX], material[sampleY + 1][sampleX + 1], fx), fy);
+                    int value = 1 + std::max(0, std::min(materialCount - 1, (int)((band + 1.0f) * 0.5f * materialCount)));
+                    chunk->material[(localY << MAP_CHUNK_SHIFT) | localX] = (uint8_t)value;
+                    chunk->occupancy[localY] |= 1ull << localX;
+                }
+            }
+        }
+    }
+    return chunk;
+}
+
+void MapGenerator::Generate(Map& map, int width, int height, uint32_t seed, int threads) const
+{
+    PROFILE_FUNCTION();
+
+    if (!HasTemplate())
+    {
+        map.Generate(width, height, seed);
+        return;
+    }
+
+    float tunables[3] = { caveScale, caveThreshold, materialScale };
+    uint64_t contentHash = HashContent(tunables, sizeof(tunables), HashContent(&materialCount, sizeof(materialCount), _templateHash));
+    contentHash = HashContent(&seed, sizeof(seed), HashContent(&width, sizeof(width), HashContent(&height, sizeof(height), contentHash)));
+    map.Build(width, height, contentHash, [=](int chunkX, int chunkY) {
+        return GenerateChunk(chunkX, chunkY, width, height, seed);
+    }, threads);
+
+    // Start on the floor nearest the middle, ring by ring
+    int centerX = width / 2, centerY = height / 2;
+    for (int radius = 0; radius < std::max(width, height); radius++)
+    {
+        for (int y = centerY - radius; y <= centerY + radius; y++)
+        {
+            int step = y == centerY - radius || y == centerY + radius ? 1 : 2 * radius;
+            for (int x = centerX - radius; x <= centerX + radius; x += std::max(1, step))
+            {
+                if (!map.IsSolid(x, y))
+                {
+                    map.SetStart(x + 0.5, y + 0.5);
+                    return;
+                }
+            }
+        }
+    }
+    map.SetStart(centerX + 0.5, centerY + 0.5);
+}
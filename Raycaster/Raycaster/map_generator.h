@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "map.h"
+
+// Procedural levels of any size out of herringbone Wang tiles.
+//
+// The tiles come from a corner colored template made with
+// stb_herringbone_wang_tile.h, white pixels are wall and the rest is floor.
+// stbhw's own generator draws corner colors and tiles with rand() into one
+// global grid, so here every corner color and every tile choice is instead a
+// hash of the seed and its place in the herringbone pattern. That makes each
+// chunk a function of the seed and its coordinates alone: chunks are made in
+// parallel on every core and in any order, and still meet seamlessly.
+//
+// Perlin noise on top opens caves, which only removes walls and never cuts a
+// path the tiles made, and picks wall materials in broad bands. It is sampled
+// on a coarse grid per chunk and interpolated, the cells only read tiles.
+
+class MapGenerator
+{
+public:
+    float caveScale = 0.015f;           // noise frequency, per cell
+    float caveThreshold = 0.35f;        // noise above this is open cave
+    float materialScale = 0.008f;
+    int materialCount = 4;              // wall materials 1..materialCount
+
+    // Template image through the asset pack, RGB, made by stbhw_make_template
+    bool LoadTemplate(const std::string& path);
+    bool LoadTemplate(const unsigned char* pixels, int width, int height);
+    bool HasTemplate() const { return _side > 0; }
+
+    // Replaces the map, 0 threads uses every core. The start is the floor
+    // cell nearest the middle.
+    void Generate(Map& map, int width, int height, uint32_t seed, int threads = 0) const;
+
+    // Cells of one chunk, null when it has no walls. Any thread.
+    std::unique_ptr<MapChunk> GenerateChunk(int chunkX, int chunkY, int width, int height, uint32_t seed) const;
+
+private:
+    // Tiles matching the six corners of a tile, 2 bits each in stbhw's a..f order
+    struct Candidates
+    {
+        uint32_t first = 0;
+        uint32_t count = 0;
+    };
+    static const int KEY_COUNT = 1 << 12;
+
+    int CornerColor(uint32_t seed, int x, int y) const;
+    const uint8_t* HorizontalTile(uint32_t seed, int x, int y) const;
+    const uint8_t* VerticalTile(uint32_t seed, int x, int y) const;
+    void BuildCandidates(const std::vector<int>& corners, const int types[6], int tileCount,
+        std::vector<Candidates>& keys, std::vector<uint32_t>& tiles);
+
+    int _side = 0;                      // short side of a tile in cells
+    int _colors[4] = {};                // colors of each corner type
+    uint64_t _templateHash = 0;
+
+    // One byte per cell, non-zero for wall, row by row, h tiles 2 sides wide and v tiles 2 tall
+    std::vector<uint8_t> _hCells;
+    std::vector<uint8_t> _vCells;
+    std::vector<Candidates> _hKeys;
+    std::vector<Candidates> _vKeys;
+    std::vector<uint32_t> _hTiles;
+    std::vector<uint32_t> _vTiles;
+};
@@ -0,0 +1,267 @@
+#include "map_pages.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+namespace
+{
+    // Chunks without walls need no slot, the ray skips them
+    bool HasWalls(const MapChunk* chunk)
+    {
+        return chunk && chunk->solidCount > 0;
+    }
+}
+
+bool MapPages::Init(int poolSlotsX, int poolSlotsY)
+{
+    GLint maxTextureSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+    _slotsX = std::max(1, std::min(poolSlotsX, maxTextureSize / MAP_CHUNK_SIZE));
+    _slotsY = std::max(1, std::min(poolSlotsY, maxTextureSize / MAP_CHUNK_SIZE));
+
+    int slotCount = _slotsX * _slotsY;
+    _slotChunk.assign(slotCount, -1);
+    _freeSlots.clear();
+    for (int slot = slotCount - 1; slot >= 0; slot--)
+        _freeSlots.push_back(slot);
+
+    // Largest square of chunks the pool can hold whole
+    int side = (int)std::sqrt((double)slotCount);
+    _radius = std::max(0, (side - 1) / 2);
+
+    glGenTextures(1, &_poolTexture);
+    glBindTexture(GL_TEXTURE_2D, _poolTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, _slotsX * MAP_CHUNK_SIZE, _slotsY * MAP_CHUNK_SIZE, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+
+    glGenTextures(1, &_pageTexture);
+    glBindTexture(GL_TEXTURE_2D, _pageTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    std::cout << "Map page pool: " << slotCount << " chunks, " << PoolBytes() / 1024 << " KB, radius " << _radius << std::endl;
+    return true;
+}
+
+void MapPages::Shutdown()
+{
+    if (_poolTexture)
+        glDeleteTextures(1, &_poolTexture);
+    if (_pageTexture)
+        glDeleteTextures(1, &_pageTexture);
+    _poolTexture = 0;
+    _pageTexture = 0;
+}
+
+void MapPages::Reset(const Map& map, double x, double y)
+{
+    PROFILE_FUNCTION();
+
+    _chunksX = map.ChunksX();
+    _chunksY = map.ChunksY();
+    size_t chunkCount = (size_t)_chunksX * _chunksY;
+
+    GLint maxTextureSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+    if (_chunksX > maxTextureSize || _chunksY > maxTextureSize)
+        std::cerr << "Map " << _chunksX << "x" << _chunksY << " chunks exceeds GL_MAX_TEXTURE_SIZE " << maxTextureSize << std::endl;
+
+    // Everything starts off the GPU, empty chunks the CPU already knows about need no slot
+    _pages.assign(chunkCount, PAGE_UNLOADED);
+    _emptyPages = 0;
+    for (int chunkY = 0; chunkY < _chunksY; chunkY++)
+        for (int chunkX = 0; chunkX < _chunksX; chunkX++)
+            if (map.IsLoaded(chunkX, chunkY) && !HasWalls(map.Chunk(chunkX, chunkY)))
+                SetPage(chunkY * _chunksX + chunkX, PAGE_EMPTY);
+
+    std::fill(_slotChunk.begin(), _slotChunk.end(), -1);
+    _freeSlots.clear();
+    for (int slot = (int)_slotChunk.size() - 1; slot >= 0; slot--)
+        _freeSlots.push_back(slot);
+    _invalid.clear();
+    _isInvalid.assign(chunkCount, 0);
+    _centerX = _centerY = -1;
+
+    glBindTexture(GL_TEXTURE_2D, _pageTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R16UI, _chunksX, _chunksY, 0, GL_RED_INTEGER, GL_UNSIGNED_SHORT, nullptr);
+    _dirty = true;
+    _dirtyX0 = 0;
+    _dirtyY0 = 0;
+    _dirtyX1 = _chunksX - 1;
+    _dirtyY1 = _chunksY - 1;
+
+    Update(map, x, y);
+}
+
+void MapPages::Invalidate(int chunkX, int chunkY)
+{
+    int index = chunkY * _chunksX + chunkX;
+    if (_isInvalid[index])
+        return;
+    _isInvalid[index] = 1;
+    _invalid.push_back(index);
+}
+
+void MapPages::Update(const Map& map, double x, double y)
+{
+    if (_pages.empty())
+        return;
+
+    PROFILE_FUNCTION();
+    _changed.clear();
+
+    int centerX = std::max(0, std::min(_chunksX - 1, (int)std::floor(x) >> MAP_CHUNK_SHIFT));
+    int centerY = std::max(0, std::min(_chunksY - 1, (int)std::floor(y) >> MAP_CHUNK_SHIFT));
+    if (centerX != _centerX || centerY != _centerY)
+    {
+        _centerX = centerX;
+        _centerY = centerY;
+
+        // Free the slots left behind first, the window always fits in what is then free
+        for (size_t slot = 0; slot < _slotChunk.size(); slot++)
+        {
+            int index = _slotChunk[slot];
+            if (index < 0 || InWindow(index % _chunksX, index / _chunksX))
+                continue;
+            _slotChunk[slot] = -1;
+            _freeSlots.push_back((int)slot);
+            SetPage(index, PAGE_UNLOADED);
+            _changed.push_back(index);
+        }
+
+        for (int chunkY = std::max(0, centerY - _radius); chunkY <= std::min(_chunksY - 1, centerY + _radius); chunkY++)
+        {
+            for (int chunkX = std::max(0, centerX - _radius); chunkX <= std::min(_chunksX - 1, centerX + _radius); chunkX++)
+            {
+                int index = chunkY * _chunksX + chunkX;
+                if (_pages[index] == PAGE_UNLOADED && map.IsLoaded(chunkX, chunkY))
+                    Refresh(map, index);
+            }
+        }
+    }
+
+    for (int index : _invalid)
+    {
+        _isInvalid[index] = 0;
+        Refresh(map, index);
+    }
+    _invalid.clear();
+
+    // Edited cells, a chunk that keeps its slot only uploads the changed rectangle
+    for (const MapDirtyRect& rect : map.DirtyRects())
+    {
+        int index = (rect.y0 >> MAP_CHUNK_SHIFT) * _chunksX + (rect.x0 >> MAP_CHUNK_SHIFT);
+        uint16_t page = _pages[index];
+        if (page != PAGE_EMPTY && page != PAGE_UNLOADED && HasWalls(map.Chunk(rect.x0 >> MAP_CHUNK_SHIFT, rect.y0 >> MAP_CHUNK_SHIFT)))
+            UploadSlot(map, index, page - 1, rect);
+        else
+            Refresh(map, index);
+    }
+
+    if (_dirty)
+    {
+        glBindTexture(GL_TEXTURE_2D, _pageTexture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, _chunksX);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, _dirtyX0, _dirtyY0, _dirtyX1 - _dirtyX0 + 1, _dirtyY1 - _dirtyY0 + 1,
+            GL_RED_INTEGER, GL_UNSIGNED_SHORT, &_pages[(size_t)_dirtyY0 * _chunksX + _dirtyX0]);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        _dirty = false;
+    }
+    PROFILE_COUNTER("Map pool slots used", UsedSlotCount());
+}
+
+bool MapPages::InWindow(int chunkX, int chunkY) const
+{
+    return std::abs(chunkX - _centerX) <= _radius && std::abs(chunkY - _centerY) <= _radius;
+}
+
+void MapPages::Refresh(const Map& map, int index)
+{
+    int chunkX = index % _chunksX;
+    int chunkY = index / _chunksX;
+    bool loaded = map.IsLoaded(chunkX, chunkY);
+    const MapChunk* chunk = loaded ? map.Chunk(chunkX, chunkY) : nullptr;
+
+    uint16_t page = _pages[index];
+    int slot = page != PAGE_EMPTY && page != PAGE_UNLOADED ? page - 1 : -1;
+    bool wantsSlot = HasWalls(chunk) && InWindow(chunkX, chunkY);
+    if (slot >= 0 && !wantsSlot)
+    {
+        _slotChunk[slot] = -1;
+        _freeSlots.push_back(slot);
+        slot = -1;
+    }
+
+    if (!wantsSlot)
+        SetPage(index, loaded && !HasWalls(chunk) ? PAGE_EMPTY : PAGE_UNLOADED);
+    else
+    {
+        if (slot < 0)
+        {
+            if (_freeSlots.empty())
+            {
+                std::cerr << "Map page pool is full" << std::endl;
+                SetPage(index, PAGE_UNLOADED);
+                _changed.push_back(index);
+                return;
+            }
+            slot = _freeSlots.back();
+            _freeSlots.pop_back();
+            _slotChunk[slot] = index;
+        }
+        int x = chunkX * MAP_CHUNK_SIZE;
+        int y = chunkY * MAP_CHUNK_SIZE;
+        UploadSlot(map, index, slot, { x, y, x + MAP_CHUNK_SIZE - 1, y + MAP_CHUNK_SIZE - 1 });
+        SetPage(index, (uint16_t)(slot + 1));
+    }
+    _changed.push_back(index);
+}
+
+void MapPages::SetPage(int index, uint16_t page)
+{
+    uint16_t& current = _pages[index];
+    if (current == page)
+        return;
+    _emptyPages += (page == PAGE_EMPTY) - (current == PAGE_EMPTY);
+    current = page;
+
+    int x = index % _chunksX;
+    int y = index / _chunksX;
+    if (!_dirty)
+    {
+        _dirty = true;
+        _dirtyX0 = _dirtyX1 = x;
+        _dirtyY0 = _dirtyY1 = y;
+        return;
+    }
+    _dirtyX0 = std::min(_dirtyX0, x);
+    _dirtyY0 = std::min(_dirtyY0, y);
+    _dirtyX1 = std::max(_dirtyX1, x);
+    _dirtyY1 = std::max(_dirtyY1, y);
+}
+
+void MapPages::UploadSlot(const Map& map, int index, int slot, const MapDirtyRect& cells)
+{
+    // Chunks are stored whole, cells past the map edge are floor and never read
+    const MapChunk* chunk = map.Chunk(index % _chunksX, index / _chunksX);
+    int x0 = cells.x0 & (MAP_CHUNK_SIZE - 1);
+    int y0 = cells.y0 & (MAP_CHUNK_SIZE - 1);
+    glBindTexture(GL_TEXTURE_2D, _poolTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, MAP_CHUNK_SIZE);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, (slot % _slotsX) * MAP_CHUNK_SIZE + x0, (slot / _slotsX) * MAP_CHUNK_SIZE + y0,
+        cells.x1 - cells.x0 + 1, cells.y1 - cells.y0 + 1, GL_RED, GL_UNSIGNED_BYTE, &chunk->material[(y0 << MAP_CHUNK_SHIFT) | x0]);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
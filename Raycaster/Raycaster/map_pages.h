@@ -0,0 +1,86 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cstdint>
+#include <vector>
+#include "map.h"
+
+// Map cells on the GPU as a virtual texture.
+//
+// The page texture has one texel per map chunk and tells the shader where the
+// chunk is: PAGE_EMPTY for a chunk with no walls, which the ray skips whole,
+// PAGE_UNLOADED for one that is not on the GPU, which reads as solid
+// MAP_CELL_UNLOADED cells, and otherwise 1 + the chunk's slot in the pool
+// texture. The pool is a fixed grid of MAP_CHUNK_SIZE slots holding the
+// materials of non-empty chunks only, so VRAM follows the content near the
+// player and not the map area, and the page texture is the only thing that
+// grows with the map, by a texel per chunk.
+//
+// Chunks within Radius() of the player's chunk get slots when the CPU has
+// them loaded. The window is as large as the pool can always hold, so slots
+// are freed when the player moves away and never need to be stolen.
+//
+// Edits reach the GPU through the map's dirty rectangles: only the changed
+// cells of a slot are uploaded, and a page only changes when an edit empties
+// a chunk or puts the first wall into one.
+
+class MapPages
+{
+public:
+    static const uint16_t PAGE_EMPTY = 0;
+    static const uint16_t PAGE_UNLOADED = 0xFFFF;
+
+    // Creates the pool, needs the GL context
+    bool Init(int poolSlotsX = 64, int poolSlotsY = 32);
+    void Shutdown();
+
+    // Page table for a newly loaded map, then maps the chunks around the position
+    void Reset(const Map& map, double x, double y);
+
+    // A chunk was loaded, evicted or edited, picked up by the next Update
+    void Invalidate(int chunkX, int chunkY);
+
+    // Move the window with the player and upload what changed, edits in the
+    // map's dirty rectangles included. The caller clears them. GL thread only.
+    void Update(const Map& map, double x, double y);
+
+    GLuint PageTexture() const { return _pageTexture; }
+    GLuint PoolTexture() const { return _poolTexture; }
+    int PoolSlotsX() const { return _slotsX; }
+    int PoolSlotCount() const { return (int)_slotChunk.size(); }
+    int UsedSlotCount() const { return PoolSlotCount() - (int)_freeSlots.size(); }
+    int EmptyPageCount() const { return _emptyPages; }
+    int Radius() const { return _radius; }
+    size_t PoolBytes() const { return (size_t)_slotChunk.size() * MAP_CHUNK_CELLS; }
+
+    // Chunks whose pages changed in the last Update, y * chunksX + x
+    const std::vector<int>& ChangedChunks() const { return _changed; }
+
+private:
+    bool InWindow(int chunkX, int chunkY) const;
+    void Refresh(const Map& map, int index);
+    void SetPage(int index, uint16_t page);
+    void UploadSlot(const Map& map, int index, int slot, const MapDirtyRect& cells);
+
+    int _slotsX = 0;
+    int _slotsY = 0;
+    int _radius = 0;
+    GLuint _pageTexture = 0;
+    GLuint _poolTexture = 0;
+
+    int _chunksX = 0;
+    int _chunksY = 0;
+    int _centerX = -1;
+    int _centerY = -1;
+    std::vector<uint16_t> _pages;       // CPU copy of the page texture
+    std::vector<int> _slotChunk;        // chunk in each slot, -1 when free
+    std::vector<int> _freeSlots;
+    std::vector<int> _invalid;          // chunks to refresh on the next Update
+    std::vector<uint8_t> _isInvalid;
+    std::vector<int> _changed;
+    int _emptyPages = 0;
+
+    // Page texels that changed since the last upload, inclusive
+    bool _dirty = false;
+    int _dirtyX0 = 0, _dirtyY0 = 0, _dirtyX1 = 0, _dirtyY1 = 0;
+};
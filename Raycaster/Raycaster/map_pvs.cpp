@@ -0,0 +1,527 @@
+#include "map_pvs.h"
+#include "parallel_for.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace
+{
+    const int CLUSTER_SHIFT_IN_CHUNK = MAP_CHUNK_SHIFT - MAP_PVS_CLUSTER_SHIFT;
+    const int CHUNK_CLUSTERS = MAP_PVS_CHUNK_CLUSTERS * MAP_PVS_CHUNK_CLUSTERS;
+    const size_t HEADER_BYTES = CHUNK_CLUSTERS * sizeof(MapPvsCluster);
+    const uint32_t ROW_MASK = (1u << MAP_PVS_WINDOW) - 1;
+
+    // Sight lines from a chunk end within two chunks of it on every side. The
+    // grid has one 64-bit word per chunk column of a row.
+    const int GRID_MARGIN_CHUNKS = 2;
+    const int GRID_CHUNKS = GRID_MARGIN_CHUNKS * 2 + 1;
+    const int GRID_MARGIN = GRID_MARGIN_CHUNKS * MAP_CHUNK_SIZE;
+    const int GRID_SIZE = GRID_CHUNKS * MAP_CHUNK_SIZE;
+    const int GRID_CLUSTERS = GRID_SIZE / MAP_PVS_CLUSTER_SIZE;
+    const int CORNERS = MAP_CHUNK_SIZE + 1;
+
+    // Columns a shadowcast goes out, enough to reach the far side of the window from the near border
+    const int SIGHT_CELLS = (MAP_PVS_RANGE + 1) * MAP_PVS_CLUSTER_SIZE;
+
+    static_assert(SIGHT_CELLS <= GRID_MARGIN, "sight lines must stay inside the grid");
+    static_assert(GRID_CLUSTERS <= 64, "a row of grid clusters is one word");
+    static_assert(MAP_PVS_WINDOW <= 32, "a row of a set is one word");
+    static_assert(MAP_CHUNK_SIZE == 64, "a chunk row is one grid word");
+
+    int PopCount(uint32_t bits)
+    {
+        bits = bits - ((bits >> 1) & 0x55555555u);
+        bits = (bits & 0x33333333u) + ((bits >> 2) & 0x33333333u);
+        return (int)((((bits + (bits >> 4)) & 0x0F0F0F0Fu) * 0x01010101u) >> 24);
+    }
+
+    // Slopes of an octant, the lowest and highest still open, bounds included
+    struct Interval
+    {
+        double lo, hi;
+    };
+}
+
+struct MapPvs::Scratch
+{
+    uint64_t solid[GRID_SIZE][GRID_CHUNKS];                 // bit x of the word of its chunk column
+    uint64_t seen[GRID_CLUSTERS];                           // grid clusters seen from one point
+    uint32_t rows[CHUNK_CLUSTERS][MAP_PVS_WINDOW];          // sets of the chunk's clusters
+    uint8_t cast[CORNERS * CORNERS];                        // bit per axis, edges already cast from
+    int gridChunk = -1;                                     // chunk the grid is around, -1 when stale
+    std::vector<Interval> open;
+    std::vector<Interval> next;
+    std::vector<Interval> blocked;
+    std::vector<unsigned char> packed;
+
+    bool Solid(int x, int y) const
+    {
+        return (solid[y][x >> MAP_CHUNK_SHIFT] >> (x & (MAP_CHUNK_SIZE - 1))) & 1;
+    }
+};
+
+MapPvs::MapPvs() : _scratch(new Scratch()) {}
+MapPvs::~MapPvs() = default;
+
+void MapPvs::Build(Map& map, int threads)
+{
+    PROFILE_FUNCTION();
+
+    size_t chunkCount = (size_t)map.ChunksX() * map.ChunksY();
+    std::vector<std::unique_ptr<Scratch>> scratch(ParallelWorkerCount(chunkCount, threads));
+    for (std::unique_ptr<Scratch>& workerScratch : scratch)
+        workerScratch.reset(new Scratch());
+
+    // Every chunk on its own, only reading the map
+    std::vector<std::vector<unsigned char>> sets(chunkCount);
+    ParallelFor(chunkCount, threads, "PVS builder", [&](size_t index, int worker) {
+        int chunkX = (int)(index % map.ChunksX());
+        int chunkY = (int)(index / map.ChunksX());
+        Scratch& workerScratch = *scratch[worker];
+        Compute(map, chunkX, chunkY, ~0ull, workerScratch);
+        for (const uint32_t (&set)[MAP_PVS_WINDOW] : workerScratch.rows)
+        {
+            if (set[MAP_PVS_RANGE])
+            {
+                Pack(workerScratch, sets[index]);
+                break;
+            }
+        }
+    });
+
+    for (size_t index = 0; index < chunkCount; index++)
+        map.SetPvsData((int)(index % map.ChunksX()), (int)(index / map.ChunksX()), std::move(sets[index]));
+    Reset(map);
+}
+
+void MapPvs::Reset(const Map& map)
+{
+    _clustersX = map.ChunksX() * MAP_PVS_CHUNK_CLUSTERS;
+    size_t clusterCount = (size_t)_clustersX * map.ChunksY() * MAP_PVS_CHUNK_CLUSTERS;
+    _queued.assign((clusterCount + 63) / 64, 0);
+    _queue.clear();
+    _scratch->gridChunk = -1;
+}
+
+void MapPvs::Update(Map& map, const std::vector<MapDirtyRect>& dirty)
+{
+    if (!map.HasPvs() || dirty.empty())
+        return;
+
+    PROFILE_FUNCTION();
+
+    // A line through an edited cell reaches its cluster first, so only the
+    // clusters that saw that one can see anything new or lose anything
+    int clustersY = map.ChunksY() * MAP_PVS_CHUNK_CLUSTERS;
+    _opened.clear();
+    for (const MapDirtyRect& rect : dirty)
+    {
+        for (int clusterY = rect.y0 >> MAP_PVS_CLUSTER_SHIFT; clusterY <= rect.y1 >> MAP_PVS_CLUSTER_SHIFT; clusterY++)
+        {
+            for (int clusterX = rect.x0 >> MAP_PVS_CLUSTER_SHIFT; clusterX <= rect.x1 >> MAP_PVS_CLUSTER_SHIFT; clusterX++)
+            {
+                for (int y = std::max(0, clusterY - MAP_PVS_RANGE); y <= std::min(clustersY - 1, clusterY + MAP_PVS_RANGE); y++)
+                {
+                    for (int x = std::max(0, clusterX - MAP_PVS_RANGE); x <= std::min(_clustersX - 1, clusterX + MAP_PVS_RANGE); x++)
+                    {
+                        uint32_t cluster = (uint32_t)(y * _clustersX + x);
+                        if ((_queued[cluster >> 6] >> (cluster & 63)) & 1)
+                            continue;
+                        if ((x != clusterX || y != clusterY) && !Visible(map, x << MAP_PVS_CLUSTER_SHIFT, y << MAP_PVS_CLUSTER_SHIFT,
+                            clusterX << MAP_PVS_CLUSTER_SHIFT, clusterY << MAP_PVS_CLUSTER_SHIFT))
+                            continue;
+                        _queued[cluster >> 6] |= 1ull << (cluster & 63);
+                        _opened.push_back(cluster);
+                    }
+                }
+            }
+        }
+    }
+
+    // Open them chunk by chunk, a chunk without sets gets them here so the others in it stay empty
+    int chunksX = map.ChunksX();
+    int clustersX = _clustersX;
+    auto chunkOf = [=](uint32_t cluster) {
+        return (int)(cluster / clustersX >> CLUSTER_SHIFT_IN_CHUNK) * chunksX + (int)(cluster % clustersX >> CLUSTER_SHIFT_IN_CHUNK);
+    };
+    std::sort(_opened.begin(), _opened.end(), [&](uint32_t a, uint32_t b) { return chunkOf(a) < chunkOf(b); });
+    Scratch& scratch = *_scratch;
+    for (size_t first = 0; first < _opened.size();)
+    {
+        int chunk = chunkOf(_opened[first]);
+        Unpack(map, chunk % chunksX, chunk / chunksX, scratch);
+        size_t end = first;
+        for (; end < _opened.size() && chunkOf(_opened[end]) == chunk; end++)
+        {
+            uint32_t cluster = _opened[end];
+            int local = (int)(cluster / clustersX % MAP_PVS_CHUNK_CLUSTERS) * MAP_PVS_CHUNK_CLUSTERS + (int)(cluster % clustersX % MAP_PVS_CHUNK_CLUSTERS);
+            std::fill(scratch.rows[local], scratch.rows[local] + MAP_PVS_WINDOW, ROW_MASK);
+        }
+        Pack(scratch, scratch.packed);
+        map.SetPvsData(chunk % chunksX, chunk / chunksX, scratch.packed);
+        first = end;
+    }
+
+    // Patched chunk by chunk, so the grid around one is loaded once for all of its clusters
+    _queue.insert(_queue.end(), _opened.begin(), _opened.end());
+    std::sort(_queue.begin(), _queue.end(), [&](uint32_t a, uint32_t b) { return chunkOf(a) > chunkOf(b); });
+    scratch.gridChunk = -1;
+}
+
+void MapPvs::Patch(Map& map)
+{
+    if (_queue.empty())
+        return;
+
+    PROFILE_FUNCTION();
+
+    Scratch& scratch = *_scratch;
+    int budget = std::max(1, clustersPerPatch);
+    while (budget > 0 && !_queue.empty())
+    {
+        // The queued clusters of the next chunk, as many as the budget allows
+        uint32_t cluster = _queue.back();
+        int chunkX = (int)(cluster % _clustersX) >> CLUSTER_SHIFT_IN_CHUNK;
+        int chunkY = (int)(cluster / _clustersX) >> CLUSTER_SHIFT_IN_CHUNK;
+        uint64_t clusters = 0;
+        while (budget > 0 && !_queue.empty())
+        {
+            cluster = _queue.back();
+            int x = (int)(cluster % _clustersX);
+            int y = (int)(cluster / _clustersX);
+            if (x >> CLUSTER_SHIFT_IN_CHUNK != chunkX || y >> CLUSTER_SHIFT_IN_CHUNK != chunkY)
+                break;
+            clusters |= 1ull << ((y % MAP_PVS_CHUNK_CLUSTERS) * MAP_PVS_CHUNK_CLUSTERS + x % MAP_PVS_CHUNK_CLUSTERS);
+            _queued[cluster >> 6] &= ~(1ull << (cluster & 63));
+            _queue.pop_back();
+            budget--;
+        }
+
+        Unpack(map, chunkX, chunkY, scratch);
+        Compute(map, chunkX, chunkY, clusters, scratch);
+        Pack(scratch, scratch.packed);
+        map.SetPvsData(chunkX, chunkY, scratch.packed);
+    }
+}
+
+bool MapPvs::Visible(const Map& map, int fromX, int fromY, int toX, int toY) const
+{
+    if (!map.InBounds(fromX, fromY) || !map.InBounds(toX, toY))
+        return false;
+
+    int clusterX = fromX >> MAP_PVS_CLUSTER_SHIFT;
+    int clusterY = fromY >> MAP_PVS_CLUSTER_SHIFT;
+    unsigned column = (unsigned)((toX >> MAP_PVS_CLUSTER_SHIFT) - clusterX + MAP_PVS_RANGE);
+    unsigned row = (unsigned)((toY >> MAP_PVS_CLUSTER_SHIFT) - clusterY + MAP_PVS_RANGE);
+    if (column >= (unsigned)MAP_PVS_WINDOW || row >= (unsigned)MAP_PVS_WINDOW)
+        return false;
+
+    size_t bytes;
+    const unsigned char* data = map.PvsData(fromX >> MAP_CHUNK_SHIFT, fromY >> MAP_CHUNK_SHIFT, bytes);
+    if (!data || bytes < HEADER_BYTES)
+        return true;
+
+    MapPvsCluster set;
+    int local = (clusterY % MAP_PVS_CHUNK_CLUSTERS) * MAP_PVS_CHUNK_CLUSTERS + clusterX % MAP_PVS_CHUNK_CLUSTERS;
+    memcpy(&set, data + local * sizeof(set), sizeof(set));
+    if (!((set.rowMask >> row) & 1))
+        return false;
+
+    // A damaged set stays conservative
+    size_t offset = HEADER_BYTES + ((size_t)set.firstRow + PopCount(set.rowMask & ((1u << row) - 1))) * sizeof(uint32_t);
+    if (offset + sizeof(uint32_t) > bytes)
+        return true;
+    uint32_t bits;
+    memcpy(&bits, data + offset, sizeof(bits));
+    return (bits >> column) & 1;
+}
+
+int MapPvs::VisibleClusterCount(const Map& map, int x, int y) const
+{
+    if (!map.InBounds(x, y))
+        return -1;
+    size_t bytes;
+    const unsigned char* data = map.PvsData(x >> MAP_CHUNK_SHIFT, y >> MAP_CHUNK_SHIFT, bytes);
+    if (!data || bytes < HEADER_BYTES)
+        return -1;
+
+    MapPvsCluster set;
+    int local = ((y >> MAP_PVS_CLUSTER_SHIFT) % MAP_PVS_CHUNK_CLUSTERS) * MAP_PVS_CHUNK_CLUSTERS + (x >> MAP_PVS_CLUSTER_SHIFT) % MAP_PVS_CHUNK_CLUSTERS;
+    memcpy(&set, data + local * sizeof(set), sizeof(set));
+    int count = 0;
+    for (int row = 0; row < PopCount(set.rowMask); row++)
+    {
+        size_t offset = HEADER_BYTES + ((size_t)set.firstRow + row) * sizeof(uint32_t);
+        if (offset + sizeof(uint32_t) > bytes)
+            break;
+        uint32_t bits;
+        memcpy(&bits, data + offset, sizeof(bits));
+        count += PopCount(bits);
+    }
+    return count;
+}
+
+void MapPvs::LoadGrid(const Map& map, int chunkX, int chunkY, Scratch& scratch)
+{
+    int index = chunkY * map.ChunksX() + chunkX;
+    if (scratch.gridChunk == index)
+        return;
+    scratch.gridChunk = index;
+
+    // Streamed chunks that are not loaded would read as solid, the file has the real cells
+    for (int gridY = 0; gridY < GRID_CHUNKS; gridY++)
+    {
+        for (int gridX = 0; gridX < GRID_CHUNKS; gridX++)
+        {
+            int x = chunkX + gridX - GRID_MARGIN_CHUNKS;
+            int y = chunkY + gridY - GRID_MARGIN_CHUNKS;
+            uint64_t (*rows)[GRID_CHUNKS] = scratch.solid + gridY * MAP_CHUNK_SIZE;
+            if (x < 0 || y < 0 || x >= map.ChunksX() || y >= map.ChunksY())
+            {
+                for (int row = 0; row < MAP_CHUNK_SIZE; row++)
+                    rows[row][gridX] = ~0ull;
+                continue;
+            }
+
+            std::unique_ptr<MapChunk> decoded;
+            const MapChunk* chunk;
+            if (map.IsLoaded(x, y))
+                chunk = map.Chunk(x, y);
+            else
+                chunk = (decoded = map.DecodeChunkData(x, y)).get();
+
+            // Cells past the map edge count as wall, like everywhere else
+            int width = std::min(MAP_CHUNK_SIZE, map.Width() - (x << MAP_CHUNK_SHIFT));
+            int height = std::min(MAP_CHUNK_SIZE, map.Height() - (y << MAP_CHUNK_SHIFT));
+            uint64_t outside = width < MAP_CHUNK_SIZE ? ~0ull << width : 0;
+            for (int row = 0; row < MAP_CHUNK_SIZE; row++)
+                rows[row][gridX] = row >= height ? ~0ull : (chunk ? chunk->occupancy[row] : 0) | outside;
+        }
+    }
+}
+
+void MapPvs::Compute(const Map& map, int chunkX, int chunkY, uint64_t clusters, Scratch& scratch)
+{
+    LoadGrid(map, chunkX, chunkY, scratch);
+
+    // Clusters without floor have an empty set
+    for (int local = 0; local < CHUNK_CLUSTERS; local++)
+    {
+        if (!((clusters >> local) & 1))
+            continue;
+        std::fill(scratch.rows[local], scratch.rows[local] + MAP_PVS_WINDOW, 0u);
+        int x = GRID_MARGIN + local % MAP_PVS_CHUNK_CLUSTERS * MAP_PVS_CLUSTER_SIZE;
+        int y = GRID_MARGIN + local / MAP_PVS_CHUNK_CLUSTERS * MAP_PVS_CLUSTER_SIZE;
+        bool floor = false;
+        for (int row = 0; row < MAP_PVS_CLUSTER_SIZE && !floor; row++)
+            floor = ((~scratch.solid[y + row][x >> MAP_CHUNK_SHIFT] >> (x & (MAP_CHUNK_SIZE - 1))) & 0xFF) != 0;
+        if (floor)
+            scratch.rows[local][MAP_PVS_RANGE] = 1u << MAP_PVS_RANGE;
+        else
+            clusters &= ~(1ull << local);
+    }
+
+    // Every unit edge on the border of a cluster once, shared by the clusters on both sides
+    memset(scratch.cast, 0, sizeof(scratch.cast));
+    for (int local = 0; local < CHUNK_CLUSTERS; local++)
+    {
+        if (!((clusters >> local) & 1))
+            continue;
+        int clusterX = local % MAP_PVS_CHUNK_CLUSTERS * MAP_PVS_CLUSTER_SIZE;
+        int clusterY = local / MAP_PVS_CHUNK_CLUSTERS * MAP_PVS_CLUSTER_SIZE;
+        for (int edge = 0; edge < MAP_PVS_CLUSTER_SIZE * 4; edge++)
+        {
+            // Top and bottom edges run along x from their corner, left and right ones along y
+            int side = edge / MAP_PVS_CLUSTER_SIZE;
+            int along = edge % MAP_PVS_CLUSTER_SIZE;
+            int axis = side & 1;
+            int x = clusterX + (axis ? (side == 1 ? 0 : MAP_PVS_CLUSTER_SIZE) : along);
+            int y = clusterY + (axis ? along : (side == 0 ? 0 : MAP_PVS_CLUSTER_SIZE));
+            uint8_t& cast = scratch.cast[y * CORNERS + x];
+            if (cast & (1 << axis))
+                continue;
+            cast |= 1 << axis;
+            if (!CastFrom(GRID_MARGIN + x, GRID_MARGIN + y, axis, scratch))
+                continue;
+
+            // Into the clusters on both sides of the edge
+            int x0 = axis ? std::max(0, (x - 1) >> MAP_PVS_CLUSTER_SHIFT) : x >> MAP_PVS_CLUSTER_SHIFT;
+            int y0 = axis ? y >> MAP_PVS_CLUSTER_SHIFT : std::max(0, (y - 1) >> MAP_PVS_CLUSTER_SHIFT);
+            int x1 = std::min(MAP_PVS_CHUNK_CLUSTERS - 1, x >> MAP_PVS_CLUSTER_SHIFT);
+            int y1 = std::min(MAP_PVS_CHUNK_CLUSTERS - 1, y >> MAP_PVS_CLUSTER_SHIFT);
+            for (int borderY = y0; borderY <= y1; borderY++)
+            {
+                for (int borderX = x0; borderX <= x1; borderX++)
+                {
+                    int border = borderY * MAP_PVS_CHUNK_CLUSTERS + borderX;
+                    if (!((clusters >> border) & 1))
+                        continue;
+                    int windowX = GRID_MARGIN / MAP_PVS_CLUSTER_SIZE + borderX - MAP_PVS_RANGE;
+                    int windowY = GRID_MARGIN / MAP_PVS_CLUSTER_SIZE + borderY - MAP_PVS_RANGE;
+                    for (int row = 0; row < MAP_PVS_WINDOW; row++)
+                        scratch.rows[border][row] |= (uint32_t)(scratch.seen[windowY + row] >> windowX) & ROW_MASK;
+                }
+            }
+        }
+    }
+}
+
+bool MapPvs::CastFrom(int pointX, int pointY, int axis, Scratch& scratch)
+{
+    // A line through the edge leaves a floor cell on one side of it
+    int stepX = axis ? 0 : 1;
+    int stepY = axis ? 1 : 0;
+    if (scratch.Solid(pointX - stepY, pointY - stepX) && scratch.Solid(pointX, pointY))
+        return false;
+
+    // A line from a point t along the edge misses the walls where the same line
+    // from the corner misses them moved back by t. For every t at once that
+    // leaves a wall whole when the next cell along the edge is a wall too, and
+    // only its side facing back otherwise. What the line from the corner reaches,
+    // the others reach there or one cell further along.
+    memset(scratch.seen, 0, sizeof(scratch.seen));
+    const double INFINITE_SLOPE = std::numeric_limits<double>::infinity();
+    for (int octant = 0; octant < 8; octant++)
+    {
+        bool flipX = (octant & 1) != 0;
+        bool flipY = (octant & 2) != 0;
+        bool swap = (octant & 4) != 0;
+
+        // The side left of a wall is across the octant's columns or along them,
+        // at the near or the far end of the cell
+        bool sideAcross = (axis == 0) != swap;
+        bool sideFar = axis ? flipY : flipX;
+
+        // Cell (x, y) of the octant spans the slopes y / (x + 1) to (y + 1) / x
+        // from the corner. Walls close their slopes for the columns after theirs,
+        // cells in the same column do not shadow each other, which only lets
+        // more through.
+        std::vector<Interval>& open = scratch.open;
+        open.assign(1, { 0.0, 1.0 });
+        for (int x = 0; x < SIGHT_CELLS && !open.empty(); x++)
+        {
+            std::vector<Interval>& blocked = scratch.blocked;
+            blocked.clear();
+            int lastY = -1;
+            for (const Interval& interval : open)
+            {
+                int yMax = (int)std::ceil(interval.hi * (x + 1)) - 1;
+                for (int y = std::max(lastY + 1, (int)std::floor(interval.lo * x)); y <= yMax; y++)
+                {
+                    int dx = swap ? y : x;
+                    int dy = swap ? x : y;
+                    int cellX = flipX ? pointX - 1 - dx : pointX + dx;
+                    int cellY = flipY ? pointY - 1 - dy : pointY + dy;
+                    scratch.seen[cellY >> MAP_PVS_CLUSTER_SHIFT] |= 1ull << (cellX >> MAP_PVS_CLUSTER_SHIFT);
+                    if (cellX + stepX < GRID_SIZE && cellY + stepY < GRID_SIZE)
+                        scratch.seen[(cellY + stepY) >> MAP_PVS_CLUSTER_SHIFT] |= 1ull << ((cellX + stepX) >> MAP_PVS_CLUSTER_SHIFT);
+                    if (!scratch.Solid(cellX, cellY))
+                        continue;
+
+                    double lo = (double)y / (x + 1);
+                    double hi = x ? (double)(y + 1) / x : INFINITE_SLOPE;
+                    bool whole = cellX + stepX < GRID_SIZE && cellY + stepY < GRID_SIZE && scratch.Solid(cellX + stepX, cellY + stepY);
+                    if (!whole && sideAcross)
+                    {
+                        int u = sideFar ? x + 1 : x;
+                        lo = u ? (double)y / u : INFINITE_SLOPE;
+                        hi = u ? (double)(y + 1) / u : INFINITE_SLOPE;
+                    }
+                    else if (!whole)
+                    {
+                        int v = sideFar ? y + 1 : y;
+                        lo = (double)v / (x + 1);
+                        hi = x ? (double)v / x : v ? INFINITE_SLOPE : 0.0;
+                    }
+                    if (lo < hi)
+                        blocked.push_back({ lo, hi });
+                }
+                lastY = std::max(lastY, yMax);
+            }
+            if (blocked.empty())
+                continue;
+
+            // Whole walls and sides start at different slopes, merge them in order
+            std::sort(blocked.begin(), blocked.end(), [](const Interval& a, const Interval& b) { return a.lo < b.lo; });
+            size_t merged = 0;
+            for (size_t i = 1; i < blocked.size(); i++)
+            {
+                if (blocked[i].lo < blocked[merged].hi)
+                    blocked[merged].hi = std::max(blocked[merged].hi, blocked[i].hi);
+                else
+                    blocked[++merged] = blocked[i];
+            }
+            blocked.resize(merged + 1);
+
+            // What stays open, slopes that only touch a wall's edge included, single slopes dropped
+            std::vector<Interval>& next = scratch.next;
+            next.clear();
+            size_t wall = 0;
+            for (Interval interval : open)
+            {
+                while (wall < blocked.size() && blocked[wall].hi <= interval.lo)
+                    wall++;
+                for (size_t i = wall; i < blocked.size() && blocked[i].lo < interval.hi; i++)
+                {
+                    if (blocked[i].lo > interval.lo)
+                        next.push_back({ interval.lo, blocked[i].lo });
+                    interval.lo = std::max(interval.lo, blocked[i].hi);
+                }
+                if (interval.lo < interval.hi)
+                    next.push_back(interval);
+            }
+            open.swap(next);
+        }
+    }
+    return true;
+}
+
+void MapPvs::Unpack(const Map& map, int chunkX, int chunkY, Scratch& scratch)
+{
+    // No sets yet means no floor when they were built
+    memset(scratch.rows, 0, sizeof(scratch.rows));
+    size_t bytes;
+    const unsigned char* data = map.PvsData(chunkX, chunkY, bytes);
+    if (!data || bytes < HEADER_BYTES)
+        return;
+
+    for (int local = 0; local < CHUNK_CLUSTERS; local++)
+    {
+        MapPvsCluster set;
+        memcpy(&set, data + local * sizeof(set), sizeof(set));
+        size_t word = set.firstRow;
+        for (int row = 0; row < MAP_PVS_WINDOW; row++)
+        {
+            if (!((set.rowMask >> row) & 1))
+                continue;
+            size_t offset = HEADER_BYTES + word++ * sizeof(uint32_t);
+            if (offset + sizeof(uint32_t) <= bytes)
+                memcpy(&scratch.rows[local][row], data + offset, sizeof(uint32_t));
+            else
+                scratch.rows[local][row] = ROW_MASK;
+        }
+    }
+}
+
+void MapPvs::Pack(const Scratch& scratch, std::vector<unsigned char>& out)
+{
+    out.resize(HEADER_BYTES);
+    uint32_t words = 0;
+    for (int local = 0; local < CHUNK_CLUSTERS; local++)
+    {
+        MapPvsCluster set = { 0, words };
+        for (int row = 0; row < MAP_PVS_WINDOW; row++)
+        {
+            uint32_t bits = scratch.rows[local][row];
+            if (!bits)
+                continue;
+            set.rowMask |= 1u << row;
+            out.insert(out.end(), (const unsigned char*)&bits, (const unsigned char*)&bits + sizeof(bits));
+            words++;
+        }
+        memcpy(out.data() + local * sizeof(set), &set, sizeof(set));
+    }
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "map.h"
+
+// Potentially visible sets: which clusters of cells can be seen from which.
+//
+// The map is split into clusters of MAP_PVS_CLUSTER_SIZE cells, and every
+// cluster with floor gets the set of clusters within MAP_PVS_RANGE that a
+// line from it reaches, the first wall it stops at included. Every line out
+// of a cluster crosses its border, so the lines through each cell edge of the
+// border are followed at once: a shadowcast per octant from the edge's corner,
+// against the walls narrowed to what blocks a line from anywhere on the edge,
+// keeps the slopes still open column by column and counts a cell as seen when
+// any part of it is.
+//
+// The sets are stored in the map file (see map_format.h) as bitsets with
+// only their non-empty rows, and read from the mapping in place, so Visible
+// is a bit test in a row found by one popcount.
+//
+// Building is offline work: AssetTool runs it on every core when it writes
+// a map. Edits then only concern the clusters that could see an edited cell,
+// and those are exactly the sets that can change. They are opened to their
+// whole window right away, so every answer stays conservative, and computed
+// again a few per frame by Patch.
+//
+// Clusters farther apart than MAP_PVS_RANGE count as not visible. That is at
+// least 120 cells, well past where the renderer shades walls to black.
+
+class MapPvs
+{
+public:
+    int clustersPerPatch = 1;           // sets computed again per Patch
+
+    MapPvs();
+    MapPvs(const MapPvs&) = delete;
+    MapPvs& operator=(const MapPvs&) = delete;
+    ~MapPvs();
+
+    // Computes every set into the map on worker threads, 0 uses every core.
+    // Unloaded chunks are read from the file, so stop streaming first.
+    void Build(Map& map, int threads = 0);
+
+    // Drops queued patches, call when a map is loaded
+    void Reset(const Map& map);
+
+    // Opens and queues the sets edits can change, call before the map clears them
+    void Update(Map& map, const std::vector<MapDirtyRect>& dirty);
+
+    // Computes up to clustersPerPatch queued sets again
+    void Patch(Map& map);
+
+    // Whether anything in the cell at from may see the cell at to. True where
+    // the map has no sets, false for cells outside the map or out of range.
+    bool Visible(const Map& map, int fromX, int fromY, int toX, int toY) const;
+
+    // Clusters in the set of the cell's cluster, -1 when there is no set
+    int VisibleClusterCount(const Map& map, int x, int y) const;
+
+    int PendingCount() const { return (int)_queue.size(); }
+
+private:
+    // Cells around one chunk and a chunk's sets while they are computed, one per thread
+    struct Scratch;
+
+    static void LoadGrid(const Map& map, int chunkX, int chunkY, Scratch& scratch);
+    static void Compute(const Map& map, int chunkX, int chunkY, uint64_t clusters, Scratch& scratch);
+    static bool CastFrom(int pointX, int pointY, int axis, Scratch& scratch);
+    static void Unpack(const Map& map, int chunkX, int chunkY, Scratch& scratch);
+    static void Pack(const Scratch& scratch, std::vector<unsigned char>& out);
+
+    int _clustersX = 0;
+    std::vector<uint64_t> _queued;      // bit per cluster, y * clustersX + x
+    std::vector<uint32_t> _queue;       // by chunk, the next one last
+    std::vector<uint32_t> _opened;
+    std::unique_ptr<Scratch> _scratch;
+};
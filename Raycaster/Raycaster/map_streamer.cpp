@@ -0,0 +1,221 @@
+#include "map_streamer.h"
+#include "perf_counters.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+void MapStreamer::Start(Map& map, double x, double y)
+{
+    Stop();
+    if (!map.HasFile())
+        return;
+
+    PROFILE_FUNCTION();
+
+    _map = &map;
+    _map->SetStreamed(true);
+    _requested.assign((size_t)map.ChunksX() * map.ChunksY(), 0);
+    _lastX = x;
+    _lastY = y;
+    _centerX = _centerY = _aheadX = _aheadY = -1;
+
+    // Chunks the map already holds, say after saving over its file, are dropped like any other
+    for (int index = 0; index < map.ChunksX() * map.ChunksY(); index++)
+        if (map.IsLoaded(index % map.ChunksX(), index / map.ChunksX()))
+            _resident.push_back(index);
+
+    // The chunks right around the player are decoded here, the rest come in the background
+    int centerX = std::max(0, std::min(map.ChunksX() - 1, (int)std::floor(x) >> MAP_CHUNK_SHIFT));
+    int centerY = std::max(0, std::min(map.ChunksY() - 1, (int)std::floor(y) >> MAP_CHUNK_SHIFT));
+    for (int chunkY = std::max(0, centerY - 1); chunkY <= std::min(map.ChunksY() - 1, centerY + 1); chunkY++)
+    {
+        for (int chunkX = std::max(0, centerX - 1); chunkX <= std::min(map.ChunksX() - 1, centerX + 1); chunkX++)
+        {
+            if (map.IsLoaded(chunkX, chunkY))
+                continue;
+            map.InstallChunk(chunkX, chunkY, map.DecodeChunkData(chunkX, chunkY));
+            _resident.push_back(chunkY * map.ChunksX() + chunkX);
+            _loadedTotal++;
+        }
+    }
+
+    _stopping = false;
+    _worker = std::thread(&MapStreamer::WorkerLoop, this);
+}
+
+void MapStreamer::Stop()
+{
+    if (!_map)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(_jobMutex);
+        _stopping = true;
+        _jobs.clear();
+    }
+    _jobCondition.notify_all();
+    _worker.join();
+
+    Result result;
+    while (_results.Pop(result)) {}
+
+    _map->SetStreamed(false);
+    _map = nullptr;
+    _requested.clear();
+    _resident.clear();
+    _changed.clear();
+    _pending = 0;
+}
+
+void MapStreamer::Update(double x, double y, double deltaTime)
+{
+    if (!_map)
+        return;
+
+    PROFILE_FUNCTION();
+    PERF_STAGE("Map streaming");
+
+    _changed.clear();
+
+    // Where the player is and where it will be if it keeps moving like this
+    double velocityX = deltaTime > 0 ? (x - _lastX) / deltaTime : 0.0;
+    double velocityY = deltaTime > 0 ? (y - _lastY) / deltaTime : 0.0;
+    _lastX = x;
+    _lastY = y;
+    int lastChunkX = _map->ChunksX() - 1;
+    int lastChunkY = _map->ChunksY() - 1;
+    int centerX = std::max(0, std::min(lastChunkX, (int)std::floor(x) >> MAP_CHUNK_SHIFT));
+    int centerY = std::max(0, std::min(lastChunkY, (int)std::floor(y) >> MAP_CHUNK_SHIFT));
+    int aheadX = std::max(0, std::min(lastChunkX, (int)std::floor(x + velocityX * prefetchSeconds) >> MAP_CHUNK_SHIFT));
+    int aheadY = std::max(0, std::min(lastChunkY, (int)std::floor(y + velocityY * prefetchSeconds) >> MAP_CHUNK_SHIFT));
+
+    // The wanted set only changes when either point crosses into another chunk
+    if (centerX != _centerX || centerY != _centerY || aheadX != _aheadX || aheadY != _aheadY)
+    {
+        _centerX = centerX;
+        _centerY = centerY;
+        _aheadX = aheadX;
+        _aheadY = aheadY;
+        Request(centerX, centerY, aheadX, aheadY);
+        Evict(centerX, centerY);
+    }
+
+    // Decoded chunks go into the map, the caller brings the GPU copy along in the same frame
+    Result result;
+    for (int installs = 0; installs < installsPerFrame && _results.Pop(result); installs++)
+    {
+        _requested[result.index] = 0;
+        _pending--;
+        int chunkX = result.index % _map->ChunksX();
+        int chunkY = result.index / _map->ChunksX();
+        if (_map->IsLoaded(chunkX, chunkY))
+            continue;
+
+        _map->InstallChunk(chunkX, chunkY, std::move(result.chunk));
+        _resident.push_back(result.index);
+        _changed.push_back(result.index);
+        _loadedTotal++;
+    }
+    PROFILE_COUNTER("Map chunks resident", _resident.size());
+}
+
+void MapStreamer::Request(int centerX, int centerY, int aheadX, int aheadY)
+{
+    // Squares around both points, nearest to the player first
+    _wanted.clear();
+    int radius = residentRadius;
+    for (int pass = 0; pass < 2; pass++)
+    {
+        int originX = pass == 0 ? centerX : aheadX;
+        int originY = pass == 0 ? centerY : aheadY;
+        if (pass == 1 && originX == centerX && originY == centerY)
+            break;
+        for (int chunkY = std::max(0, originY - radius); chunkY <= std::min(_map->ChunksY() - 1, originY + radius); chunkY++)
+            for (int chunkX = std::max(0, originX - radius); chunkX <= std::min(_map->ChunksX() - 1, originX + radius); chunkX++)
+                if (!_map->IsLoaded(chunkX, chunkY))
+                    _wanted.push_back(chunkY * _map->ChunksX() + chunkX);
+    }
+
+    int chunksX = _map->ChunksX();
+    auto distance = [=](int index) {
+        int dx = index % chunksX - centerX;
+        int dy = index / chunksX - centerY;
+        return dx * dx + dy * dy;
+    };
+    std::sort(_wanted.begin(), _wanted.end(), [&](int a, int b) {
+        int da = distance(a), db = distance(b);
+        return da != db ? da < db : a < b;
+    });
+    _wanted.erase(std::unique(_wanted.begin(), _wanted.end()), _wanted.end());
+
+    // Replace the queue, jobs that are no longer wanted are dropped before they are decoded
+    {
+        std::lock_guard<std::mutex> lock(_jobMutex);
+        for (int index : _jobs)
+            _requested[index] = 0;
+        _pending -= (int)_jobs.size();
+        _jobs.clear();
+        for (auto it = _wanted.rbegin(); it != _wanted.rend(); ++it)
+        {
+            if (_requested[*it])
+                continue;
+            _requested[*it] = 1;
+            _jobs.push_back(*it);
+            _pending++;
+        }
+    }
+    _jobCondition.notify_one();
+}
+
+void MapStreamer::Evict(int centerX, int centerY)
+{
+    int chunksX = _map->ChunksX();
+    for (size_t i = 0; i < _resident.size();)
+    {
+        int index = _resident[i];
+        int chunkX = index % chunksX;
+        int chunkY = index / chunksX;
+        int fromCenter = std::max(std::abs(chunkX - centerX), std::abs(chunkY - centerY));
+        int fromAhead = std::max(std::abs(chunkX - _aheadX), std::abs(chunkY - _aheadY));
+        if (std::min(fromCenter, fromAhead) <= evictRadius)
+        {
+            i++;
+            continue;
+        }
+
+        // Edited chunks stay loaded but are no longer this streamer's to drop
+        if (_map->EvictChunk(chunkX, chunkY))
+        {
+            _changed.push_back(index);
+            _evictedTotal++;
+        }
+        _resident[i] = _resident.back();
+        _resident.pop_back();
+    }
+}
+
+void MapStreamer::WorkerLoop()
+{
+    PROFILE_THREAD_NAME("Map streamer");
+
+    while (true)
+    {
+        int index;
+        {
+            std::unique_lock<std::mutex> lock(_jobMutex);
+            _jobCondition.wait(lock, [this] { return _stopping || !_jobs.empty(); });
+            if (_stopping)
+                return;
+            index = _jobs.back();
+            _jobs.pop_back();
+        }
+
+        PERF_STAGE("Decode map chunk");
+        Result result;
+        result.index = index;
+        result.chunk = _map->DecodeChunkData(index % _map->ChunksX(), index / _map->ChunksX());
+        _results.Push(std::move(result));
+    }
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "map.h"
+#include "mpsc_queue.h"
+
+// Keeps the chunks of a streamed map around the player loaded.
+//
+// Every frame Update gets the player position. Chunks within residentRadius
+// of the player's chunk are wanted, and so are the chunks around a point
+// ahead of the player along its movement, so walking keeps the next area
+// decoding before it is reached. Wanted chunks that are not loaded are queued
+// nearest first for a background thread, which decodes them straight out of
+// the map file mapping. Decoded chunks come back through a lock-free queue
+// and are installed into the Map on the game thread, at most
+// installsPerFrame per frame, and reported in ChangedChunks so the GPU copy
+// can follow. Chunks past evictRadius are dropped again, so memory stays the
+// same size however big the map is.
+//
+// Only Map::DecodeChunkData runs on the worker, and it only reads the file.
+// The map must not be reloaded while streaming: Stop first, Start after.
+
+class MapStreamer
+{
+public:
+    int residentRadius = 2;             // chunks around the player, on each side
+    int evictRadius = 4;                // loaded chunks farther than this are dropped
+    double prefetchSeconds = 2.0;       // how far ahead of the movement to load
+    int installsPerFrame = 8;
+
+    MapStreamer() = default;
+    MapStreamer(const MapStreamer&) = delete;
+    MapStreamer& operator=(const MapStreamer&) = delete;
+    ~MapStreamer() { Stop(); }
+
+    // Streams the map when it is a binary one. Loads the chunks around the
+    // position right away, so the player never starts inside unloaded cells.
+    void Start(Map& map, double x, double y);
+    void Stop();
+    bool IsActive() const { return _map != nullptr; }
+
+    // Request, install and evict. Game thread only.
+    void Update(double x, double y, double deltaTime);
+
+    // Chunks loaded or evicted in the last Update, y * chunksX + x
+    const std::vector<int>& ChangedChunks() const { return _changed; }
+
+    int PendingCount() const { return _pending; }
+    int ResidentCount() const { return (int)_resident.size(); }
+    uint64_t LoadedTotal() const { return _loadedTotal; }
+    uint64_t EvictedTotal() const { return _evictedTotal; }
+
+private:
+    struct Result
+    {
+        int index = -1;
+        std::unique_ptr<MapChunk> chunk;
+    };
+
+    void Request(int centerX, int centerY, int aheadX, int aheadY);
+    void Evict(int centerX, int centerY);
+    void WorkerLoop();
+
+    Map* _map = nullptr;
+    double _lastX = 0;
+    double _lastY = 0;
+    int _centerX = -1;
+    int _centerY = -1;
+    int _aheadX = -1;
+    int _aheadY = -1;
+    std::vector<uint8_t> _requested;    // per chunk, queued or being decoded
+    std::vector<int> _resident;         // chunks this streamer loaded
+    std::vector<int> _wanted;           // scratch, reused every retarget
+    std::vector<int> _changed;
+    int _pending = 0;
+    uint64_t _loadedTotal = 0;
+    uint64_t _evictedTotal = 0;
+
+    // Chunk indices for the worker, nearest at the back
+    std::mutex _jobMutex;
+    std::condition_variable _jobCondition;
+    std::vector<int> _jobs;
+    bool _stopping = false;
+    std::thread _worker;
+
+    MpscQueue<Result> _results;
+};
@@ -0,0 +1,203 @@
+#include "minimap.h"
+#include "asset_pack.h"
+#include "profiler.h"
+#include "shader.h"
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+
+bool Minimap::Init()
+{
+    std::string vertexSource, fragmentSource;
+    if (!ReadAssetText("shaders/fullscreen_vertex_shader.glsl", vertexSource) || !ReadAssetText("shaders/minimap_fragment_shader.glsl", fragmentSource))
+    {
+        std::cerr << "Failed to load minimap shaders" << std::endl;
+        return false;
+    }
+    _program = createShaderProgramFromSource(vertexSource.c_str(), fragmentSource.c_str());
+    _pagesLoc = glGetUniformLocation(_program, "pages");
+    _poolLoc = glGetUniformLocation(_program, "pool");
+    _poolSlotsLoc = glGetUniformLocation(_program, "uPoolSlotsX");
+    _exploredLoc = glGetUniformLocation(_program, "explored");
+    _mapSizeLoc = glGetUniformLocation(_program, "uMapSize");
+
+    glGenVertexArrays(1, &_vao);
+    glGenFramebuffers(1, &_framebuffer);
+    return true;
+}
+
+void Minimap::Shutdown()
+{
+    if (_colorTexture)
+        glDeleteTextures(1, &_colorTexture);
+    if (_fogTexture)
+        glDeleteTextures(1, &_fogTexture);
+    if (_framebuffer)
+        glDeleteFramebuffers(1, &_framebuffer);
+    if (_vao)
+        glDeleteVertexArrays(1, &_vao);
+    if (_program)
+        glDeleteProgram(_program);
+    _colorTexture = _fogTexture = _framebuffer = _vao = _program = 0;
+}
+
+void Minimap::Resize(int mapWidth, int mapHeight)
+{
+    _mapWidth = mapWidth;
+    _mapHeight = mapHeight;
+    _block = (std::max(mapWidth, mapHeight) + MAX_FOG_SIZE - 1) / MAX_FOG_SIZE;
+    _block = std::max(1, _block);
+    _fogWidth = std::max(1, (mapWidth + _block - 1) / _block);
+    _fogHeight = std::max(1, (mapHeight + _block - 1) / _block);
+    _texelPixels = _block == 1 ? CELL_PIXELS : 1;
+
+    size_t cells = (size_t)mapWidth * mapHeight;
+    _explored.assign((cells + 63) / 64, 0);
+    _fog.assign((size_t)_fogWidth * _fogHeight, 0);
+    _exploredCount = 0;
+
+    // The whole cache is redrawn for the new map
+    _dirty = false;
+    MarkDirty(0, 0, _fogWidth - 1, _fogHeight - 1);
+
+    if (!_framebuffer)
+        return;
+
+    if (!_fogTexture)
+        glGenTextures(1, &_fogTexture);
+    glBindTexture(GL_TEXTURE_2D, _fogTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, _fogWidth, _fogHeight, 0, GL_RED, GL_UNSIGNED_BYTE, _fog.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    if (!_colorTexture)
+        glGenTextures(1, &_colorTexture);
+    glBindTexture(GL_TEXTURE_2D, _colorTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, Width(), Height(), 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, _colorTexture, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cerr << "Minimap framebuffer is incomplete" << std::endl;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void Minimap::MarkExplored(int x, int y)
+{
+    if (x < 0 || y < 0 || x >= _mapWidth || y >= _mapHeight)
+        return;
+
+    size_t bit = (size_t)y * _mapWidth + x;
+    uint64_t mask = 1ull << (bit & 63);
+    if (_explored[bit >> 6] & mask)
+        return;
+
+    _explored[bit >> 6] |= mask;
+    _exploredCount++;
+
+    // The first explored cell of a block reveals its fog texel
+    int fogX = x / _block;
+    int fogY = y / _block;
+    uint8_t& fog = _fog[(size_t)fogY * _fogWidth + fogX];
+    if (fog == 0)
+    {
+        fog = 255;
+        MarkDirty(fogX, fogY, fogX, fogY);
+    }
+}
+
+bool Minimap::IsExplored(int x, int y) const
+{
+    if (x < 0 || y < 0 || x >= _mapWidth || y >= _mapHeight)
+        return false;
+    size_t bit = (size_t)y * _mapWidth + x;
+    return (_explored[bit >> 6] >> (bit & 63)) & 1;
+}
+
+void Minimap::MarkCellsChanged(int x0, int y0, int x1, int y1)
+{
+    x0 = std::max(0, x0);
+    y0 = std::max(0, y0);
+    x1 = std::min(_mapWidth - 1, x1);
+    y1 = std::min(_mapHeight - 1, y1);
+    if (x0 > x1 || y0 > y1)
+        return;
+    MarkDirty(x0 / _block, y0 / _block, x1 / _block, y1 / _block);
+}
+
+void Minimap::MarkDirty(int x0, int y0, int x1, int y1)
+{
+    if (!_dirty)
+    {
+        _dirty = true;
+        _dirtyX0 = x0;
+        _dirtyY0 = y0;
+        _dirtyX1 = x1;
+        _dirtyY1 = y1;
+        return;
+    }
+    _dirtyX0 = std::min(_dirtyX0, x0);
+    _dirtyY0 = std::min(_dirtyY0, y0);
+    _dirtyX1 = std::max(_dirtyX1, x1);
+    _dirtyY1 = std::max(_dirtyY1, y1);
+}
+
+void Minimap::Update(const MapPages& pages)
+{
+    if (!_program || !_colorTexture || !_dirty)
+        return;
+
+    PROFILE_FUNCTION();
+    PROFILE_GPU_ZONE("Minimap redraw");
+    _dirty = false;
+    _redrawCount++;
+
+    // Dirty fog texels
+    glBindTexture(GL_TEXTURE_2D, _fogTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, _fogWidth);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, _dirtyX0, _dirtyY0, _dirtyX1 - _dirtyX0 + 1, _dirtyY1 - _dirtyY0 + 1,
+        GL_RED, GL_UNSIGNED_BYTE, &_fog[(size_t)_dirtyY0 * _fogWidth + _dirtyX0]);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    // Only the pixels of the dirty texels are redrawn
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer);
+    glViewport(0, 0, Width(), Height());
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(_dirtyX0 * _texelPixels, _dirtyY0 * _texelPixels,
+        (_dirtyX1 - _dirtyX0 + 1) * _texelPixels, (_dirtyY1 - _dirtyY0 + 1) * _texelPixels);
+
+    glUseProgram(_program);
+    glUniform1i(_pagesLoc, 0);
+    glUniform1i(_exploredLoc, 1);
+    glUniform1i(_poolLoc, 2);
+    glUniform1i(_poolSlotsLoc, pages.PoolSlotsX());
+    glUniform2i(_mapSizeLoc, _mapWidth, _mapHeight);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, pages.PageTexture());
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, _fogTexture);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, pages.PoolTexture());
+    glBindVertexArray(_vao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    glActiveTexture(GL_TEXTURE0);
+
+    glDisable(GL_SCISSOR_TEST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
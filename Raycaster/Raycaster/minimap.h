@@ -0,0 +1,77 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cstdint>
+#include <vector>
+#include "map_pages.h"
+
+// Top-down map with fog of war, cached in a render target.
+//
+// Explored cells are kept in a bitset fed from the frame's ray hits. The
+// cached image is only redrawn where something changed: all of it after
+// Resize, otherwise just the rectangle around newly explored or changed
+// cells, scissored. Drawing the minimap each frame is then one textured quad
+// plus whatever markers the caller puts on top.
+//
+// Maps larger than MAX_FOG_SIZE cells on a side are shown at a block of
+// cells per fog texel and cache pixel, so the textures stay small.
+
+class Minimap
+{
+public:
+    static const int CELL_PIXELS = 8;
+    static const int MAX_FOG_SIZE = 1024;
+
+    // Needs the GL context
+    bool Init();
+    void Shutdown();
+
+    // Clears the explored cells
+    void Resize(int mapWidth, int mapHeight);
+
+    void MarkExplored(int x, int y);
+    bool IsExplored(int x, int y) const;
+
+    // Cells whose map texels changed, inclusive. Redrawn on the next Update.
+    void MarkCellsChanged(int x0, int y0, int x1, int y1);
+
+    // Redraws the dirty part of the cache
+    void Update(const MapPages& pages);
+
+    // Cached image, cell (0, 0) at v = 0
+    GLuint Texture() const { return _colorTexture; }
+    int Width() const { return _fogWidth * _texelPixels; }
+    int Height() const { return _fogHeight * _texelPixels; }
+
+    int ExploredCount() const { return _exploredCount; }
+    int RedrawCount() const { return _redrawCount; }
+
+private:
+    void MarkDirty(int x0, int y0, int x1, int y1);
+
+    int _mapWidth = 0;
+    int _mapHeight = 0;
+    int _block = 1;                     // cells per fog texel on a side
+    int _fogWidth = 0;
+    int _fogHeight = 0;
+    int _texelPixels = CELL_PIXELS;     // cache pixels per fog texel on a side
+    std::vector<uint64_t> _explored;    // bit y * width + x
+    std::vector<uint8_t> _fog;          // row by row like the map
+    int _exploredCount = 0;
+
+    // Fog texels that changed since the last Update, inclusive
+    bool _dirty = false;
+    int _dirtyX0 = 0, _dirtyY0 = 0, _dirtyX1 = 0, _dirtyY1 = 0;
+    int _redrawCount = 0;
+
+    GLuint _program = 0;
+    GLuint _vao = 0;
+    GLuint _framebuffer = 0;
+    GLuint _colorTexture = 0;
+    GLuint _fogTexture = 0;
+    GLint _pagesLoc = -1;
+    GLint _poolLoc = -1;
+    GLint _poolSlotsLoc = -1;
+    GLint _exploredLoc = -1;
+    GLint _mapSizeLoc = -1;
+};
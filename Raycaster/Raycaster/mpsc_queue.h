@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+// Lock-free multi-producer single-consumer queue.
+//
+// Producers push onto an atomic stack with a CAS. The consumer takes the whole
+// stack with a single exchange whenever its private list runs dry and reverses
+// it, so items come out in push order per producer. Only one thread may pop.
+
+template <typename T>
+class MpscQueue
+{
+public:
+    MpscQueue() = default;
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    ~MpscQueue()
+    {
+        T value;
+        while (Pop(value)) {}
+    }
+
+    void Push(T value)
+    {
+        Node* node = new Node{ std::move(value), _head.load(std::memory_order_relaxed) };
+        while (!_head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) {}
+    }
+
+    // Consumer only
+    bool Pop(T& out)
+    {
+        if (!_consumerList)
+        {
+            Node* stack = _head.exchange(nullptr, std::memory_order_acquire);
+            while (stack)
+            {
+                Node* next = stack->next;
+                stack->next = _consumerList;
+                _consumerList = stack;
+                stack = next;
+            }
+            if (!_consumerList)
+                return false;
+        }
+
+        Node* node = _consumerList;
+        _consumerList = node->next;
+        out = std::move(node->value);
+        delete node;
+        return true;
+    }
+
+    // Consumer only
+    bool Empty() const
+    {
+        return !_consumerList && !_head.load(std::memory_order_acquire);
+    }
+
+private:
+    struct Node
+    {
+        T value;
+        Node* next;
+    };
+
+    std::atomic<Node*> _head{ nullptr };
+    Node* _consumerList = nullptr;
+};
@@ -0,0 +1,91 @@
+#include "overlay_cache.h"
+#include "asset_pack.h"
+#include "profiler.h"
+#include "shader.h"
+
+#include <iostream>
+#include <string>
+
+bool OverlayCache::Init(int width, int height)
+{
+    _width = width;
+    _height = height;
+
+    std::string vertexSource, fragmentSource;
+    if (!ReadAssetText("shaders/fullscreen_vertex_shader.glsl", vertexSource) || !ReadAssetText("shaders/composite_fragment_shader.glsl", fragmentSource))
+    {
+        std::cerr << "Failed to load overlay composite shaders" << std::endl;
+        return false;
+    }
+    _program = createShaderProgramFromSource(vertexSource.c_str(), fragmentSource.c_str());
+    _overlayLoc = glGetUniformLocation(_program, "overlay");
+    glGenVertexArrays(1, &_vao);
+
+    glGenTextures(1, &_colorTexture);
+    glBindTexture(GL_TEXTURE_2D, _colorTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &_framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, _colorTexture, 0);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (!complete)
+        std::cerr << "Overlay framebuffer is incomplete" << std::endl;
+    return complete;
+}
+
+void OverlayCache::Shutdown()
+{
+    if (_framebuffer)
+        glDeleteFramebuffers(1, &_framebuffer);
+    if (_colorTexture)
+        glDeleteTextures(1, &_colorTexture);
+    if (_vao)
+        glDeleteVertexArrays(1, &_vao);
+    if (_program)
+        glDeleteProgram(_program);
+    _framebuffer = _colorTexture = _vao = _program = 0;
+    _valid = false;
+}
+
+void OverlayCache::BeginCapture()
+{
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &_previousFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer);
+    glViewport(0, 0, _width, _height);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+}
+
+void OverlayCache::EndCapture()
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)_previousFramebuffer);
+    glViewport(0, 0, _width, _height);
+    _valid = true;
+}
+
+void OverlayCache::Composite()
+{
+    if (!_valid || !_program)
+        return;
+
+    PROFILE_FUNCTION();
+
+    glUseProgram(_program);
+    glUniform1i(_overlayLoc, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, _colorTexture);
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    glBindVertexArray(_vao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    glDisable(GL_BLEND);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <GL/glew.h>
+
+// Screen-sized render target that keeps an overlay between updates.
+//
+// Draw into it between BeginCapture and EndCapture whenever the overlay
+// changes, and Composite it over the frame every frame, which is a single
+// fullscreen triangle. The target is cleared to transparent and expects the
+// separate alpha blending ImGui uses, so it holds premultiplied color and is
+// composited with GL_ONE, GL_ONE_MINUS_SRC_ALPHA.
+
+class OverlayCache
+{
+public:
+    // Needs the GL context
+    bool Init(int width, int height);
+    void Shutdown();
+
+    void BeginCapture();
+    void EndCapture();
+    void Composite();
+
+    // Cleared, forces a capture before the next composite
+    void Invalidate() { _valid = false; }
+    bool IsValid() const { return _valid; }
+
+private:
+    int _width = 0;
+    int _height = 0;
+    bool _valid = false;
+
+    GLuint _framebuffer = 0;
+    GLuint _colorTexture = 0;
+    GLuint _program = 0;
+    GLuint _vao = 0;
+    GLint _overlayLoc = -1;
+    GLint _previousFramebuffer = 0;
+};
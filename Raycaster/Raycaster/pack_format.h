@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+
+// Asset pack written by "AssetTool pack" and mapped by AssetPack.
+//
+// Layout: PackHeader, entryCount PackEntry records sorted by name, then the
+// file contents. Every file starts on a PACK_ALIGNMENT boundary so cooked
+// texture levels can be read in place from the mapping.
+
+const char PACK_MAGIC[4] = { 'R', 'P', 'A', 'K' };
+const uint32_t PACK_VERSION = 1;
+const uint32_t PACK_ALIGNMENT = 64;
+
+#pragma pack(push, 1)
+
+struct PackHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t reserved;
+};
+
+struct PackEntry
+{
+    char name[120];         // relative path with forward slashes, "images/sky.png"
+    uint64_t offset;        // from the start of the pack
+    uint64_t size;
+    uint64_t hash;          // HashContent of the file
+};
+
+#pragma pack(pop)
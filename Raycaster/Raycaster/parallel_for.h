@@ -0,0 +1,45 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "profiler.h"
+
+// Worker threads for a batch of independent items, for one-off jobs such as
+// building a map, not for per-frame work.
+
+// Threads ParallelFor will use, 0 asks for every core
+inline int ParallelWorkerCount(size_t count, int threads)
+{
+    if (threads <= 0)
+        threads = std::max(1, (int)std::thread::hardware_concurrency());
+    return (int)std::min<size_t>(threads, std::max<size_t>(1, count));
+}
+
+// Calls body(index, worker) for every index below count. Items are handed
+// out one at a time, so uneven ones balance out. The calling thread is
+// worker 0 and helps, the others are started here and joined before return.
+template <typename Body>
+void ParallelFor(size_t count, int threads, const char* threadName, const Body& body)
+{
+    std::atomic<size_t> next(0);
+    auto work = [&](int worker) {
+        for (size_t index = next++; index < count; index = next++)
+            body(index, worker);
+    };
+
+    int workerCount = ParallelWorkerCount(count, threads);
+    std::vector<std::thread> workers;
+    for (int worker = 1; worker < workerCount; worker++)
+    {
+        workers.emplace_back([&, worker]() {
+            (void)threadName;  // unused when the profiler is compiled out
+            PROFILE_THREAD_NAME(threadName);
+            work(worker);
+        });
+    }
+    work(0);
+    for (std::thread& thread : workers)
+        thread.join();
+}
@@ -0,0 +1,259 @@
+#include "perf_counters.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace PerfCounters
+{
+    const char* const COUNTER_NAMES[COUNTER_COUNT] = { "cycles", "instructions", "cache misses", "branch misses" };
+
+    namespace
+    {
+        std::mutex registryMutex;
+        std::vector<Stage*> stages;
+        std::vector<ThreadRecord*> threads;
+        std::vector<ThreadRecord*> retiredThreads;  // records of exited threads, reused by new ones
+
+        struct ThreadState
+        {
+            bool opened = false;
+            int leader = -1;
+            int fds[COUNTER_COUNT] = { -1, -1, -1, -1 };
+            int slot[COUNTER_COUNT] = { -1, -1, -1, -1 };  // position in the group read, -1 if missing
+            int slotCount = 0;
+            int depth = 0;
+            ThreadRecord* record = nullptr;
+
+            ~ThreadState()
+            {
+                if (record)
+                {
+                    std::lock_guard<std::mutex> lock(registryMutex);
+                    retiredThreads.push_back(record);
+                }
+#ifdef __linux__
+                for (int i = 0; i < COUNTER_COUNT; i++)
+                    if (fds[i] >= 0)
+                        close(fds[i]);
+#endif
+            }
+        };
+
+        thread_local ThreadState threadState;
+
+#ifdef __linux__
+        int OpenCounter(uint64_t config, int groupFd)
+        {
+            perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = config;
+            attr.disabled = groupFd == -1 ? 1 : 0;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP;
+            return (int)syscall(__NR_perf_event_open, &attr, 0, -1, groupFd, 0);
+        }
+#endif
+
+        void OpenThreadCounters(ThreadState& state)
+        {
+            state.opened = true;
+
+            {
+                Profiler::ThreadBuffer* profilerBuffer = &Profiler::GetThreadBuffer();
+                std::lock_guard<std::mutex> lock(registryMutex);
+                ThreadRecord* record;
+                if (!retiredThreads.empty())
+                {
+                    record = retiredThreads.back();
+                    retiredThreads.pop_back();
+                }
+                else
+                {
+                    record = new ThreadRecord();
+                    threads.push_back(record);
+                }
+                record->profilerBuffer = profilerBuffer;
+                state.record = record;
+            }
+
+#ifdef __linux__
+            const uint64_t configs[COUNTER_COUNT] = {
+                PERF_COUNT_HW_CPU_CYCLES,
+                PERF_COUNT_HW_INSTRUCTIONS,
+                PERF_COUNT_HW_CACHE_MISSES,
+                PERF_COUNT_HW_BRANCH_MISSES
+            };
+
+            for (int i = 0; i < COUNTER_COUNT; i++)
+            {
+                int fd = OpenCounter(configs[i], state.leader);
+                if (fd < 0)
+                    continue;
+                if (state.leader < 0)
+                    state.leader = fd;
+                state.fds[i] = fd;
+                state.slot[i] = state.slotCount++;
+            }
+
+            if (state.leader < 0)
+            {
+                static std::once_flag warned;
+                std::call_once(warned, [] {
+                    std::cerr << "perf_event_open failed, hardware counters disabled (check perf_event_paranoid)\n";
+                });
+                return;
+            }
+
+            ioctl(state.leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(state.leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+        }
+
+        ThreadState& GetThreadState()
+        {
+            if (!threadState.opened)
+                OpenThreadCounters(threadState);
+            return threadState;
+        }
+
+        void ReadCounters(ThreadState& state, uint64_t out[COUNTER_COUNT])
+        {
+            for (int i = 0; i < COUNTER_COUNT; i++)
+                out[i] = 0;
+#ifdef __linux__
+            if (state.leader < 0)
+                return;
+
+            // PERF_FORMAT_GROUP: number of events followed by one value per event
+            uint64_t buffer[1 + COUNTER_COUNT];
+            if (read(state.leader, buffer, sizeof(buffer)) < (ssize_t)sizeof(uint64_t))
+                return;
+            for (int i = 0; i < COUNTER_COUNT; i++)
+                if (state.slot[i] >= 0 && (uint64_t)state.slot[i] < buffer[0])
+                    out[i] = buffer[1 + state.slot[i]];
+#endif
+        }
+    }
+
+    void Accumulator::Add(const Values& v)
+    {
+        ns.fetch_add(v.ns, std::memory_order_relaxed);
+        calls.fetch_add(v.calls, std::memory_order_relaxed);
+        for (int i = 0; i < COUNTER_COUNT; i++)
+            counters[i].fetch_add(v.counters[i], std::memory_order_relaxed);
+    }
+
+    Values Accumulator::Take()
+    {
+        Values v;
+        v.ns = ns.exchange(0, std::memory_order_relaxed);
+        v.calls = calls.exchange(0, std::memory_order_relaxed);
+        for (int i = 0; i < COUNTER_COUNT; i++)
+            v.counters[i] = counters[i].exchange(0, std::memory_order_relaxed);
+        return v;
+    }
+
+    Stage* RegisterStage(const char* name)
+    {
+        Stage* stage = new Stage();
+        stage->name = name;
+        for (int i = 0; i < COUNTER_COUNT; i++)
+            snprintf(stage->counterNames[i], sizeof(stage->counterNames[i]), "%s %s", name, COUNTER_NAMES[i]);
+
+        std::lock_guard<std::mutex> lock(registryMutex);
+        stages.push_back(stage);
+        return stage;
+    }
+
+    bool Available()
+    {
+        return GetThreadState().leader >= 0;
+    }
+
+    bool CounterAvailable(Counter counter)
+    {
+        return GetThreadState().slot[counter] >= 0;
+    }
+
+    void EndFrame()
+    {
+        bool available = Available();
+
+        std::lock_guard<std::mutex> lock(registryMutex);
+        for (Stage* stage : stages)
+        {
+            stage->lastFrame = stage->current.Take();
+            if (!available || stage->lastFrame.calls == 0)
+                continue;
+            for (int i = 0; i < COUNTER_COUNT; i++)
+                PROFILE_COUNTER(stage->counterNames[i], stage->lastFrame.counters[i]);
+        }
+        for (ThreadRecord* thread : threads)
+            thread->lastFrame = thread->current.Take();
+    }
+
+    int StageCount()
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        return (int)stages.size();
+    }
+
+    const Stage& GetStage(int index)
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        return *stages[index];
+    }
+
+    int ThreadCount()
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        return (int)threads.size();
+    }
+
+    const ThreadRecord& GetThread(int index)
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        return *threads[index];
+    }
+
+    ScopedStage::ScopedStage(Stage* stage)
+        : _stage(stage)
+    {
+        ThreadState& state = GetThreadState();
+        state.depth++;
+        ReadCounters(state, _counters);
+        _start = Profiler::Now();
+    }
+
+    ScopedStage::~ScopedStage()
+    {
+        uint64_t end = Profiler::Now();
+        ThreadState& state = GetThreadState();
+        uint64_t counters[COUNTER_COUNT];
+        ReadCounters(state, counters);
+
+        Values delta;
+        delta.ns = end - _start;
+        delta.calls = 1;
+        for (int i = 0; i < COUNTER_COUNT; i++)
+            delta.counters[i] = counters[i] - _counters[i];
+        _stage->current.Add(delta);
+
+        // Outermost stages make up the thread totals, nested ones are already included
+        if (--state.depth == 0)
+            state.record->current.Add(delta);
+    }
+}
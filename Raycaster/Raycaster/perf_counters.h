@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include "profiler.h"
+
+// Hardware performance counters per frame stage and per thread.
+//
+// On Linux every thread opens its own perf_event_open group (cycles,
+// instructions, cache misses, branch misses) the first time it enters a stage,
+// and a stage reads the group when it starts and when it ends. On other
+// platforms only the stage time is measured.
+//
+// Totals are accumulated over a frame and published by EndFrame, which also
+// writes them into the profiler as counters so they end up in every trace.
+
+namespace PerfCounters
+{
+    enum Counter
+    {
+        Cycles,
+        Instructions,
+        CacheMisses,
+        BranchMisses,
+        COUNTER_COUNT
+    };
+
+    extern const char* const COUNTER_NAMES[COUNTER_COUNT];
+
+    struct Values
+    {
+        uint64_t ns = 0;
+        uint64_t calls = 0;
+        uint64_t counters[COUNTER_COUNT] = {};
+    };
+
+    struct Accumulator
+    {
+        std::atomic<uint64_t> ns{ 0 };
+        std::atomic<uint64_t> calls{ 0 };
+        std::atomic<uint64_t> counters[COUNTER_COUNT] = {};
+
+        void Add(const Values& v);
+        Values Take();
+    };
+
+    struct Stage
+    {
+        const char* name;
+        Accumulator current;
+        Values lastFrame;
+        char counterNames[COUNTER_COUNT][64];
+    };
+
+    struct ThreadRecord
+    {
+        Profiler::ThreadBuffer* profilerBuffer;  // for the thread name
+        Accumulator current;
+        Values lastFrame;
+    };
+
+    // Stages live for the rest of the program, register them once per call site
+    Stage* RegisterStage(const char* name);
+
+    // True when the calling thread has working hardware counters
+    bool Available();
+
+    // Which counters could be opened on the calling thread
+    bool CounterAvailable(Counter counter);
+
+    // Publish the totals of the frame that just ended, call once per frame
+    void EndFrame();
+
+    int StageCount();
+    const Stage& GetStage(int index);
+    int ThreadCount();
+    const ThreadRecord& GetThread(int index);
+
+    class ScopedStage
+    {
+    public:
+        explicit ScopedStage(Stage* stage);
+        ~ScopedStage();
+
+    private:
+        Stage* _stage;
+        uint64_t _start;
+        uint64_t _counters[COUNTER_COUNT];
+    };
+}
+
+#ifndef RAYCASTER_DISABLE_PROFILER
+#define PERF_STAGE(name) \
+    static PerfCounters::Stage* PROFILE_CONCAT(_perfStage, __LINE__) = PerfCounters::RegisterStage(name); \
+    PerfCounters::ScopedStage PROFILE_CONCAT(_perfScope, __LINE__)(PROFILE_CONCAT(_perfStage, __LINE__))
+#else
+#define PERF_STAGE(name)
+#endif
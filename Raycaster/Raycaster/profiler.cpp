@@ -0,0 +1,357 @@
+#include "profiler.h"
+
+#include <GL/glew.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+namespace Profiler
+{
+    namespace
+    {
+        const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+        // Every buffer ever created, buffers are kept alive after their thread exits
+        // so a capture still shows work of finished workers. Buffers of exited
+        // threads go on the retired list and are handed to the next new thread,
+        // so short lived workers don't grow the registry by a buffer each.
+        std::mutex registryMutex;
+        std::vector<ThreadBuffer*> registry;
+        std::vector<ThreadBuffer*> retired;
+        uint32_t nextThreadId = 1;
+
+        // Retires the buffer of the owning thread when it exits
+        struct ThreadBufferOwner
+        {
+            ThreadBuffer* buffer = nullptr;
+
+            ~ThreadBufferOwner()
+            {
+                if (!buffer)
+                    return;
+                std::lock_guard<std::mutex> lock(registryMutex);
+                retired.push_back(buffer);
+            }
+        };
+
+        thread_local ThreadBufferOwner threadBuffer;
+
+        // Capture state, only touched from the thread calling FrameMark
+        int captureFramesRemaining = 0;
+        int captureGraceFrames = 0;
+        uint64_t captureStart = 0;
+        uint64_t captureEnd = 0;
+        std::string capturePath;
+
+        // GPU timestamp queries
+        const int GPU_QUERY_COUNT = 256;
+        struct GpuQuery
+        {
+            GLuint begin = 0;
+            GLuint end = 0;
+            const char* name = nullptr;
+            bool pending = false;
+        };
+        GpuQuery gpuQueries[GPU_QUERY_COUNT];
+        int gpuQueryNext = 0;
+        bool gpuEnabled = false;
+        int64_t gpuClockOffset = 0;
+        ThreadBuffer* gpuBuffer = nullptr;
+
+        void NameBuffer(ThreadBuffer* buffer, const char* name)
+        {
+            if (name)
+                snprintf(buffer->threadName, sizeof(buffer->threadName), "%s", name);
+            else
+                snprintf(buffer->threadName, sizeof(buffer->threadName), "Thread %u", buffer->threadId);
+        }
+
+        ThreadBuffer* CreateBuffer(const char* name)
+        {
+            ThreadBuffer* buffer = new ThreadBuffer();
+            std::lock_guard<std::mutex> lock(registryMutex);
+            buffer->threadId = nextThreadId++;
+            NameBuffer(buffer, name);
+            registry.push_back(buffer);
+            return buffer;
+        }
+
+        // Take a retired buffer, preferring one whose last thread had the same
+        // name so its old events stay on a track with the right name. The write
+        // index carries on, older events age out of the ring as usual.
+        ThreadBuffer* ReuseBuffer(const char* name)
+        {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            if (retired.empty())
+                return nullptr;
+
+            size_t pick = retired.size() - 1;
+            for (size_t i = 0; name && i < retired.size(); i++)
+                if (strcmp(retired[i]->threadName, name) == 0)
+                    pick = i;
+            ThreadBuffer* buffer = retired[pick];
+            retired.erase(retired.begin() + pick);
+            NameBuffer(buffer, name);
+            return buffer;
+        }
+
+        ThreadBuffer* AcquireBuffer(const char* name)
+        {
+            ThreadBuffer* buffer = ReuseBuffer(name);
+            return buffer ? buffer : CreateBuffer(name);
+        }
+
+        // Copy the events of a buffer without blocking its writer. Events that were
+        // overwritten while copying are dropped.
+        void SnapshotBuffer(const ThreadBuffer& buffer, std::vector<Event>& out)
+        {
+            uint64_t end = buffer.writeIndex.load(std::memory_order_acquire);
+            uint64_t begin = end > THREAD_BUFFER_SIZE ? end - THREAD_BUFFER_SIZE : 0;
+
+            size_t first = out.size();
+            for (uint64_t i = begin; i < end; i++)
+                out.push_back(buffer.events[i & (THREAD_BUFFER_SIZE - 1)]);
+
+            uint64_t endAfter = buffer.writeIndex.load(std::memory_order_acquire);
+            uint64_t firstValid = endAfter + 1 > THREAD_BUFFER_SIZE ? endAfter + 1 - THREAD_BUFFER_SIZE : 0;
+            if (firstValid > begin)
+            {
+                size_t dropped = (size_t)std::min<uint64_t>(firstValid - begin, end - begin);
+                out.erase(out.begin() + first, out.begin() + first + dropped);
+            }
+        }
+
+        void WriteJsonString(std::ofstream& file, const char* text)
+        {
+            file << '"';
+            for (const char* c = text; *c; c++)
+            {
+                if (*c == '"' || *c == '\\')
+                    file << '\\';
+                if ((unsigned char)*c >= 0x20)
+                    file << *c;
+            }
+            file << '"';
+        }
+
+        void ResolveGpuQueries()
+        {
+            for (int i = 0; i < GPU_QUERY_COUNT; i++)
+            {
+                GpuQuery& query = gpuQueries[i];
+                if (!query.pending)
+                    continue;
+
+                GLint available = 0;
+                glGetQueryObjectiv(query.end, GL_QUERY_RESULT_AVAILABLE, &available);
+                if (!available)
+                    continue;
+
+                GLuint64 gpuBegin = 0, gpuEnd = 0;
+                glGetQueryObjectui64v(query.begin, GL_QUERY_RESULT, &gpuBegin);
+                glGetQueryObjectui64v(query.end, GL_QUERY_RESULT, &gpuEnd);
+                query.pending = false;
+
+                int64_t begin = (int64_t)gpuBegin - gpuClockOffset;
+                int64_t end = (int64_t)gpuEnd - gpuClockOffset;
+                if (begin < 0 || end < begin)
+                    continue;
+                gpuBuffer->Push({ query.name, (uint64_t)begin, (uint64_t)end, 0.0, EventType::Zone });
+            }
+        }
+    }
+
+    uint64_t Now()
+    {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - startTime).count();
+    }
+
+    ThreadBuffer& GetThreadBuffer()
+    {
+        if (!threadBuffer.buffer)
+            threadBuffer.buffer = AcquireBuffer(nullptr);
+        return *threadBuffer.buffer;
+    }
+
+    void SetThreadName(const char* name)
+    {
+        if (!threadBuffer.buffer)
+        {
+            threadBuffer.buffer = AcquireBuffer(name);
+            return;
+        }
+        std::lock_guard<std::mutex> lock(registryMutex);
+        NameBuffer(threadBuffer.buffer, name);
+    }
+
+    void Counter(const char* name, double value)
+    {
+        uint64_t now = Now();
+        GetThreadBuffer().Push({ name, now, now, value, EventType::Counter });
+    }
+
+    void FrameMark()
+    {
+        uint64_t now = Now();
+        GetThreadBuffer().Push({ "Frame", now, now, 0.0, EventType::FrameMark });
+
+        if (gpuEnabled)
+            ResolveGpuQueries();
+
+        if (captureFramesRemaining > 0)
+        {
+            if (--captureFramesRemaining == 0)
+            {
+                // Give the GPU a few frames to deliver the last timestamps
+                captureEnd = now;
+                captureGraceFrames = 3;
+            }
+        }
+        else if (captureGraceFrames > 0 && --captureGraceFrames == 0)
+        {
+            if (WriteChromeTrace(capturePath, captureStart, captureEnd))
+                std::cout << "Trace written to " << capturePath << std::endl;
+        }
+    }
+
+    void InitGpu()
+    {
+        if (!GLEW_ARB_timer_query && !GLEW_VERSION_3_3)
+        {
+            std::cerr << "Profiler: timer queries not supported, GPU zones disabled\n";
+            return;
+        }
+
+        for (int i = 0; i < GPU_QUERY_COUNT; i++)
+        {
+            glGenQueries(1, &gpuQueries[i].begin);
+            glGenQueries(1, &gpuQueries[i].end);
+        }
+
+        // Map the GPU clock onto the CPU timeline
+        GLint64 gpuNow = 0;
+        glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+        gpuClockOffset = (int64_t)gpuNow - (int64_t)Now();
+
+        if (!gpuBuffer)
+            gpuBuffer = CreateBuffer("GPU");
+        gpuEnabled = true;
+    }
+
+    void ShutdownGpu()
+    {
+        if (!gpuEnabled)
+            return;
+        for (int i = 0; i < GPU_QUERY_COUNT; i++)
+        {
+            glDeleteQueries(1, &gpuQueries[i].begin);
+            glDeleteQueries(1, &gpuQueries[i].end);
+            gpuQueries[i].pending = false;
+        }
+        gpuEnabled = false;
+    }
+
+    int BeginGpuZone(const char* name)
+    {
+        if (!gpuEnabled)
+            return -1;
+
+        // Drop the zone rather than stall if the ring is still waiting on the GPU
+        int index = gpuQueryNext;
+        if (gpuQueries[index].pending)
+            return -1;
+        gpuQueryNext = (gpuQueryNext + 1) % GPU_QUERY_COUNT;
+
+        gpuQueries[index].name = name;
+        glQueryCounter(gpuQueries[index].begin, GL_TIMESTAMP);
+        return index;
+    }
+
+    void EndGpuZone(int query)
+    {
+        if (query < 0)
+            return;
+        glQueryCounter(gpuQueries[query].end, GL_TIMESTAMP);
+        gpuQueries[query].pending = true;
+    }
+
+    void RequestCapture(int frameCount, const std::string& path)
+    {
+        if (frameCount <= 0 || IsCapturing())
+            return;
+        capturePath = path;
+        captureStart = Now();
+        captureFramesRemaining = frameCount;
+    }
+
+    bool IsCapturing()
+    {
+        return captureFramesRemaining > 0 || captureGraceFrames > 0;
+    }
+
+    bool WriteChromeTrace(const std::string& path, uint64_t from, uint64_t to, const std::string& metadata)
+    {
+        std::ofstream file(path);
+        if (!file) {
+            std::cerr << "Failed to write trace: " << path << std::endl;
+            return false;
+        }
+
+        std::vector<ThreadBuffer*> buffers;
+        {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            buffers = registry;
+        }
+
+        file << "{\"displayTimeUnit\":\"ms\",";
+        if (!metadata.empty())
+            file << "\"metadata\":" << metadata << ",";
+        file << "\"traceEvents\":[\n";
+        file.setf(std::ios::fixed);
+        file.precision(3);
+
+        bool first = true;
+        std::vector<Event> events;
+        for (ThreadBuffer* buffer : buffers)
+        {
+            if (!first)
+                file << ",\n";
+            first = false;
+            file << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << buffer->threadId << ",\"args\":{\"name\":";
+            WriteJsonString(file, buffer->threadName);
+            file << "}}";
+
+            events.clear();
+            SnapshotBuffer(*buffer, events);
+            for (const Event& e : events)
+            {
+                if (e.end < from || e.start > to)
+                    continue;
+
+                file << ",\n{\"name\":";
+                WriteJsonString(file, e.name);
+                file << ",\"pid\":1,\"tid\":" << buffer->threadId << ",\"ts\":" << e.start / 1000.0;
+                switch (e.type)
+                {
+                case EventType::Zone:
+                    file << ",\"ph\":\"X\",\"dur\":" << (e.end - e.start) / 1000.0 << "}";
+                    break;
+                case EventType::Counter:
+                    file << ",\"ph\":\"C\",\"args\":{\"value\":" << e.value << "}}";
+                    break;
+                case EventType::FrameMark:
+                    file << ",\"ph\":\"i\",\"s\":\"g\"}";
+                    break;
+                }
+            }
+        }
+
+        file << "\n]}\n";
+        return true;
+    }
+}
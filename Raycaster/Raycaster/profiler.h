@@ -0,0 +1,120 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Lightweight instrumentation for the engine.
+//
+// Every thread records zones and counters into its own fixed-size ring buffer.
+// Writing is wait-free: only the owning thread advances the write index, readers
+// copy a snapshot and drop anything that was overwritten while copying.
+// A capture collects the events of a number of frames and writes them as a
+// Chrome trace JSON file, which opens in chrome://tracing and ui.perfetto.dev.
+//
+// Zone and counter names must be string literals (or otherwise outlive the
+// profiler), only the pointer is stored.
+
+namespace Profiler
+{
+    enum class EventType : uint8_t
+    {
+        Zone,
+        Counter,
+        FrameMark
+    };
+
+    struct Event
+    {
+        const char* name;
+        uint64_t start;     // ns since profiler start
+        uint64_t end;       // ns since profiler start, equal to start for instant events
+        double value;       // counter value
+        EventType type;
+    };
+
+    // Number of events kept per thread, must be a power of two
+    const uint32_t THREAD_BUFFER_SIZE = 1 << 16;
+
+    struct ThreadBuffer
+    {
+        Event events[THREAD_BUFFER_SIZE];
+        std::atomic<uint64_t> writeIndex{ 0 };
+        uint32_t threadId = 0;
+        char threadName[64] = {};
+
+        void Push(const Event& e)
+        {
+            uint64_t index = writeIndex.load(std::memory_order_relaxed);
+            events[index & (THREAD_BUFFER_SIZE - 1)] = e;
+            writeIndex.store(index + 1, std::memory_order_release);
+        }
+    };
+
+    uint64_t Now();
+    ThreadBuffer& GetThreadBuffer();
+
+    void SetThreadName(const char* name);
+    void Counter(const char* name, double value);
+    void FrameMark();
+
+    // GPU timing through GL timestamp queries, resolved a few frames later
+    // and placed on a separate "GPU" track of the same timeline.
+    void InitGpu();
+    void ShutdownGpu();
+    int BeginGpuZone(const char* name);
+    void EndGpuZone(int query);
+
+    // Start recording the next frameCount frames to a Chrome trace file.
+    void RequestCapture(int frameCount, const std::string& path);
+    bool IsCapturing();
+
+    // Write every event in [from, to] of all threads to a Chrome trace file.
+    // metadata, when given, must be a JSON object and is stored as the trace metadata.
+    bool WriteChromeTrace(const std::string& path, uint64_t from, uint64_t to, const std::string& metadata = "");
+
+    class ScopedZone
+    {
+    public:
+        explicit ScopedZone(const char* name)
+            : _name(name), _start(Now()) {}
+        ~ScopedZone()
+        {
+            GetThreadBuffer().Push({ _name, _start, Now(), 0.0, EventType::Zone });
+        }
+
+    private:
+        const char* _name;
+        uint64_t _start;
+    };
+
+    class ScopedGpuZone
+    {
+    public:
+        explicit ScopedGpuZone(const char* name)
+            : _query(BeginGpuZone(name)) {}
+        ~ScopedGpuZone() { EndGpuZone(_query); }
+
+    private:
+        int _query;
+    };
+}
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#ifndef RAYCASTER_DISABLE_PROFILER
+#define PROFILE_ZONE(name) Profiler::ScopedZone PROFILE_CONCAT(_profileZone, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_ZONE(__FUNCTION__)
+#define PROFILE_GPU_ZONE(name) Profiler::ScopedGpuZone PROFILE_CONCAT(_profileGpuZone, __LINE__)(name)
+#define PROFILE_COUNTER(name, value) Profiler::Counter(name, (double)(value))
+#define PROFILE_THREAD_NAME(name) Profiler::SetThreadName(name)
+#define PROFILE_FRAME_MARK() Profiler::FrameMark()
+#else
+#define PROFILE_ZONE(name)
+#define PROFILE_FUNCTION()
+#define PROFILE_GPU_ZONE(name)
+#define PROFILE_COUNTER(name, value)
+#define PROFILE_THREAD_NAME(name)
+#define PROFILE_FRAME_MARK()
+#endif
@@ -0,0 +1,691 @@
+#include "region_graph.h"
+#include "parallel_for.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <unordered_set>
+
+// One chunk per stbcc grid, 8x8 clusters inside it. The preprocessor needs the literal.
+#define STBCC_GRID_COUNT_X_LOG2 6
+#define STBCC_GRID_COUNT_Y_LOG2 6
+#define STB_CONNECTED_COMPONENTS_IMPLEMENTATION
+#include <stb_connected_components.h>
+static_assert(STBCC_GRID_COUNT_X_LOG2 == MAP_CHUNK_SHIFT, "stbcc grid must be one map chunk");
+
+namespace
+{
+    enum Edge { EDGE_TOP, EDGE_BOTTOM, EDGE_LEFT, EDGE_RIGHT };
+
+    // stbcc's component ids are sparse, they are looked up in a table twice the most regions a chunk can have
+    const int ID_TABLE_SIZE = MAP_CHUNK_CELLS;
+
+    // Where the background build gets a chunk's cells, otherwise the first of its rows in the copy
+    const int DECODE_CHUNK = -1;
+    const int NO_WALLS = -2;
+
+    // Rings FindOpenCell searches around the position
+    const int OPEN_CELL_SEARCH_RADIUS = 4 * MAP_CHUNK_SIZE;
+
+    int Find(std::vector<int>& parent, int i)
+    {
+        while (parent[i] != i)
+            i = parent[i] = parent[parent[i]];
+        return i;
+    }
+}
+
+struct RegionGraph::Scratch
+{
+    std::unique_ptr<unsigned char[]> grid{ new unsigned char[stbcc_grid_sizeof()] };
+    unsigned char solid[MAP_CHUNK_CELLS];
+    uint16_t labels[MAP_CHUNK_CELLS];
+    uint32_t ids[ID_TABLE_SIZE];
+    uint16_t idLabels[ID_TABLE_SIZE];
+};
+
+struct RegionGraph::Job
+{
+    RegionGraph graph;
+    const Map* map = nullptr;
+    std::vector<uint64_t> rows;         // occupancy of the chunks the map held when the build started
+    std::vector<int> source;            // by chunk, the first row in rows, DECODE_CHUNK or NO_WALLS
+    std::atomic<bool> cancel{ false };
+    std::atomic<bool> done{ false };
+    std::thread thread;
+};
+
+RegionGraph::RegionGraph() = default;
+
+RegionGraph::~RegionGraph()
+{
+    CancelBuild();
+}
+
+void RegionGraph::Build(const Map& map, int threads)
+{
+    PROFILE_FUNCTION();
+
+    CancelBuild();
+    Reset(map.Width(), map.Height(), map.ChunksX(), map.ChunksY());
+
+    // Chunks are labeled independently, then each links its own regions to its neighbors'
+    std::vector<std::unique_ptr<Scratch>> scratch(ParallelWorkerCount(_chunks.size(), threads));
+    for (std::unique_ptr<Scratch>& workerScratch : scratch)
+        workerScratch.reset(new Scratch());
+    ParallelFor(_chunks.size(), threads, "Region builder", [&](size_t index, int worker) {
+        Label(map, (int)(index % _chunksX), (int)(index / _chunksX), *scratch[worker], _chunks[index]);
+    });
+    Connect(threads);
+}
+
+void RegionGraph::StartBuild(const Map& map)
+{
+    PROFILE_FUNCTION();
+
+    CancelBuild();
+    Reset(0, 0, 0, 0);
+
+    // The game thread goes on loading, evicting and editing chunks, so the job
+    // gets a copy of the ones the map holds and decodes the others out of the
+    // file, which stays mapped until the map is reloaded or saved
+    _job.reset(new Job());
+    Job& job = *_job;
+    job.map = &map;
+    job.graph.Reset(map.Width(), map.Height(), map.ChunksX(), map.ChunksY());
+    job.source.resize(job.graph._chunks.size());
+    for (size_t index = 0; index < job.source.size(); index++)
+    {
+        int chunkX = (int)(index % map.ChunksX());
+        int chunkY = (int)(index / map.ChunksX());
+        if (map.HasFile() && !map.IsLoaded(chunkX, chunkY))
+        {
+            job.source[index] = DECODE_CHUNK;
+            continue;
+        }
+        const MapChunk* chunk = map.Chunk(chunkX, chunkY);
+        if (!chunk)
+        {
+            job.source[index] = NO_WALLS;
+            continue;
+        }
+        job.source[index] = (int)job.rows.size();
+        job.rows.insert(job.rows.end(), chunk->occupancy, chunk->occupancy + MAP_CHUNK_SIZE);
+    }
+
+    // One thread, the frame keeps the other cores
+    job.thread = std::thread([&job]() {
+        PROFILE_THREAD_NAME("Region builder");
+        PROFILE_ZONE("RegionGraph::StartBuild job");
+
+        RegionGraph& graph = job.graph;
+        std::unique_ptr<Scratch> scratch(new Scratch());
+        for (size_t index = 0; index < graph._chunks.size() && !job.cancel; index++)
+        {
+            int chunkX = (int)(index % graph._chunksX);
+            int chunkY = (int)(index / graph._chunksX);
+            std::unique_ptr<MapChunk> decoded;
+            const uint64_t* occupancy = nullptr;
+            if (job.source[index] == DECODE_CHUNK)
+                occupancy = (decoded = job.map->DecodeChunkData(chunkX, chunkY)) ? decoded->occupancy : nullptr;
+            else if (job.source[index] != NO_WALLS)
+                occupancy = &job.rows[job.source[index]];
+            graph.Label(occupancy, chunkX, chunkY, *scratch, graph._chunks[index]);
+        }
+        std::vector<uint64_t>().swap(job.rows);
+        if (!job.cancel)
+            graph.Connect(1);
+        job.done = true;
+    });
+}
+
+void RegionGraph::CancelBuild()
+{
+    if (!_job)
+        return;
+    _job->cancel = true;
+    _job->thread.join();
+    _job.reset();
+    _editedChunks.clear();
+}
+
+bool RegionGraph::FinishBuild(const Map& map)
+{
+    if (!_job || !_job->done)
+        return false;
+
+    PROFILE_FUNCTION();
+
+    _job->thread.join();
+    Adopt(_job->graph);
+    _job.reset();
+
+    // The job labeled these from before their edits
+    if (!_editedChunks.empty())
+    {
+        if (!_scratch)
+            _scratch.reset(new Scratch());
+        std::sort(_editedChunks.begin(), _editedChunks.end());
+        _editedChunks.erase(std::unique(_editedChunks.begin(), _editedChunks.end()), _editedChunks.end());
+        for (int index : _editedChunks)
+            Rebuild(map, index);
+        _editedChunks.clear();
+    }
+    return true;
+}
+
+void RegionGraph::Reset(int width, int height, int chunksX, int chunksY)
+{
+    _width = width;
+    _height = height;
+    _chunksX = chunksX;
+    _chunksY = chunksY;
+    _regionCount = 0;
+    _chunks.clear();
+    _chunks.resize((size_t)_chunksX * _chunksY);
+    _components.clear();
+    _freeComponents.clear();
+}
+
+void RegionGraph::Adopt(RegionGraph& built)
+{
+    _width = built._width;
+    _height = built._height;
+    _chunksX = built._chunksX;
+    _chunksY = built._chunksY;
+    _regionCount = built._regionCount;
+    _visit = built._visit;
+    _chunks.swap(built._chunks);
+    _components.swap(built._components);
+    _freeComponents.swap(built._freeComponents);
+}
+
+void RegionGraph::Connect(int threads)
+{
+    ParallelFor(_chunks.size(), threads, "Region builder", [&](size_t index, int) {
+        LinkInto((int)index);
+    });
+
+    _regionCount = 0;
+    _visit++;
+    for (size_t index = 0; index < _chunks.size(); index++)
+    {
+        for (size_t i = 0; i < _chunks[index].regions.size(); i++)
+        {
+            uint32_t region = (uint32_t)(index << REGION_SHIFT | i);
+            if (At(region).visit != _visit)
+                Flood(region, AllocateComponent());
+        }
+        _regionCount += (int)_chunks[index].regions.size();
+    }
+}
+
+void RegionGraph::Label(const Map& map, int chunkX, int chunkY, Scratch& scratch, ChunkRegions& out) const
+{
+    // Streamed chunks that are not loaded would read as solid, the file has the real cells
+    std::unique_ptr<MapChunk> decoded;
+    const MapChunk* chunk;
+    if (map.IsLoaded(chunkX, chunkY))
+        chunk = map.Chunk(chunkX, chunkY);
+    else
+        chunk = (decoded = map.DecodeChunkData(chunkX, chunkY)).get();
+    Label(chunk ? chunk->occupancy : nullptr, chunkX, chunkY, scratch, out);
+}
+
+void RegionGraph::Label(const uint64_t* occupancy, int chunkX, int chunkY, Scratch& scratch, ChunkRegions& out) const
+{
+    out.regions.clear();
+    out.labels.clear();
+    out.labelBits = 0;
+    memset(out.edges, 0, sizeof(out.edges));
+
+    int x0 = chunkX << MAP_CHUNK_SHIFT;
+    int y0 = chunkY << MAP_CHUNK_SHIFT;
+    int width = std::min(MAP_CHUNK_SIZE, _width - x0);
+    int height = std::min(MAP_CHUNK_SIZE, _height - y0);
+
+    // Cells past the map edge count as wall, like everywhere else
+    bool open = false;
+    for (int y = 0; y < MAP_CHUNK_SIZE; y++)
+    {
+        uint64_t row = occupancy ? occupancy[y] : 0;
+        for (int x = 0; x < MAP_CHUNK_SIZE; x++)
+        {
+            bool solid = x >= width || y >= height || ((row >> x) & 1);
+            scratch.solid[y * MAP_CHUNK_SIZE + x] = solid;
+            open = open || !solid;
+        }
+    }
+    if (!open)
+        return;
+
+    if (!occupancy)
+    {
+        // No walls, the whole chunk is one region and needs no labels
+        Region region;
+        region.cellCount = width * height;
+        region.x = x0;
+        region.y = y0;
+        out.regions.push_back(std::move(region));
+        for (int cell = 0; cell < MAP_CHUNK_CELLS; cell++)
+            scratch.labels[cell] = scratch.solid[cell] ? 0 : 1;
+    }
+    else
+    {
+        stbcc_grid* grid = (stbcc_grid*)scratch.grid.get();
+        stbcc_init_grid(grid, scratch.solid, MAP_CHUNK_SIZE, MAP_CHUNK_SIZE);
+
+        // Number stbcc's components in the order their first cell comes up
+        memset(scratch.ids, 0xFF, sizeof(scratch.ids));
+        uint32_t lastId = STBCC_NULL_UNIQUE_ID;
+        uint16_t lastLabel = 0;
+        for (int cell = 0; cell < MAP_CHUNK_CELLS; cell++)
+        {
+            uint32_t id = scratch.solid[cell] ? STBCC_NULL_UNIQUE_ID
+                : stbcc_get_unique_id(grid, cell & (MAP_CHUNK_SIZE - 1), cell >> MAP_CHUNK_SHIFT);
+            if (id == STBCC_NULL_UNIQUE_ID)
+            {
+                scratch.labels[cell] = 0;
+                continue;
+            }
+            if (id != lastId)
+            {
+                int slot = (int)((id * 2654435761u) >> 20) & (ID_TABLE_SIZE - 1);
+                while (scratch.ids[slot] != id && scratch.ids[slot] != STBCC_NULL_UNIQUE_ID)
+                    slot = (slot + 1) & (ID_TABLE_SIZE - 1);
+                if (scratch.ids[slot] == STBCC_NULL_UNIQUE_ID)
+                {
+                    scratch.ids[slot] = id;
+                    scratch.idLabels[slot] = (uint16_t)(out.regions.size() + 1);
+                    Region region;
+                    region.x = x0 + (cell & (MAP_CHUNK_SIZE - 1));
+                    region.y = y0 + (cell >> MAP_CHUNK_SHIFT);
+                    out.regions.push_back(std::move(region));
+                }
+                lastId = id;
+                lastLabel = scratch.idLabels[slot];
+            }
+            scratch.labels[cell] = lastLabel;
+            out.regions[lastLabel - 1].cellCount++;
+        }
+
+        // Most chunks have a handful of regions and take half a byte a cell
+        out.labelBits = out.regions.size() < 16 ? 4 : out.regions.size() < 256 ? 8 : 16;
+        out.labels.assign(MAP_CHUNK_CELLS * out.labelBits / 8, 0);
+        for (int cell = 0; cell < MAP_CHUNK_CELLS; cell++)
+        {
+            uint16_t label = scratch.labels[cell];
+            if (out.labelBits == 4)
+                out.labels[cell >> 1] |= (uint8_t)(label << ((cell & 1) * 4));
+            else if (out.labelBits == 8)
+                out.labels[cell] = (uint8_t)label;
+            else
+            {
+                out.labels[cell * 2] = (uint8_t)label;
+                out.labels[cell * 2 + 1] = (uint8_t)(label >> 8);
+            }
+        }
+    }
+
+    for (int i = 0; i < MAP_CHUNK_SIZE; i++)
+    {
+        out.edges[EDGE_TOP][i] = scratch.labels[i];
+        out.edges[EDGE_BOTTOM][i] = scratch.labels[(MAP_CHUNK_SIZE - 1) * MAP_CHUNK_SIZE + i];
+        out.edges[EDGE_LEFT][i] = scratch.labels[i * MAP_CHUNK_SIZE];
+        out.edges[EDGE_RIGHT][i] = scratch.labels[i * MAP_CHUNK_SIZE + MAP_CHUNK_SIZE - 1];
+    }
+}
+
+void RegionGraph::LinkInto(int index)
+{
+    // Writes only this chunk's regions, so every chunk can link at once
+    ChunkRegions& chunk = _chunks[index];
+    for (Region& region : chunk.regions)
+        region.neighbors.clear();
+    if (chunk.regions.empty())
+        return;
+
+    int chunkX = index % _chunksX;
+    int chunkY = index / _chunksX;
+    struct Side { int dx, dy, edge, facing; };
+    const Side sides[4] = {
+        { 0, -1, EDGE_TOP, EDGE_BOTTOM }, { 0, 1, EDGE_BOTTOM, EDGE_TOP },
+        { -1, 0, EDGE_LEFT, EDGE_RIGHT }, { 1, 0, EDGE_RIGHT, EDGE_LEFT },
+    };
+    for (const Side& side : sides)
+    {
+        int neighborX = chunkX + side.dx;
+        int neighborY = chunkY + side.dy;
+        if (neighborX < 0 || neighborY < 0 || neighborX >= _chunksX || neighborY >= _chunksY)
+            continue;
+        int neighborIndex = neighborY * _chunksX + neighborX;
+        const ChunkRegions& neighbor = _chunks[neighborIndex];
+        for (int i = 0; i < MAP_CHUNK_SIZE; i++)
+        {
+            int label = chunk.edges[side.edge][i];
+            int other = neighbor.edges[side.facing][i];
+            if (!label || !other)
+                continue;
+            std::vector<uint32_t>& neighbors = chunk.regions[label - 1].neighbors;
+            uint32_t linked = (uint32_t)neighborIndex << REGION_SHIFT | (uint32_t)(other - 1);
+            if (neighbors.empty() || neighbors.back() != linked)
+                neighbors.push_back(linked);
+        }
+    }
+    for (Region& region : chunk.regions)
+    {
+        std::sort(region.neighbors.begin(), region.neighbors.end());
+        region.neighbors.erase(std::unique(region.neighbors.begin(), region.neighbors.end()), region.neighbors.end());
+    }
+}
+
+void RegionGraph::Relink(int index)
+{
+    // Neighbors drop the links to the chunk's old regions and take the new ones from its side
+    LinkInto(index);
+    int chunkX = index % _chunksX;
+    int chunkY = index / _chunksX;
+    const int offsets[4][2] = { { 0, -1 }, { 0, 1 }, { -1, 0 }, { 1, 0 } };
+    for (const int* offset : offsets)
+    {
+        int neighborX = chunkX + offset[0];
+        int neighborY = chunkY + offset[1];
+        if (neighborX < 0 || neighborY < 0 || neighborX >= _chunksX || neighborY >= _chunksY)
+            continue;
+        uint32_t neighborIndex = (uint32_t)(neighborY * _chunksX + neighborX);
+        for (Region& region : _chunks[neighborIndex].regions)
+        {
+            region.neighbors.erase(std::remove_if(region.neighbors.begin(), region.neighbors.end(),
+                [=](uint32_t linked) { return (int)(linked >> REGION_SHIFT) == index; }), region.neighbors.end());
+        }
+        const std::vector<Region>& regions = _chunks[index].regions;
+        for (size_t i = 0; i < regions.size(); i++)
+            for (uint32_t linked : regions[i].neighbors)
+                if ((linked >> REGION_SHIFT) == neighborIndex)
+                    At(linked).neighbors.push_back((uint32_t)index << REGION_SHIFT | (uint32_t)i);
+        for (Region& region : _chunks[neighborIndex].regions)
+            std::sort(region.neighbors.begin(), region.neighbors.end());
+    }
+}
+
+void RegionGraph::GroupNeighbors(const ChunkRegions& chunk, std::vector<std::pair<uint32_t, int>>& groups)
+{
+    // Neighboring regions the chunk joins together share a group. Groups are
+    // numbered by their first neighbor, so equal lists mean the chunk connects
+    // its surroundings the same way whatever its regions look like.
+    groups.clear();
+    for (size_t i = 0; i < chunk.regions.size(); i++)
+        for (uint32_t linked : chunk.regions[i].neighbors)
+            groups.emplace_back(linked, (int)i);
+    std::sort(groups.begin(), groups.end());
+
+    int regionCount = (int)chunk.regions.size();
+    _parent.resize(regionCount * 2);
+    for (int i = 0; i < regionCount; i++)
+    {
+        _parent[i] = i;
+        _parent[regionCount + i] = -1;
+    }
+    for (size_t k = 1; k < groups.size(); k++)
+        if (groups[k].first == groups[k - 1].first)
+            _parent[Find(_parent, groups[k].second)] = Find(_parent, groups[k - 1].second);
+
+    size_t kept = 0;
+    int groupCount = 0;
+    for (size_t k = 0; k < groups.size(); k++)
+    {
+        if (k > 0 && groups[k].first == groups[k - 1].first)
+            continue;
+        int& group = _parent[regionCount + Find(_parent, groups[k].second)];
+        if (group < 0)
+            group = groupCount++;
+        groups[kept++] = std::make_pair(groups[k].first, group);
+    }
+    groups.resize(kept);
+}
+
+void RegionGraph::Update(const Map& map, const std::vector<MapDirtyRect>& dirty)
+{
+    // The map gives one rectangle per chunk
+    if (_job)
+    {
+        for (const MapDirtyRect& rect : dirty)
+            _editedChunks.push_back((rect.y0 >> MAP_CHUNK_SHIFT) * map.ChunksX() + (rect.x0 >> MAP_CHUNK_SHIFT));
+        return;
+    }
+    if (dirty.empty() || _chunks.empty())
+        return;
+
+    PROFILE_FUNCTION();
+
+    if (!_scratch)
+        _scratch.reset(new Scratch());
+
+    for (const MapDirtyRect& rect : dirty)
+        Rebuild(map, (rect.y0 >> MAP_CHUNK_SHIFT) * _chunksX + (rect.x0 >> MAP_CHUNK_SHIFT));
+}
+
+void RegionGraph::Rebuild(const Map& map, int index)
+{
+    ChunkRegions& chunk = _chunks[index];
+
+    // What the old regions connected, and their share of the components
+    GroupNeighbors(chunk, _oldGroups);
+    _released.clear();
+    for (const Region& region : chunk.regions)
+    {
+        Component& component = _components[region.component];
+        component.cellCount -= region.cellCount;
+        component.regionCount--;
+        _released.push_back(region.component);
+    }
+    _regionCount -= (int)chunk.regions.size();
+
+    Label(map, index % _chunksX, index / _chunksX, *_scratch, chunk);
+    Relink(index);
+    _regionCount += (int)chunk.regions.size();
+    GroupNeighbors(chunk, _newGroups);
+
+    if (_newGroups == _oldGroups)
+    {
+        // Same connections through the chunk, every other region keeps its
+        // component and the new ones join their neighbors'
+        for (Region& region : chunk.regions)
+        {
+            region.component = region.neighbors.empty() ? AllocateComponent() : At(region.neighbors[0]).component;
+            Component& component = _components[region.component];
+            component.cellCount += region.cellCount;
+            component.regionCount++;
+        }
+
+        // Components that lived only inside the chunk are gone
+        for (int component : _released)
+        {
+            if (_components[component].regionCount == 0)
+            {
+                _components[component] = Component();
+                _freeComponents.push_back(component);
+            }
+        }
+        return;
+    }
+
+    // Connections changed: flood from the new regions and from every region
+    // that touched the old ones, which reaches all of the components involved.
+    // Their old numbers are released only afterwards, so no flood reuses one
+    // that other regions still carry.
+    _visit++;
+    _seeds.clear();
+    for (size_t i = 0; i < chunk.regions.size(); i++)
+        _seeds.push_back((uint32_t)index << REGION_SHIFT | (uint32_t)i);
+    for (const std::pair<uint32_t, int>& group : _oldGroups)
+        _seeds.push_back(group.first);
+    for (uint32_t seed : _seeds)
+        if (At(seed).visit != _visit)
+            Flood(seed, AllocateComponent());
+
+    std::sort(_released.begin(), _released.end());
+    _released.erase(std::unique(_released.begin(), _released.end()), _released.end());
+    for (int component : _released)
+    {
+        _components[component] = Component();
+        _freeComponents.push_back(component);
+    }
+}
+
+void RegionGraph::Flood(uint32_t start, int component)
+{
+    _stack.clear();
+    _stack.push_back(start);
+    At(start).visit = _visit;
+    while (!_stack.empty())
+    {
+        Region& region = At(_stack.back());
+        _stack.pop_back();
+        if (region.component >= 0)
+            _released.push_back(region.component);
+        region.component = component;
+        _components[component].cellCount += region.cellCount;
+        _components[component].regionCount++;
+        for (uint32_t linked : region.neighbors)
+        {
+            Region& next = At(linked);
+            if (next.visit == _visit)
+                continue;
+            next.visit = _visit;
+            _stack.push_back(linked);
+        }
+    }
+}
+
+int RegionGraph::AllocateComponent()
+{
+    if (_freeComponents.empty())
+    {
+        _components.emplace_back();
+        return (int)_components.size() - 1;
+    }
+    int component = _freeComponents.back();
+    _freeComponents.pop_back();
+    return component;
+}
+
+uint32_t RegionGraph::RegionAt(int x, int y) const
+{
+    if (x < 0 || y < 0 || x >= _width || y >= _height)
+        return NO_REGION;
+    int index = (y >> MAP_CHUNK_SHIFT) * _chunksX + (x >> MAP_CHUNK_SHIFT);
+    const ChunkRegions& chunk = _chunks[index];
+    if (chunk.regions.empty())
+        return NO_REGION;
+    if (chunk.labels.empty())
+        return (uint32_t)index << REGION_SHIFT;
+    int label = chunk.Label(((y & (MAP_CHUNK_SIZE - 1)) << MAP_CHUNK_SHIFT) | (x & (MAP_CHUNK_SIZE - 1)));
+    return label ? (uint32_t)index << REGION_SHIFT | (uint32_t)(label - 1) : NO_REGION;
+}
+
+const RegionGraph::Region* RegionGraph::GetRegion(uint32_t region) const
+{
+    if (region == NO_REGION || (region >> REGION_SHIFT) >= _chunks.size())
+        return nullptr;
+    const std::vector<Region>& regions = _chunks[region >> REGION_SHIFT].regions;
+    uint32_t index = region & ((1 << REGION_SHIFT) - 1);
+    return index < regions.size() ? &regions[index] : nullptr;
+}
+
+int RegionGraph::LargestComponent() const
+{
+    int largest = -1;
+    for (size_t i = 0; i < _components.size(); i++)
+        if (_components[i].regionCount > 0 && (largest < 0 || _components[i].cellCount > _components[largest].cellCount))
+            largest = (int)i;
+    return largest;
+}
+
+bool RegionGraph::FindSpawn(int component, int nearX, int nearY, int& x, int& y) const
+{
+    int64_t best = -1;
+    for (const ChunkRegions& chunk : _chunks)
+    {
+        for (const Region& region : chunk.regions)
+        {
+            if (region.component != component)
+                continue;
+            int64_t dx = region.x - nearX, dy = region.y - nearY;
+            int64_t distance = dx * dx + dy * dy;
+            if (best >= 0 && distance >= best)
+                continue;
+            best = distance;
+            x = region.x;
+            y = region.y;
+        }
+    }
+    return best >= 0;
+}
+
+bool RegionGraph::FindOpenCell(const Map& map, int nearX, int nearY, int minCells, int& x, int& y)
+{
+    PROFILE_FUNCTION();
+
+    // Cells of the areas flooded so far, all of them smaller than minCells
+    std::unordered_set<int64_t> seen;
+    std::vector<std::pair<int, int>> stack;
+    int bestCells = 0;
+    for (int radius = 0; radius <= OPEN_CELL_SEARCH_RADIUS; radius++)
+    {
+        for (int dy = -radius; dy <= radius; dy++)
+        {
+            // Inside rows only have the two ends on the ring
+            int step = dy == -radius || dy == radius ? 1 : 2 * radius;
+            for (int dx = -radius; dx <= radius; dx += step)
+            {
+                int startX = nearX + dx;
+                int startY = nearY + dy;
+                if (map.IsSolid(startX, startY) || !seen.insert((int64_t)startY * map.Width() + startX).second)
+                    continue;
+
+                int cells = 0;
+                stack.clear();
+                stack.emplace_back(startX, startY);
+                while (!stack.empty() && cells < minCells)
+                {
+                    std::pair<int, int> cell = stack.back();
+                    stack.pop_back();
+                    cells++;
+                    const int offsets[4][2] = { { 0, -1 }, { 0, 1 }, { -1, 0 }, { 1, 0 } };
+                    for (const int* offset : offsets)
+                    {
+                        int nextX = cell.first + offset[0];
+                        int nextY = cell.second + offset[1];
+                        if (!map.IsSolid(nextX, nextY) && seen.insert((int64_t)nextY * map.Width() + nextX).second)
+                            stack.emplace_back(nextX, nextY);
+                    }
+                }
+
+                if (cells > bestCells)
+                {
+                    bestCells = cells;
+                    x = startX;
+                    y = startY;
+                }
+                if (cells >= minCells)
+                    return true;
+            }
+        }
+    }
+    return bestCells > 0;
+}
+
+size_t RegionGraph::MemoryBytes() const
+{
+    size_t bytes = _chunks.capacity() * sizeof(ChunkRegions) + _components.capacity() * sizeof(Component);
+    for (const ChunkRegions& chunk : _chunks)
+    {
+        bytes += chunk.labels.capacity() + chunk.regions.capacity() * sizeof(Region);
+        for (const Region& region : chunk.regions)
+            bytes += region.neighbors.capacity() * sizeof(uint32_t);
+    }
+    return bytes;
+}
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "map.h"
+
+// Which walkable cells of the map are connected to which.
+//
+// Every chunk is split into regions, the groups of floor cells connected
+// inside the chunk, labeled by stb_connected_components.h on the chunk's
+// 64x64 grid. Regions that touch across a chunk edge are linked, and the
+// linked regions form the components: two cells are reachable from each
+// other exactly when their regions share a component, so Reachable is two
+// label reads and a compare, never a search.
+//
+// This is stbcc's own layout of clusters, clumps and global labels, one
+// level up: stbcc fixes the largest grid at compile time and keeps 6-7
+// bytes per cell of it, which cannot cover a 32768x32768 map, so it is run
+// per chunk and the chunk level graph is kept here.
+//
+// Loading a map starts the build on a background thread: the chunks the map
+// holds are copied, the others are decoded from its file, and the finished
+// graph is taken over by the game thread when it is done. Until then it
+// is empty, and edits made meanwhile are relabeled when it is taken over.
+//
+// Edits only relabel the chunks in the map's dirty rectangles and relink
+// them to their neighbors. When the edit does not change which neighboring
+// regions the chunk connects, the components stay as they are; otherwise
+// only the components that touched the chunk are flooded again.
+//
+// Regions and their links also serve as the coarse graph for pathfinding,
+// and the component sizes for placing spawns where the player can get to.
+
+class RegionGraph
+{
+public:
+    static const uint32_t NO_REGION = 0xFFFFFFFF;
+
+    struct Region
+    {
+        int component = -1;
+        int cellCount = 0;
+        int x = 0, y = 0;                   // first cell of the region, row by row
+        std::vector<uint32_t> neighbors;    // linked regions in the neighboring chunks
+        uint32_t visit = 0;                 // flood generation
+    };
+
+    RegionGraph();
+    RegionGraph(const RegionGraph&) = delete;
+    RegionGraph& operator=(const RegionGraph&) = delete;
+    ~RegionGraph();
+
+    // Labels every chunk on worker threads, 0 uses every core. Unloaded chunks
+    // of a streamed map are decoded for this without being kept.
+    void Build(const Map& map, int threads = 0);
+
+    // Build on a background thread instead, the graph stays empty until
+    // FinishBuild takes the result over. The build reads the map's file, so
+    // cancel it before the map is reloaded or saved.
+    void StartBuild(const Map& map);
+    void CancelBuild();
+    bool Building() const { return _job != nullptr; }
+
+    // Takes over a finished background build and relabels the chunks edited
+    // since it started, call once per frame. True the frame that happens.
+    bool FinishBuild(const Map& map);
+
+    // Relabel the chunks with edited cells, call before the map clears them
+    void Update(const Map& map, const std::vector<MapDirtyRect>& dirty);
+
+    // Region of a floor cell, NO_REGION for walls and outside the map.
+    // Regions are chunk * 4096 + index and change when their chunk is edited.
+    uint32_t RegionAt(int x, int y) const;
+    const Region* GetRegion(uint32_t region) const;
+
+    // Component of a floor cell, -1 for walls and outside the map
+    int ComponentAt(int x, int y) const
+    {
+        const Region* region = GetRegion(RegionAt(x, y));
+        return region ? region->component : -1;
+    }
+
+    bool Reachable(int fromX, int fromY, int toX, int toY) const
+    {
+        int component = ComponentAt(fromX, fromY);
+        return component >= 0 && component == ComponentAt(toX, toY);
+    }
+
+    int ComponentCells(int component) const { return _components[component].cellCount; }
+    int LargestComponent() const;           // -1 when the map has no floor
+
+    // Floor cell of the component near the position, the first cell of its closest region
+    bool FindSpawn(int component, int nearX, int nearY, int& x, int& y) const;
+
+    // Floor cell nearest the position, ring by ring, whose walkable area has at
+    // least minCells cells, or the largest area seen when none has. Needs no
+    // graph: floods stop at minCells, so only the cells around are read.
+    static bool FindOpenCell(const Map& map, int nearX, int nearY, int minCells, int& x, int& y);
+
+    int RegionCount() const { return _regionCount; }
+    int ComponentCount() const { return (int)_components.size() - (int)_freeComponents.size(); }
+    size_t MemoryBytes() const;
+
+private:
+    static const int REGION_SHIFT = 12;     // a 64x64 chunk has at most 2048 regions
+
+    struct Component
+    {
+        int cellCount = 0;
+        int regionCount = 0;
+    };
+
+    // Cells of a chunk by region, labels are the region index + 1 and 0 for walls
+    struct ChunkRegions
+    {
+        std::vector<Region> regions;
+        std::vector<uint8_t> labels;        // labelBits a cell, empty when the chunk has no walls
+        int labelBits = 0;                  // 4, 8 or 16, as few as the region count allows
+        uint16_t edges[4][MAP_CHUNK_SIZE] = {};     // labels along the top, bottom, left and right edge
+
+        int Label(int cell) const
+        {
+            switch (labelBits)
+            {
+            case 4:  return (labels[cell >> 1] >> ((cell & 1) * 4)) & 15;
+            case 8:  return labels[cell];
+            default: return labels[cell * 2] | labels[cell * 2 + 1] << 8;
+            }
+        }
+    };
+
+    // stbcc grid and lookup table for labeling one chunk, one per thread
+    struct Scratch;
+
+    // Background build and what it reads
+    struct Job;
+
+    void Reset(int width, int height, int chunksX, int chunksY);
+    void Connect(int threads);
+    void Adopt(RegionGraph& built);
+    void Label(const Map& map, int chunkX, int chunkY, Scratch& scratch, ChunkRegions& out) const;
+    void Label(const uint64_t* occupancy, int chunkX, int chunkY, Scratch& scratch, ChunkRegions& out) const;
+    void LinkInto(int index);
+    void Relink(int index);
+    void Rebuild(const Map& map, int index);
+    void GroupNeighbors(const ChunkRegions& chunk, std::vector<std::pair<uint32_t, int>>& groups);
+    void Flood(uint32_t start, int component);
+    int AllocateComponent();
+    Region& At(uint32_t region) { return _chunks[region >> REGION_SHIFT].regions[region & ((1 << REGION_SHIFT) - 1)]; }
+
+    int _width = 0;
+    int _height = 0;
+    int _chunksX = 0;
+    int _chunksY = 0;
+    int _regionCount = 0;
+    std::vector<ChunkRegions> _chunks;
+    std::vector<Component> _components;
+    std::vector<int> _freeComponents;
+    uint32_t _visit = 0;
+
+    std::unique_ptr<Job> _job;
+    std::vector<int> _editedChunks;                         // edited while the job runs
+
+    // Reused by Update
+    std::unique_ptr<Scratch> _scratch;
+    std::vector<uint32_t> _stack;
+    std::vector<uint32_t> _seeds;
+    std::vector<int> _released;
+    std::vector<int> _parent;
+    std::vector<std::pair<uint32_t, int>> _oldGroups;       // neighbor region and its group through the chunk
+    std::vector<std::pair<uint32_t, int>> _newGroups;
+};
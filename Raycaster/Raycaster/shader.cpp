@@ -18,9 +18,10 @@ GLuint createShaderProgram(const char* vertexPath, const char* fragmentPath) {
     std::string vertexCode = readFile(vertexPath);
     std::string fragmentCode = readFile(fragmentPath);
 
-    const char* vertexSource = vertexCode.c_str();
-    const char* fragmentSource = fragmentCode.c_str();
+    return createShaderProgramFromSource(vertexCode.c_str(), fragmentCode.c_str());
+}
 
+GLuint createShaderProgramFromSource(const char* vertexSource, const char* fragmentSource) {
     GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
     glShaderSource(vertexShader, 1, &vertexSource, NULL);
     glCompileShader(vertexShader);
@@ -6,5 +6,6 @@
 
 std::string readFile(const char* filepath);
 GLuint createShaderProgram(const char* vertexPath, const char* fragmentPath);
+GLuint createShaderProgramFromSource(const char* vertexSource, const char* fragmentSource);
 
 #endif
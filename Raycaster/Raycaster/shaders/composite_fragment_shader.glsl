@@ -0,0 +1,13 @@
+#version 330 core
+
+in vec2 TexCoord;
+
+uniform sampler2D overlay;
+
+out vec4 FragColor;
+
+void main()
+{
+    // Premultiplied, blended with GL_ONE, GL_ONE_MINUS_SRC_ALPHA
+    FragColor = texture(overlay, TexCoord);
+}
@@ -5,49 +5,57 @@ out vec4 FragColor;
 in vec2 TexCoord;
 
 uniform vec2 uResolution;
-uniform vec2 uPlayerPos;
+uniform vec2 uPlayerPos;           // relative to uOrigin, small enough to stay exact
+uniform ivec2 uOrigin;             // first cell of the player's chunk
+uniform vec2 uFloorOffset;         // fract(uOrigin / uResolution.y), for the floor pattern
 uniform float uPlayerAngle;
+uniform float uMaxDistance;
+uniform float uShadeDistance;
+
+uniform usampler2D pages;          // per chunk: empty, unloaded or 1 + pool slot
+uniform sampler2D pool;            // materials of the chunks on the GPU
+uniform int uPoolSlotsX;
+uniform ivec2 uMapSize;
 
-uniform sampler2D map;
 uniform sampler2D textures;
 uniform int texturesX;
 uniform int texturesY;
 
-uniform sampler2D overlay;
 uniform sampler2D skybox;
 
 const float FOV = 1;
+const int CELL_UNLOADED = 255;     // chunk not streamed in yet, drawn as fog
+
+const int CHUNK_SHIFT = 6;
+const int CHUNK_SIZE = 64;
+const uint PAGE_EMPTY = 0u;
+const uint PAGE_UNLOADED = 65535u;
 
 bool isAir(int value)
 {
     return (value == 0);
 }
 
-bool isWall(float x, float y) {
-    ivec2 bufferSize = textureSize(map, 0);
-    int gridX = int(floor(x));
-    int gridY = int(floor(y));
-    if (gridX < 0 || gridX >= bufferSize.x || gridY < 0 || gridY >= bufferSize.y) {
-        return true;
+int cellAt(ivec2 cell, uint page) {
+    if (page == PAGE_UNLOADED) {
+        return CELL_UNLOADED;
     }
-    float value = texelFetch(map, ivec2(gridY, gridX), 0).r * 255;
-    return !isAir((int)value);
+    int slot = int(page) - 1;
+    ivec2 texel = ivec2(slot % uPoolSlotsX, slot / uPoolSlotsX) * CHUNK_SIZE + (cell & (CHUNK_SIZE - 1));
+    return int(texelFetch(pool, texel, 0).r * 255 + 0.5);
 }
 
 void main()
 {
     vec3 filterColor = vec3(0.817647, 0.747059, 0.660784);
 
-    vec3 overlayColor = texture(overlay, TexCoord).rgb;
-    filterColor *= overlayColor.r;
-
     float screenX = (TexCoord.x - 0.5) * 2.0;
     float rayAngle = uPlayerAngle + atan(screenX, 1.0);
 
     vec2 rayDir = vec2(cos(rayAngle), sin(rayAngle));
     vec2 rayPos = uPlayerPos;
 
-    vec2 stepSize = abs(vec2(1.0 / rayDir.x, 1.0 / rayDir.y));
+    vec2 stepSize = min(abs(vec2(1.0 / rayDir.x, 1.0 / rayDir.y)), vec2(1e30));
 
     vec2 mapCheck = floor(rayPos);
     vec2 rayLength1D = vec2(0.0);
@@ -72,8 +80,11 @@ void main()
     float distToWall = 0.0;
     bool hitWall = false;
     bool wallVertical = false;
+    int hitCell = 0;
+    ivec2 currentChunk = ivec2(-1);
+    uint currentPage = PAGE_UNLOADED;
 
-    while (!hitWall && distToWall < textureSize(map, 0).x) {
+    while (!hitWall && distToWall < uMaxDistance) {
         if (rayLength1D.x < rayLength1D.y) {
             mapCheck.x += step.x;
             distToWall = rayLength1D.x;
@@ -86,7 +97,38 @@ void main()
             wallVertical = false;
         }
 
-        if (isWall(mapCheck.x, mapCheck.y)) {
+        ivec2 cell = ivec2(mapCheck) + uOrigin;
+        if (cell.x < 0 || cell.x >= uMapSize.x || cell.y < 0 || cell.y >= uMapSize.y) {
+            hitCell = 1;
+            hitWall = true;
+            continue;
+        }
+
+        // One page lookup per chunk the ray enters
+        ivec2 chunk = cell >> CHUNK_SHIFT;
+        if (chunk != currentChunk) {
+            currentChunk = chunk;
+            currentPage = texelFetch(pages, chunk, 0).r;
+        }
+
+        if (currentPage == PAGE_EMPTY) {
+            // Nothing to hit in this chunk: take every crossing before the ray leaves it
+            // at once, so the next step is the one out of the chunk
+            ivec2 chunkMin = chunk << CHUNK_SHIFT;
+            ivec2 chunkMax = chunkMin + (CHUNK_SIZE - 1);
+            vec2 inside = vec2(step.x > 0 ? chunkMax.x - cell.x : cell.x - chunkMin.x,
+                               step.y > 0 ? chunkMax.y - cell.y : cell.y - chunkMin.y);
+            vec2 exitLength = rayLength1D + inside * stepSize;
+            float exitDist = min(exitLength.x, exitLength.y);
+            vec2 crossings = min(max(ceil((exitDist - rayLength1D) / stepSize), 0.0), inside);
+            mapCheck += crossings * step;
+            rayLength1D += crossings * stepSize;
+            distToWall = max(distToWall, max(rayLength1D.x - stepSize.x, rayLength1D.y - stepSize.y));
+            continue;
+        }
+
+        hitCell = cellAt(cell, currentPage);
+        if (!isAir(hitCell)) {
             hitWall = true;
         }
     }
@@ -100,8 +142,10 @@ void main()
     } else if (TexCoord.y > (0.5 + wallHeight / uResolution.y)) {
         color = texture(skybox, vec2(3 * rayAngle / (2 * 3.14159265359), TexCoord.y)).rgb;
         color = vec3(1, 1, 1) * color.r;
+    } else if (hitCell == CELL_UNLOADED) {
+        color = vec3(0.0);
     } else {
-        float shade = 1.0 - distToWall / textureSize(map, 0).x / 2;
+        float shade = max(1.0 - distToWall / uShadeDistance / 2, 0.0);
 
         vec2 texCoord;
         if (wallVertical) {
@@ -128,11 +172,12 @@ void main()
         // Calculate the distance to the floor
         float floorDist = (0.5 * uResolution.y) / ((TexCoord.y - 0.5) *cos(rayAngle - uPlayerAngle));
 
-        // Calculate the position of the floor intersection
+        // Calculate the position of the floor intersection, relative to uOrigin
         vec2 floorPos = uPlayerPos + rayDir * floorDist;
 
-        // Calculate the texture coordinates for the floor
-        vec2 floorTexCoords = floorPos/uResolution.y - vec2(floor(floorPos.x), floor(floorPos.y));
+        // Calculate the texture coordinates for the floor, the integer origin drops out
+        // of the repeating texture except for its share of floorPos/uResolution.y
+        vec2 floorTexCoords = floorPos/uResolution.y + uFloorOffset - vec2(floor(floorPos.x), floor(floorPos.y));
 
         // Get the texture color for the floor
         vec4 floorColor = texture(textures, - uPlayerPos + floorTexCoords);
@@ -0,0 +1,26 @@
+#version 330 core
+
+in vec2 TexCoord;
+in vec4 Color;
+flat in uint Mode;
+
+uniform sampler2D sprites;
+
+out vec4 FragColor;
+
+void main()
+{
+    if (Mode == 2u) {
+        // Solid rectangle
+        FragColor = Color;
+        return;
+    }
+
+    vec4 texel = texture(sprites, TexCoord);
+    if (Mode == 1u) {
+        // Shade: blend towards the color by how dark the frame is
+        FragColor = vec4(Color.rgb, Color.a * (1.0 - texel.r));
+    } else {
+        FragColor = texel * Color;
+    }
+}
@@ -0,0 +1,26 @@
+#version 330 core
+
+// One instance per sprite, corners come from gl_VertexID of a 4 vertex strip
+layout(location = 0) in vec4 aRect;     // x, y, width, height in pixels, top left origin
+layout(location = 1) in vec4 aUv;       // u0, v0, u1, v1
+layout(location = 2) in vec4 aColor;
+layout(location = 3) in uint aMode;
+
+uniform vec2 uScreenSize;
+
+out vec2 TexCoord;
+out vec4 Color;
+flat out uint Mode;
+
+void main()
+{
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+    vec2 pixel = aRect.xy + corner * aRect.zw;
+    vec2 ndc = pixel / uScreenSize * 2.0 - 1.0;
+    gl_Position = vec4(ndc.x, -ndc.y, 0.0, 1.0);
+
+    // v1 is the top of the frame
+    TexCoord = vec2(mix(aUv.x, aUv.z, corner.x), mix(aUv.w, aUv.y, corner.y));
+    Color = aColor;
+    Mode = aMode;
+}
@@ -0,0 +1,44 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoord;
+
+uniform usampler2D pages;
+uniform sampler2D pool;
+uniform int uPoolSlotsX;
+uniform sampler2D explored;
+uniform ivec2 uMapSize;
+
+const int CHUNK_SHIFT = 6;
+const int CHUNK_SIZE = 64;
+const uint PAGE_EMPTY = 0u;
+const uint PAGE_UNLOADED = 65535u;
+
+void main()
+{
+    // One fog texel covers a block of cells on large maps
+    if (texture(explored, TexCoord).r < 0.5) {
+        FragColor = vec4(0.0, 0.0, 0.0, 0.25); // Fog for unexplored cells
+        return;
+    }
+
+    // Cells are read through the page table like in the scene shader
+    ivec2 cell = min(ivec2(TexCoord * vec2(uMapSize)), uMapSize - 1);
+    uint page = texelFetch(pages, cell >> CHUNK_SHIFT, 0).r;
+    int value = 0;
+    if (page == PAGE_UNLOADED) {
+        value = 255;
+    } else if (page != PAGE_EMPTY) {
+        int slot = int(page) - 1;
+        ivec2 texel = ivec2(slot % uPoolSlotsX, slot / uPoolSlotsX) * CHUNK_SIZE + (cell & (CHUNK_SIZE - 1));
+        value = int(texelFetch(pool, texel, 0).r * 255 + 0.5);
+    }
+
+    if (value == 255) {
+        FragColor = vec4(0.0, 0.0, 0.0, 0.25); // Not streamed in, same as fog
+    } else if (value != 0) {
+        FragColor = vec4(1.0, 1.0, 1.0, 0.9); // White for walls
+    } else {
+        FragColor = vec4(0.0, 0.0, 0.0, 0.6); // Black for empty spaces
+    }
+}
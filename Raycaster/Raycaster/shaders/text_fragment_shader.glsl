@@ -0,0 +1,17 @@
+#version 330 core
+
+in vec2 TexCoord;
+in vec4 Color;
+
+uniform sampler2D glyphs;
+
+out vec4 FragColor;
+
+void main()
+{
+    // 0.5 is the outline, the smoothing width follows the on-screen scale
+    float distance = texture(glyphs, TexCoord).r;
+    float width = max(fwidth(distance) * 0.75, 0.001);
+    float coverage = smoothstep(0.5 - width, 0.5 + width, distance);
+    FragColor = vec4(Color.rgb, Color.a * coverage);
+}
@@ -0,0 +1,221 @@
+#include "text_renderer.h"
+#include "asset_pack.h"
+#include "profiler.h"
+#include "shader.h"
+
+#include <cstdarg>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+bool TextRenderer::Init(const std::string& tablePath, AssetLoader& loader)
+{
+    AssetData table;
+    if (!ReadAsset(tablePath, table))
+    {
+        std::cerr << "Failed to open font: " << tablePath << std::endl;
+        return false;
+    }
+
+    if (table.size < sizeof(_header))
+    {
+        std::cerr << "Invalid font: " << tablePath << std::endl;
+        return false;
+    }
+    memcpy(&_header, table.data, sizeof(_header));
+    if (memcmp(_header.magic, FONT_MAGIC, sizeof(_header.magic)) != 0 || _header.version != FONT_VERSION
+        || table.size < sizeof(_header) + _header.glyphCount * sizeof(FontGlyph))
+    {
+        std::cerr << "Invalid font: " << tablePath << std::endl;
+        return false;
+    }
+
+    // ASCII only, that is all the bitmap font has
+    for (uint32_t i = 0; i < _header.glyphCount; i++)
+    {
+        FontGlyph glyph;
+        memcpy(&glyph, table.data + sizeof(_header) + i * sizeof(FontGlyph), sizeof(glyph));
+        if (glyph.codepoint >= 128)
+            continue;
+        _glyphs[glyph.codepoint] = glyph;
+        _hasGlyph[glyph.codepoint] = true;
+    }
+    _spaceAdvance = _header.lineHeight * 0.35f;
+
+    size_t slash = tablePath.find_last_of("/\\");
+    std::string directory = slash == std::string::npos ? "" : tablePath.substr(0, slash + 1);
+
+    // Distance fields need bilinear filtering and no block compression
+    TextureOptions options;
+    options.wrap = GL_CLAMP_TO_EDGE;
+    options.minFilter = GL_LINEAR;
+    options.magFilter = GL_LINEAR;
+    options.mipmaps = false;
+    _texture = loader.RequestTexture(directory + std::string(_header.atlasFile, strnlen(_header.atlasFile, sizeof(_header.atlasFile))), options);
+
+    std::string vertexSource, fragmentSource;
+    if (!ReadAssetText("shaders/text_vertex_shader.glsl", vertexSource) || !ReadAssetText("shaders/text_fragment_shader.glsl", fragmentSource))
+    {
+        std::cerr << "Failed to load text shaders" << std::endl;
+        return false;
+    }
+    _program = createShaderProgramFromSource(vertexSource.c_str(), fragmentSource.c_str());
+    _screenSizeLoc = glGetUniformLocation(_program, "uScreenSize");
+    _glyphsLoc = glGetUniformLocation(_program, "glyphs");
+
+    _instances.Create(sizeof(Instance), MAX_GLYPHS);
+    glGenVertexArrays(1, &_vao);
+    glBindVertexArray(_vao);
+    for (GLuint attribute = 0; attribute < 3; attribute++)
+    {
+        glEnableVertexAttribArray(attribute);
+        glVertexAttribDivisor(attribute, 1);
+    }
+    glBindVertexArray(0);
+    return true;
+}
+
+void TextRenderer::Shutdown()
+{
+    _instances.Destroy();
+    if (_vao)
+        glDeleteVertexArrays(1, &_vao);
+    if (_program)
+        glDeleteProgram(_program);
+    _vao = 0;
+    _program = 0;
+}
+
+void TextRenderer::Begin(int screenWidth, int screenHeight)
+{
+    _screenWidth = screenWidth;
+    _screenHeight = screenHeight;
+    _count = 0;
+    _frame = _program ? (Instance*)_instances.Begin() : nullptr;
+}
+
+const FontGlyph* TextRenderer::Glyph(char c) const
+{
+    unsigned char index = (unsigned char)c;
+    return index < 128 && _hasGlyph[index] ? &_glyphs[index] : nullptr;
+}
+
+float TextRenderer::Draw(float x, float y, float size, uint32_t color, const char* text)
+{
+    if (!_frame || _header.lineHeight == 0)
+        return 0.0f;
+
+    float scale = size / _header.lineHeight;
+    float invWidth = 1.0f / _header.atlasWidth;
+    float invHeight = 1.0f / _header.atlasHeight;
+    float penX = x;
+    float penY = y;
+    float widest = 0.0f;
+    for (const char* c = text; *c; c++)
+    {
+        if (*c == '\n')
+        {
+            widest = penX - x > widest ? penX - x : widest;
+            penX = x;
+            penY += size;
+            continue;
+        }
+
+        const FontGlyph* glyph = Glyph(*c);
+        if (!glyph)
+        {
+            penX += _spaceAdvance * scale;
+            continue;
+        }
+
+        if (_count < MAX_GLYPHS)
+        {
+            // The atlas is uploaded flipped, so the top of a glyph is v1
+            Instance& instance = _frame[_count++];
+            instance.x = penX + glyph->offsetX * scale;
+            instance.y = penY + glyph->offsetY * scale;
+            instance.width = glyph->width * scale;
+            instance.height = glyph->height * scale;
+            instance.u0 = glyph->x * invWidth;
+            instance.u1 = (glyph->x + glyph->width) * invWidth;
+            instance.v0 = 1.0f - (glyph->y + glyph->height) * invHeight;
+            instance.v1 = 1.0f - glyph->y * invHeight;
+            instance.color = color;
+        }
+        penX += glyph->advance * scale;
+    }
+    return penX - x > widest ? penX - x : widest;
+}
+
+float TextRenderer::Printf(float x, float y, float size, uint32_t color, const char* format, ...)
+{
+    char buffer[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    return Draw(x, y, size, color, buffer);
+}
+
+float TextRenderer::Measure(float size, const char* text) const
+{
+    if (_header.lineHeight == 0)
+        return 0.0f;
+
+    float scale = size / _header.lineHeight;
+    float width = 0.0f, widest = 0.0f;
+    for (const char* c = text; *c; c++)
+    {
+        if (*c == '\n')
+        {
+            widest = width > widest ? width : widest;
+            width = 0.0f;
+            continue;
+        }
+        const FontGlyph* glyph = Glyph(*c);
+        width += (glyph ? glyph->advance : _spaceAdvance) * scale;
+    }
+    return width > widest ? width : widest;
+}
+
+void TextRenderer::End()
+{
+    PROFILE_FUNCTION();
+
+    _glyphsLastFrame = _count;
+    _drawCallsLastFrame = 0;
+    if (!_frame)
+        return;
+    _frame = nullptr;
+
+    GLintptr offset = _instances.End(_count);
+    if (_count == 0)
+    {
+        _instances.Fence();
+        return;
+    }
+
+    // This frame's region of the instance buffer
+    glBindVertexArray(_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, _instances.Buffer());
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)(offset + offsetof(Instance, x)));
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)(offset + offsetof(Instance, u0)));
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Instance), (void*)(offset + offsetof(Instance, color)));
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glUseProgram(_program);
+    glUniform2f(_screenSizeLoc, (GLfloat)_screenWidth, (GLfloat)_screenHeight);
+    glUniform1i(_glyphsLoc, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, _texture);
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, _count);
+    glDisable(GL_BLEND);
+    glBindVertexArray(0);
+
+    _instances.Fence();
+    _drawCallsLastFrame = 1;
+}
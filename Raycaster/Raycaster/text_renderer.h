@@ -0,0 +1,73 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cstdint>
+#include <string>
+#include "asset_loader.h"
+#include "font_format.h"
+#include "instance_buffer.h"
+
+// Screen text from the signed distance field font baked by "AssetTool font".
+//
+// Draw calls between Begin and End only append glyph instances to a
+// persistently mapped buffer; End renders all of them with one instanced
+// draw, so a frame's text costs a single draw call no matter how many strings
+// it has. Positions and sizes are in pixels with the origin at the top left,
+// size is the height of a line. Nothing here allocates after Init.
+
+class TextRenderer
+{
+public:
+    static const int MAX_GLYPHS = 4096;
+
+    // Needs the GL context, the atlas texture streams in through the loader
+    bool Init(const std::string& tablePath, AssetLoader& loader);
+    void Shutdown();
+    bool IsLoaded() const { return _program != 0; }
+
+    void Begin(int screenWidth, int screenHeight);
+    void End();
+
+    // Returns the advance in pixels. Glyphs past MAX_GLYPHS in a frame are dropped.
+    float Draw(float x, float y, float size, uint32_t color, const char* text);
+    float Printf(float x, float y, float size, uint32_t color, const char* format, ...);
+    float Measure(float size, const char* text) const;
+
+    int GlyphsLastFrame() const { return _glyphsLastFrame; }
+    int DrawCallsLastFrame() const { return _drawCallsLastFrame; }
+
+    // Byte order of the color attribute, red first
+    static uint32_t Color(uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255)
+    {
+        return (uint32_t)r | ((uint32_t)g << 8) | ((uint32_t)b << 16) | ((uint32_t)a << 24);
+    }
+
+private:
+    struct Instance
+    {
+        float x, y, width, height;
+        float u0, v0, u1, v1;
+        uint32_t color;
+    };
+
+    const FontGlyph* Glyph(char c) const;
+
+    FontHeader _header = {};
+    FontGlyph _glyphs[128] = {};
+    bool _hasGlyph[128] = {};
+    float _spaceAdvance = 0.0f;
+
+    GLuint _texture = 0;
+    GLuint _program = 0;
+    GLuint _vao = 0;
+    GLint _screenSizeLoc = -1;
+    GLint _glyphsLoc = -1;
+    InstanceBuffer _instances;
+
+    Instance* _frame = nullptr;
+    int _count = 0;
+    int _screenWidth = 0;
+    int _screenHeight = 0;
+    int _glyphsLastFrame = 0;
+    int _drawCallsLastFrame = 0;
+};
@@ -0,0 +1,94 @@
+#include "texture_atlas.h"
+#include "asset_pack.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+bool TextureAtlas::Load(const std::string& tablePath, AssetLoader& loader, TextureOptions options)
+{
+    AssetData table;
+    if (!ReadAsset(tablePath, table))
+    {
+        std::cerr << "Failed to open atlas: " << tablePath << std::endl;
+        return false;
+    }
+
+    AtlasHeader header;
+    if (table.size < sizeof(header))
+    {
+        std::cerr << "Invalid atlas: " << tablePath << std::endl;
+        return false;
+    }
+    memcpy(&header, table.data, sizeof(header));
+    if (memcmp(header.magic, ATLAS_MAGIC, sizeof(header.magic)) != 0 || header.version != ATLAS_VERSION)
+    {
+        std::cerr << "Invalid atlas: " << tablePath << std::endl;
+        return false;
+    }
+
+    size_t pagesSize = header.pageCount * sizeof(AtlasPage);
+    size_t rectsSize = header.rectCount * sizeof(AtlasRect);
+    if (table.size < sizeof(header) + pagesSize + rectsSize)
+    {
+        std::cerr << "Truncated atlas: " << tablePath << std::endl;
+        return false;
+    }
+
+    std::vector<AtlasPage> pages(header.pageCount);
+    _rects.resize(header.rectCount);
+    memcpy(pages.data(), table.data + sizeof(header), pagesSize);
+    memcpy(_rects.data(), table.data + sizeof(header) + pagesSize, rectsSize);
+
+    size_t slash = tablePath.find_last_of("/\\");
+    std::string directory = slash == std::string::npos ? "" : tablePath.substr(0, slash + 1);
+
+    // The gutters keep clamping and nearest mip sampling inside every frame. A
+    // texel of mip level n spans 2^n pixels, so levels past log2 of the gutter
+    // would take in the next frame and are never sampled.
+    options.wrap = GL_CLAMP_TO_EDGE;
+    options.minFilter = GL_NEAREST_MIPMAP_NEAREST;
+    options.maxLevel = 0;
+    while ((2u << options.maxLevel) <= header.padding)
+        options.maxLevel++;
+
+    for (const AtlasPage& pageInfo : pages)
+    {
+        Page page;
+        page.width = (int)pageInfo.width;
+        page.height = (int)pageInfo.height;
+        page.texture = loader.RequestTexture(directory + std::string(pageInfo.file, strnlen(pageInfo.file, sizeof(pageInfo.file))), options);
+        _pages.push_back(page);
+    }
+    return true;
+}
+
+bool TextureAtlas::Find(const char* name, AtlasRegion& region) const
+{
+    auto it = std::lower_bound(_rects.begin(), _rects.end(), name,
+        [](const AtlasRect& rect, const char* key) { return strncmp(rect.name, key, sizeof(rect.name)) < 0; });
+    if (it == _rects.end() || strncmp(it->name, name, sizeof(it->name)) != 0)
+        return false;
+
+    const Page& page = _pages[it->page];
+    region.page = it->page;
+    region.x = it->x;
+    region.y = it->y;
+    region.width = it->width;
+    region.height = it->height;
+
+    // Pages are uploaded flipped, so the top of the image is v = 1
+    region.u0 = (float)it->x / page.width;
+    region.u1 = (float)(it->x + it->width) / page.width;
+    region.v0 = 1.0f - (float)(it->y + it->height) / page.height;
+    region.v1 = 1.0f - (float)it->y / page.height;
+    return true;
+}
+
+bool TextureAtlas::Find(const char* group, int index, AtlasRegion& region) const
+{
+    char name[sizeof(AtlasRect::name)];
+    snprintf(name, sizeof(name), "%s:%d", group, index);
+    return Find(name, region);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <string>
+#include <vector>
+#include "asset_loader.h"
+#include "atlas_format.h"
+
+// Sprite frames packed offline by "AssetTool atlas".
+//
+// Load reads the rect table and requests one texture per page from the asset
+// loader, so pages stream in like any other texture. Frames are looked up by
+// "<group>:<index>" and come back with texture coordinates for the flipped
+// upload the loader does, ready to batch every frame on a page into one draw.
+
+struct AtlasRegion
+{
+    int page = -1;
+    int x = 0;              // pixels, top left origin
+    int y = 0;
+    int width = 0;
+    int height = 0;
+    float u0 = 0.0f;        // GL texture coordinates, bottom left
+    float v0 = 0.0f;
+    float u1 = 0.0f;        // top right
+    float v1 = 0.0f;
+};
+
+class TextureAtlas
+{
+public:
+    // Page wrap and filtering are set by the atlas, the rest of options is passed on
+    bool Load(const std::string& tablePath, AssetLoader& loader, TextureOptions options = TextureOptions());
+    bool IsLoaded() const { return !_pages.empty(); }
+
+    // Frame by name, false when the atlas has no such frame
+    bool Find(const char* name, AtlasRegion& region) const;
+    bool Find(const char* group, int index, AtlasRegion& region) const;
+
+    int PageCount() const { return (int)_pages.size(); }
+    GLuint PageTexture(int page) const { return _pages[page].texture; }
+    int FrameCount() const { return (int)_rects.size(); }
+
+private:
+    struct Page
+    {
+        GLuint texture = 0;
+        int width = 0;
+        int height = 0;
+    };
+
+    std::vector<Page> _pages;
+    std::vector<AtlasRect> _rects;  // sorted by name
+};
@@ -0,0 +1,213 @@
+#include "texture_residency.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+
+void TextureResidency::Adopt(GLuint texture, MipChain&& chain)
+{
+    PROFILE_FUNCTION();
+
+    Track* existing = Find(texture);
+    if (existing)
+    {
+        _residentBytes -= BytesFrom(*existing, existing->baseLevel);
+    }
+    else
+    {
+        _tracks.emplace_back();
+        _order.reserve(_tracks.size());
+        existing = &_tracks.back();
+    }
+
+    Track& track = *existing;
+    track.texture = texture;
+    track.chain = std::move(chain);
+    track.levelCount = (int)track.chain.levelSizes.size();
+    track.levelOffsets.assign(track.levelCount, 0);
+    for (int level = 1; level < track.levelCount; level++)
+        track.levelOffsets[level] = track.levelOffsets[level - 1] + track.chain.levelSizes[level - 1];
+
+    track.tailLevel = track.levelCount - 1;
+    while (track.tailLevel > 0)
+    {
+        int level = track.tailLevel - 1;
+        if (std::max(track.chain.width >> level, track.chain.height >> level) > tailSize)
+            break;
+        track.tailLevel = level;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, track.levelCount - 1);
+    for (int level = track.levelCount - 1; level >= track.tailLevel; level--)
+        UploadLevel(track, level);
+    SetBaseLevel(track, track.tailLevel);
+    track.wantedLevel = track.tailLevel;
+    track.lastVisibleFrame = _frame;
+}
+
+bool TextureResidency::IsTracked(GLuint texture) const
+{
+    for (const Track& track : _tracks)
+        if (track.texture == texture)
+            return true;
+    return false;
+}
+
+void TextureResidency::Clear()
+{
+    _tracks.clear();
+    _order.clear();
+    _residentBytes = 0;
+}
+
+TextureResidency::Track* TextureResidency::Find(GLuint texture)
+{
+    for (Track& track : _tracks)
+        if (track.texture == texture)
+            return &track;
+    return nullptr;
+}
+
+void TextureResidency::MarkVisible(GLuint texture, float texelsPerPixel, int pixels)
+{
+    Track* track = Find(texture);
+    if (!track)
+        return;
+
+    if (track->pixels == 0 || texelsPerPixel < track->texelsPerPixel)
+        track->texelsPerPixel = texelsPerPixel;
+    track->pixels += pixels;
+    track->lastVisibleFrame = _frame;
+}
+
+size_t TextureResidency::BytesFrom(const Track& track, int level) const
+{
+    size_t bytes = 0;
+    for (int i = level; i < track.levelCount; i++)
+        bytes += LevelBytes(track, i);
+    return bytes;
+}
+
+void TextureResidency::Update()
+{
+    PROFILE_FUNCTION();
+
+    // Finest level each texture needs, level n has 2^n texels per texel of level 0
+    size_t wantedBytes = 0;
+    for (Track& track : _tracks)
+    {
+        if (track.pixels > 0)
+        {
+            int level = track.texelsPerPixel > 1.0f ? (int)std::floor(std::log2(track.texelsPerPixel)) : 0;
+            track.wantedLevel = std::min(level, track.tailLevel);
+        }
+        else if (_frame - track.lastVisibleFrame > graceFrames)
+        {
+            track.wantedLevel = track.tailLevel;
+        }
+        wantedBytes += BytesFrom(track, track.wantedLevel);
+    }
+
+    // Most visible first: largest coverage, then most recently seen
+    _order.clear();
+    for (int i = 0; i < (int)_tracks.size(); i++)
+        _order.push_back(i);
+    std::sort(_order.begin(), _order.end(), [this](int a, int b) {
+        const Track& ta = _tracks[a];
+        const Track& tb = _tracks[b];
+        if (ta.pixels != tb.pixels)
+            return ta.pixels > tb.pixels;
+        return ta.lastVisibleFrame > tb.lastVisibleFrame;
+    });
+
+    // Over budget, drop one level per texture per pass, least visible first, until it fits
+    bool dropped = true;
+    while (wantedBytes > budgetBytes && dropped)
+    {
+        dropped = false;
+        for (int i = (int)_order.size() - 1; i >= 0 && wantedBytes > budgetBytes; i--)
+        {
+            Track& track = _tracks[_order[i]];
+            if (track.wantedLevel >= track.tailLevel)
+                continue;
+            wantedBytes -= LevelBytes(track, track.wantedLevel);
+            track.wantedLevel++;
+            dropped = true;
+        }
+    }
+
+    // Evictions are free and make room first
+    for (Track& track : _tracks)
+    {
+        if (track.baseLevel >= track.wantedLevel)
+            continue;
+        int level = track.baseLevel;
+        SetBaseLevel(track, track.wantedLevel);
+        for (; level < track.wantedLevel; level++)
+            EvictLevel(track, level);
+    }
+
+    // Uploads go coarse to fine, most visible textures first, within the frame's cap
+    _uploadedBytes = 0;
+    for (int index : _order)
+    {
+        Track& track = _tracks[index];
+        while (track.baseLevel > track.wantedLevel)
+        {
+            int level = track.baseLevel - 1;
+            size_t bytes = LevelBytes(track, level);
+            if (_uploadedBytes > 0 && _uploadedBytes + bytes > uploadBytesPerFrame)
+                break;
+            UploadLevel(track, level);
+            SetBaseLevel(track, level);
+            _uploadedBytes += bytes;
+        }
+        if (_uploadedBytes >= uploadBytesPerFrame)
+            break;
+    }
+
+    for (Track& track : _tracks)
+        track.pixels = 0;
+    _frame++;
+
+    PROFILE_COUNTER("Texture resident bytes", _residentBytes);
+    PROFILE_COUNTER("Texture streaming bytes", _uploadedBytes);
+}
+
+void TextureResidency::UploadLevel(Track& track, int level)
+{
+    PROFILE_GPU_ZONE("Texture level upload");
+
+    int width = std::max(1, track.chain.width >> level);
+    int height = std::max(1, track.chain.height >> level);
+    const unsigned char* data = track.chain.Bytes() + track.levelOffsets[level];
+
+    glBindTexture(GL_TEXTURE_2D, track.texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (track.chain.compressed)
+        glCompressedTexImage2D(GL_TEXTURE_2D, level, track.chain.format, width, height, 0, (GLsizei)LevelBytes(track, level), data);
+    else
+        glTexImage2D(GL_TEXTURE_2D, level, track.chain.format, width, height, 0, track.chain.format, GL_UNSIGNED_BYTE, data);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    _residentBytes += LevelBytes(track, level);
+}
+
+void TextureResidency::EvictLevel(Track& track, int level)
+{
+    glBindTexture(GL_TEXTURE_2D, track.texture);
+    if (track.chain.compressed)
+        glCompressedTexImage2D(GL_TEXTURE_2D, level, track.chain.format, 0, 0, 0, 0, NULL);
+    else
+        glTexImage2D(GL_TEXTURE_2D, level, track.chain.format, 0, 0, 0, track.chain.format, GL_UNSIGNED_BYTE, NULL);
+
+    _residentBytes -= LevelBytes(track, level);
+}
+
+void TextureResidency::SetBaseLevel(Track& track, int level)
+{
+    glBindTexture(GL_TEXTURE_2D, track.texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+    track.baseLevel = level;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cstdint>
+#include <vector>
+#include "asset_loader.h"
+
+// Keeps mip levels of streamed textures in VRAM according to how they are seen.
+//
+// Each frame the game reports what it saw with MarkVisible: the texture, how
+// many texels land on one screen pixel and how many pixels it covered. Update
+// then picks the finest level every texture needs, trims the least visible
+// textures until the set fits the VRAM budget, evicts levels right away and
+// uploads missing ones finest-last under a per-frame byte cap. The small tail
+// of every chain always stays resident, so a texture is never incomplete.
+//
+// Evicted levels are respecified as 0x0 images and GL_TEXTURE_BASE_LEVEL is
+// moved past them, which returns their storage to the driver. The level data
+// stays on the CPU side, inside the asset pack mapping for cooked textures.
+
+class TextureResidency
+{
+public:
+    size_t budgetBytes = 64 << 20;
+    size_t uploadBytesPerFrame = 1 << 20;
+    int tailSize = 32;                  // levels this size or smaller are always resident
+    uint64_t graceFrames = 120;         // unseen textures keep their levels this long
+
+    // Take over a texture's mip chain and upload its tail. GL thread only.
+    void Adopt(GLuint texture, MipChain&& chain);
+    bool IsTracked(GLuint texture) const;
+    void Clear();
+
+    void MarkVisible(GLuint texture, float texelsPerPixel, int pixels);
+
+    // Decide levels from this frame's marks, evict and upload. GL thread only.
+    void Update();
+
+    size_t ResidentBytes() const { return _residentBytes; }
+    size_t UploadedBytesLastFrame() const { return _uploadedBytes; }
+    int TrackedCount() const { return (int)_tracks.size(); }
+
+private:
+    struct Track
+    {
+        GLuint texture = 0;
+        MipChain chain;
+        std::vector<size_t> levelOffsets;
+        int levelCount = 0;
+        int tailLevel = 0;              // first level that is always resident
+        int baseLevel = 0;              // finest level in VRAM
+        int wantedLevel = 0;
+        float texelsPerPixel = 0;       // finest density seen this frame
+        int pixels = 0;                 // coverage this frame
+        uint64_t lastVisibleFrame = 0;
+    };
+
+    Track* Find(GLuint texture);
+    size_t LevelBytes(const Track& track, int level) const { return track.chain.levelSizes[level]; }
+    size_t BytesFrom(const Track& track, int level) const;
+    void UploadLevel(Track& track, int level);
+    void EvictLevel(Track& track, int level);
+    void SetBaseLevel(Track& track, int level);
+
+    std::vector<Track> _tracks;
+    std::vector<int> _order;            // tracks by visibility, reused every frame
+    uint64_t _frame = 0;
+    size_t _residentBytes = 0;
+    size_t _uploadedBytes = 0;
+};